@@ -451,7 +451,8 @@ OGGZ * oggz_new (int flags);
 /**
  * Open an Ogg file, creating an OGGZ handle for it
  * \param filename The file to open
- * \param flags OGGZ_READ or OGGZ_WRITE
+ * \param flags OGGZ_READ or OGGZ_WRITE, optionally with OGGZ_MMAP
+ *        when reading
  * \return A new OGGZ handle
  * \retval NULL System error; check errno for details
  */
@@ -460,7 +461,8 @@ OGGZ * oggz_open (const char * filename, int flags);
 /**
  * Create an OGGZ handle associated with a stdio stream
  * \param file An open FILE handle
- * \param flags OGGZ_READ or OGGZ_WRITE
+ * \param flags OGGZ_READ or OGGZ_WRITE, optionally with OGGZ_MMAP
+ *        when reading
  * \returns A new OGGZ handle
  * \retval NULL System error; check errno for details
  */
@@ -41,7 +41,7 @@
  * Flags to oggz_new(), oggz_open(), and oggz_openfd().
  * Can be or'ed together in the following combinations:
  * - OGGZ_READ | OGGZ_AUTO
- * - OGGZ_WRITE | OGGZ_NONSTRICT | OGGZ_PREFIX | OGGZ_SUFFIX
+ * - OGGZ_WRITE | OGGZ_NONSTRICT | OGGZ_PREFIX | OGGZ_SUFFIX | OGGZ_SORT
  */
 enum OggzFlags {
   /** Read only */
@@ -74,7 +74,36 @@ enum OggzFlags {
    * Ogg stream, ie. disable checking for conformance with
    * beginning-of-stream constraints.
    */
-  OGGZ_SUFFIX       = 0x80
+  OGGZ_SUFFIX       = 0x80,
+
+  /**
+   * Map the file into memory when reading, rather than copying its
+   * contents through an internal buffer with read(). Pages are then
+   * delivered directly from the mapping. This only applies to handles
+   * opened for reading with oggz_open() or oggz_open_stdio() on a
+   * regular file; otherwise it is silently ignored and the file is
+   * read normally. Data appended to the file after it is opened is
+   * not seen by a mapped handle.
+   *
+   * \note The file must not be truncated while it is mapped: reading
+   * the part of the mapping that no longer has a file behind it raises
+   * SIGBUS, which Oggz cannot catch or report as an error.
+   */
+  OGGZ_MMAP         = 0x100,
+
+  /**
+   * Write packets in time order across logical bitstreams, however
+   * unevenly they are fed. Packets are held in a queue per bitstream
+   * and released in order of oggz_get_unit() of their granulepos, once
+   * every bitstream which has not ended has a packet queued, or once
+   * the queued packets span more than a maximum delay, set with
+   * oggz_write_set_max_delay(). Packets with granulepos -1 are ordered
+   * with the preceding packet of their bitstream. Each bitstream needs
+   * a metric, eg. from OGGZ_AUTO or oggz_set_granulerate(), and should
+   * be ended with an e_o_s packet so that the final packets are not
+   * held back; otherwise release them with oggz_write_sort_flush().
+   */
+  OGGZ_SORT         = 0x200
 
 };
 
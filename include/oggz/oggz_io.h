@@ -103,6 +103,24 @@ typedef int (*OggzIOSeek) (void * user_handle, long offset, int whence);
  */
 typedef long (*OggzIOTell) (void * user_handle);
 
+/**
+ * This is the signature of a function which you provide for Oggz
+ * to call when it needs raw input data from a given offset, without
+ * seeking. Such positional reads are used in preference to a seek and
+ * a read wherever Oggz reads out of sequence, as when seeking.
+ * \param user_handle A generic pointer you have provided earlier
+ * \param buf The buffer that you read data into
+ * \param n The length in bytes that Oggz wants to read
+ * \param offset The offset in bytes at which to read
+ * \retval ">  0" The number of bytes successfully read into the buffer
+ * \retval 0 to indicate that there is no data at \a offset (End of file)
+ * \retval "<  0" An error condition
+ * \note The function must not change the position used by your
+ * OggzIORead function.
+ */
+typedef size_t (*OggzIOReadAt) (void * user_handle, void * buf, size_t n,
+                                oggz_off_t offset);
+
 /**
  * This is the signature of a function which you provide for Oggz
  * to call when it needs to flush the output data. The behaviour
@@ -114,6 +132,32 @@ typedef long (*OggzIOTell) (void * user_handle);
  */
 typedef int (*OggzIOFlush) (void * user_handle);
 
+/**
+ * A region of memory to be output, as passed to an OggzIOWritev function.
+ */
+typedef struct {
+  /** The start of the region */
+  void * base;
+
+  /** The length of the region in bytes */
+  size_t len;
+} OggzIOVec;
+
+/**
+ * This is the signature of a function which you provide for Oggz
+ * to call when it needs to output several regions of raw data at once,
+ * in the manner of writev(). oggz_write() uses it to output many pages
+ * per call, passing each page header and body as a separate region.
+ * \param user_handle A generic pointer you have provided earlier
+ * \param iov The regions to write, in order
+ * \param iovcnt The number of regions
+ * \retval ">= 0" The number of bytes successfully written (may be less than
+ * the total length if a write error has occurred)
+ * \retval "<  0" An error condition
+ */
+typedef long (*OggzIOWritev) (void * user_handle, const OggzIOVec * iov,
+                              int iovcnt);
+
 
 /**
  * Set a function for Oggz to call when it needs to read input data.
@@ -233,4 +277,77 @@ int oggz_io_set_flush (OGGZ * oggz, OggzIOFlush flush, void * user_handle);
  */
 void * oggz_io_get_flush_user_handle (OGGZ * oggz);
 
+/**
+ * Set a function for Oggz to call when it needs to read input data at
+ * a given offset. This is optional: without it, Oggz seeks and reads
+ * sequentially. Handles opened with oggz_open() or oggz_open_stdio()
+ * read at an offset with pread() already.
+ * \param oggz An OGGZ handle
+ * \param read_at Your positional reading function
+ * \param user_handle Any arbitrary data you wish to pass to the function
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ; \a oggz not
+ * open for reading.
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+int oggz_io_set_read_at (OGGZ * oggz, OggzIOReadAt read_at,
+                         void * user_handle);
+
+/**
+ * Retrieve the user_handle associated with the function you have provided
+ * for reading input data at a given offset.
+ * \param oggz An OGGZ handle
+ * \returns the associated user_handle
+ */
+void * oggz_io_get_read_at_user_handle (OGGZ * oggz);
+
+/**
+ * Set a function for Oggz to call when it needs to write several
+ * regions of output data at once. This is optional: without it, Oggz
+ * writes each region with your OggzIOWrite function. Handles opened
+ * with oggz_open() or oggz_open_stdio() write with writev() already.
+ * \param oggz An OGGZ handle
+ * \param writev Your vectored writing function
+ * \param user_handle Any arbitrary data you wish to pass to the function
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ; \a oggz not
+ * open for writing.
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+int oggz_io_set_writev (OGGZ * oggz, OggzIOWritev writev, void * user_handle);
+
+/**
+ * Retrieve the user_handle associated with the function you have provided
+ * for writing several regions of output data at once.
+ * \param oggz An OGGZ handle
+ * \returns the associated user_handle
+ */
+void * oggz_io_get_writev_user_handle (OGGZ * oggz);
+
+/**
+ * Read the file of \a oggz through Linux io_uring. All reads are then
+ * made at an offset tracked by Oggz, so seeking and telling need no
+ * system calls. The first read after a seek, as made by each probe
+ * while seeking, is submitted on its own straight into Oggz's buffer.
+ * Sequential reading keeps up to \a depth 64 KiB reads in flight ahead
+ * of the data being parsed.
+ *
+ * \param oggz An OGGZ handle opened for reading on a regular file with
+ * oggz_open() or oggz_open_stdio()
+ * \param depth The number of reads to keep in flight while reading
+ * sequentially, or 0 to return to ordinary reads
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ; \a oggz
+ * is not open for reading on a regular file
+ * \retval OGGZ_ERR_DISABLED io_uring is not supported on this system
+ * \retval OGGZ_ERR_SYSTEM System error; check errno for details
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ *
+ * \note This has no effect on a handle opened with OGGZ_MMAP.
+ */
+int oggz_io_set_uring (OGGZ * oggz, int depth);
+
 #endif /* __OGGZ_IO_H__ */
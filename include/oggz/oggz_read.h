@@ -108,6 +108,54 @@ typedef int (*OggzReadPacket) (OGGZ * oggz, oggz_packet * packet, long serialno,
 int oggz_set_read_callback (OGGZ * oggz, long serialno,
 			    OggzReadPacket read_packet, void * user_data);
 
+/**
+ * This is the signature of a callback which you may provide for Oggz
+ * to call with all the packets completed on a page of the Ogg stream
+ * associated with \a oggz, as an alternative to an OggzReadPacket
+ * callback.
+ *
+ * \param oggz The OGGZ handle
+ * \param og The page on which the packets completed, or NULL for packets
+ *           which were held back for granulepos calculation (see
+ *           OGGZ_AUTO) and are delivered once it is known
+ * \param packets The packets, in stream order, including their positions
+ *                in the stream
+ * \param n The number of packets in \a packets
+ * \param serialno Identify the logical bistream in \a oggz that contains
+ *                 \a packets
+ * \param user_data A generic pointer you have provided earlier
+ * \returns 0 to continue, non-zero to instruct Oggz to stop.
+ *
+ * \note The packets, and their data, are only valid for the duration of
+ * the callback.
+ */
+typedef int (*OggzReadPackets) (OGGZ * oggz, const ogg_page * og,
+                                oggz_packet * packets, int n, long serialno,
+                                void * user_data);
+
+/**
+ * Set a callback for Oggz to call with the packets completed on each
+ * Ogg page, rather than once per packet. This replaces any OggzReadPacket
+ * callback set for the same \a serialno, and vice versa.
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param serialno Identify the logical bitstream in \a oggz to attach
+ * this callback to, or -1 to attach this callback to all unattached
+ * logical bitstreams in \a oggz.
+ * \param read_packets Your callback function
+ * \param user_data Arbitrary data you wish to pass to your callback
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ *
+ * \note As with oggz_set_read_callback(), a callback attached to a
+ * particular logical bitstream takes precedence over one attached to
+ * all logical bitstreams.
+ */
+int oggz_set_read_packets (OGGZ * oggz, long serialno,
+                           OggzReadPackets read_packets, void * user_data);
+
 /**
  * This is the signature of a callback which you must provide for Oggz
  * to call whenever it finds a new page in the Ogg stream associated
@@ -165,6 +213,33 @@ int oggz_set_read_page (OGGZ * oggz, long serialno,
  */
 long oggz_read (OGGZ * oggz, long n);
 
+/**
+ * Enable reading ahead on a background thread. A helper thread keeps up
+ * to \a nbuffers 64 KiB buffers filled from the file or I/O callbacks of
+ * \a oggz, so that input is read while callbacks run on the calling
+ * thread. This benefits long sequential reads from slow storage.
+ *
+ * While read-ahead is enabled, an OggzIORead callback is called from the
+ * helper thread. Seeking, and changing the I/O callbacks, first stop the
+ * helper thread and return the underlying file position to the data
+ * consumed so far; reading resumes it.
+ *
+ * This has no effect on handles opened with OGGZ_MMAP, or on data
+ * supplied with oggz_read_input().
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param nbuffers The number of buffers to read ahead, or 0 to disable
+ * read-ahead
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_DISABLED Threads are not supported on this platform
+ * \retval OGGZ_ERR_SYSTEM Failed to return the file to the position
+ * consumed when disabling read-ahead
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+int oggz_set_read_ahead (OGGZ * oggz, int nbuffers);
+
 /**
  * Input data into \a oggz.
  * \param oggz An OGGZ handle previously opened for reading
@@ -182,6 +257,74 @@ long oggz_read (OGGZ * oggz, long n);
  */
 long oggz_read_input (OGGZ * oggz, unsigned char * buf, long n);
 
+/**
+ * Input data into \a oggz from a buffer lent for the duration of the call.
+ * This behaves like oggz_read_input(), but complete pages are parsed in
+ * place from \a buf rather than being copied into an internal buffer, and
+ * all pages available in \a buf are processed in a single pass. Only a
+ * partial page at either end of \a buf is copied, so that it can be
+ * completed by the next call.
+ *
+ * The ogg_page structures passed to OggzReadPage callbacks refer directly
+ * to the contents of \a buf; they must not be retained after the callback
+ * returns. \a buf is not referenced once this function returns.
+ *
+ * If a callback stops reading, the return value counts only the bytes
+ * of the pages that were processed; the remaining input is left to the
+ * caller, who should present it again from that point.
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param buf A memory buffer
+ * \param n A count of bytes to input
+ * \retval ">  0" The number of bytes successfully ingested.
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_STOP_OK Reading was stopped by a user callback
+ * returning OGGZ_STOP_OK
+ * \retval OGGZ_ERR_STOP_ERR Reading was stopped by a user callback
+ * returning OGGZ_STOP_ERR
+ * \retval OGGZ_ERR_HOLE_IN_DATA Hole (sequence number gap) detected in input data
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+long oggz_read_input_borrowed (OGGZ * oggz, unsigned char * buf, long n);
+
+/**
+ * Retrieve the next packet from \a oggz. This is an alternative to
+ * reading with callbacks: rather than having packets pushed to an
+ * OggzReadPacket callback by oggz_read(), the caller pulls one packet
+ * per call, reading more data from the file or I/O callbacks as needed.
+ *
+ * The packet carries the same position information as is passed to an
+ * OggzReadPacket callback, including calc_granulepos when \a oggz was
+ * opened with OGGZ_AUTO. Packet callbacks are not called for packets
+ * retrieved in this way; page callbacks are.
+ *
+ * The packet data, and the page returned in \a og, remain valid only
+ * until the next call on \a oggz.
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param zp Location to store the next packet
+ * \param serialno Location to store the serialno of the packet's stream,
+ *        or NULL
+ * \param og Location to store a pointer to the page on which the packet
+ *        completed, or NULL. This is set to NULL for packets that were
+ *        held back for granulepos calculation, whose page is no longer
+ *        available.
+ * \retval 1 A packet was returned
+ * \retval 0 End of file
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_SYSTEM System error; check errno for details
+ * \retval OGGZ_ERR_STOP_OK Reading was stopped by a page callback
+ * returning OGGZ_STOP_OK
+ * \retval OGGZ_ERR_STOP_ERR Reading was stopped by a page callback
+ * returning OGGZ_STOP_ERR
+ * \retval OGGZ_ERR_HOLE_IN_DATA Hole (sequence number gap) detected in input data
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+int oggz_read_next_packet (OGGZ * oggz, oggz_packet * zp, long * serialno,
+                           const ogg_page ** og);
+
 /** \}
  */
 
@@ -235,4 +378,18 @@ const char * oggz_stream_get_content_type (OGGZ *oggz, long serialno);
  */
 int oggz_stream_get_numheaders (OGGZ * oggz, long serialno);
 
+/**
+ * Query the total amount of packet data that has been reverse buffered
+ * while reading \a oggz. When opened with OGGZ_AUTO, packets which do
+ * not yet have a calculable granulepos are held back until a later
+ * granulepos allows them to be timestamped; this returns the number of
+ * bytes of packet data that have been held back in this way.
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \returns The number of bytes of packet data reverse buffered so far
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ */
+ogg_int64_t oggz_get_reverse_buffered_bytes (OGGZ * oggz);
+
 #endif /* __OGGZ_READ_H__ */
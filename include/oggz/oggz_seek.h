@@ -108,6 +108,56 @@ ogg_int64_t oggz_tell_units (OGGZ * oggz);
  */
 ogg_int64_t oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence);
 
+/**
+ * Seek to a position from which every logical bitstream can be decoded
+ * at a given offset in milliseconds, or custom units.
+ *
+ * oggz_seek_units() lands on the page nearest the target, but a video
+ * frame there can usually only be decoded after the keyframe it depends
+ * on, and some audio codecs need a few packets of preroll before their
+ * output is correct. oggz_seek_keyframe() seeks to the target, reads
+ * forward to find the keyframe of each stream with a granuleshift and
+ * the packet duration of each stream with a preroll, then seeks again to
+ * the earliest of these.
+ *
+ * Packets read between the returned unit and \a unit_target should be
+ * decoded but not presented; the difference is the preroll needed.
+ *
+ * \param oggz An OGGZ handle
+ * \param unit_target A number of milliseconds, or custom units
+ * \returns the unit from which reading resumes, which is no later than
+ * \a unit_target, or -1 on failure.
+ * \note Keyframes are found with the built-in granulepos layouts of
+ * Theora, Dirac and VP8; other streams with a granuleshift are assumed
+ * to follow the Theora layout.
+ */
+ogg_int64_t oggz_seek_keyframe (OGGZ * oggz, ogg_int64_t unit_target);
+
+/**
+ * Find the duration of the data in milliseconds, or custom units.
+ *
+ * Rather than reading the whole file, this reads back from the end of
+ * the file to the last page carrying a granulepos of each logical
+ * bitstream, and takes the latest of their units. If the file has a
+ * Skeleton track, its presentation time is subtracted.
+ *
+ * The codec headers must have been read, as for oggz_seek_units().
+ * Afterwards the handle is returned to the start of the page it was
+ * reading, as if by oggz_seek().
+ *
+ * \param oggz An OGGZ handle
+ * \returns The duration, in milliseconds or custom units
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID \a oggz is not open for reading, or not all
+ * of its logical bitstreams have a metric
+ * \retval OGGZ_ERR_NOSEEK The size of the file cannot be found
+ * \retval OGGZ_ERR_SYSTEM System error; check errno for details
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ * \note A logical bitstream which ends long before the others makes this
+ * read back as far as its last page.
+ */
+ogg_int64_t oggz_get_duration (OGGZ * oggz);
+
 /**
  * Provide the exact stored granulepos (from the page header) if relevant to
  * the current packet, or a constructed granulepos if the stored granulepos
@@ -236,7 +286,29 @@ long oggz_seek_packets (OGGZ * oggz, long serialno, long packets, int whence);
  *
  * To seek, use oggz_seek_units(). Oggz will perform a ratio search
  * through the Ogg bitstream, using the OggzMetric callback to determine
- * its position relative to the desired unit.
+ * its position relative to the desired unit. Each probe interpolates
+ * between the pages found either side of the desired unit, but is kept
+ * near enough to the midpoint that a seek needs at most one probe more
+ * than a binary search would. The I/O used can be measured with
+ * oggz_seek_get_stats().
+ *
+ * Headers before the offset given to oggz_set_data_start() are skipped
+ * when seeking to a nonzero unit.
+ *
+ * Each OGGZ handle remembers a bounded number of the pages found while
+ * seeking and reading, and the last page of the file. Later seeks begin
+ * their search from the closest of these either side of the desired
+ * unit, so repeated seeks within the same region of a file need little
+ * I/O. These are forgotten if the length of the file changes.
+ *
+ * If the file carries an Ogg Skeleton 4.0 keypoint index, and its
+ * headers have been read with OGGZ_AUTO, oggz_seek_units() instead goes
+ * directly to the latest keypoint at or before the desired unit for all
+ * logical bitstreams. The position returned is that of the keypoint,
+ * so decoding can begin there but may start before the desired unit.
+ * The index is ignored if the length of the file differs from the
+ * segment length recorded in the Skeleton fishead. Keypoint times are
+ * taken to be in the milliseconds used by the automatic metrics.
  *
  * \note
  *
@@ -494,4 +566,129 @@ oggz_bounded_seek_set (OGGZ * oggz,
                        ogg_int64_t offset_begin,
                        ogg_int64_t offset_end);
 
+/**
+ * Counts of the work done by oggz_seek_units() on an OGGZ handle, as
+ * retrieved by oggz_seek_get_stats(). A probe is a repositioning of the
+ * underlying file or I/O callbacks; a set of reads made at once, as
+ * configured by oggz_seek_set_probes(), counts as one probe.
+ */
+typedef struct {
+  /** The number of calls to oggz_seek_units() */
+  long seeks;
+
+  /** The number of probes made while seeking */
+  long probes;
+
+  /** The number of bytes read while seeking */
+  ogg_int64_t bytes_read;
+
+  /** The number of probes made by the last oggz_seek_units() */
+  long last_probes;
+
+  /** The number of bytes read by the last oggz_seek_units() */
+  ogg_int64_t last_bytes_read;
+} OggzSeekStats;
+
+/**
+ * Retrieve seek statistics for an OGGZ handle, for measuring how much
+ * I/O seeking needs on a particular file.
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param stats Filled in with the statistics
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ *
+ * \note The total number of probes also counts calls to oggz_seek().
+ */
+int oggz_seek_get_stats (OGGZ * oggz, OggzSeekStats * stats);
+
+/**
+ * The largest number of probes oggz_seek_set_probes() accepts.
+ */
+#define OGGZ_SEEK_PROBES_MAX 64
+
+/**
+ * Set the number of probes a seek makes at once. Each round of probes
+ * reads at \a nr_probes points evenly dividing the range still to be
+ * searched, narrowing it to one section, so a seek takes roughly
+ * log(size)/log(nr_probes+1) rounds rather than log2(size). This suits
+ * storage where each round trip is slow, such as network filesystems.
+ * The reads are positional, and made concurrently with io_uring (see
+ * oggz_io_set_uring()) or on a plain file by a few threads, which this
+ * call starts and oggz_close() stops; through I/O callbacks or a memory
+ * mapping they are made in turn.
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param nr_probes The number of probes per round, from 1 (the
+ *        default, one probe at a time) to OGGZ_SEEK_PROBES_MAX
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ, or
+ *         \a nr_probes out of range
+ */
+int oggz_seek_set_probes (OGGZ * oggz, int nr_probes);
+
+/**
+ * The suffix of a seek index file. When a file is opened for reading
+ * with oggz_open(), Oggz looks for a seek index file of the same name
+ * with this suffix appended, as written by the oggz-index tool. If it
+ * exists and still matches the size and modification time of the Ogg
+ * file, it is mapped into memory and used for seeking.
+ */
+#define OGGZ_SEEK_INDEX_SUFFIX ".oggzidx"
+
+/**
+ * Record a seek index while reading. Once enabled, while reading
+ * sequentially from the start of a file Oggz records the byte offset
+ * of each page carrying a granulepos, using 16 bytes of memory per
+ * page. Recording is off by default, as the index grows without bound
+ * on a long running stream.
+ * \param oggz An OGGZ handle previously opened for reading
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ */
+int oggz_seek_index_enable (OGGZ * oggz);
+
+/**
+ * Export the seek index of an OGGZ handle.
+ *
+ * When enabled with oggz_seek_index_enable(), while reading
+ * sequentially from the start of a file Oggz records
+ * the byte offset of each page carrying a granulepos. Seeking with
+ * oggz_seek_units() within the part of the file which has been read
+ * goes directly to the target page, without first reading a series
+ * of probe pages. An exported index can be given to
+ * oggz_seek_index_import() on a later handle for the same file, or
+ * saved as a seek index file (see OGGZ_SEEK_INDEX_SUFFIX), so that
+ * seeking there avoids probe reads too.
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param buf A buffer to export the index into, or NULL
+ * \param n The size of \a buf in bytes
+ * \returns The size of the exported index in bytes. Nothing is written
+ * if \a buf is NULL or \a n is less than this.
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ */
+long oggz_seek_index_export (OGGZ * oggz, unsigned char * buf, long n);
+
+/**
+ * Replace the seek index of an OGGZ handle with one previously exported
+ * with oggz_seek_index_export().
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param buf The exported index
+ * \param n The size of the exported index in bytes
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ, or
+ * \a buf does not contain a valid index, or the index was made from a
+ * file whose size or modification time differ from those of the file
+ * being read
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ *
+ * \note The size and modification time can only be checked for handles
+ * reading a file opened with oggz_open() or oggz_open_stdio().
+ */
+int oggz_seek_index_import (OGGZ * oggz, const unsigned char * buf, long n);
+
 #endif /* __OGGZ_SEEK_H__ */
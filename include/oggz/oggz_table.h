@@ -62,12 +62,16 @@ oggz_table_delete (OggzTable * table);
 
 /**
  * Insert an element into a table. If a previous value existed for this key,
- * it is overwritten with the new data element.
+ * it is overwritten with the new data element, which keeps the position of
+ * the previous element in the table. NULL may be inserted as a data element.
  * \param table An OggzTable
  * \param key Key to access this data element
  * \param data The new element to add
  * \retval data If the element was successfully added
  * \retval NULL If adding the element failed due to a realloc() error
+ * \note When \a data is NULL the return value does not tell success from
+ * failure. Overwriting an existing key never fails; to detect failure when
+ * adding a new key with NULL data, check that oggz_table_size() increased.
  */
 void *
 oggz_table_insert (OggzTable * table, long key, void * data);
@@ -87,7 +91,8 @@ oggz_table_remove (OggzTable * table, long key);
  * \param table An OggzTable
  * \param key a key
  * \returns The element indexed by \a key
- * \retval NULL \a table is undefined, or no element is indexed by \a key
+ * \retval NULL \a table is undefined, no element is indexed by \a key,
+ * or the element indexed by \a key is NULL
  */
 void *
 oggz_table_lookup (OggzTable * table, long key);
@@ -101,7 +106,9 @@ int
 oggz_table_size (OggzTable * table);
 
 /**
- * Retrieve the nth element of an OggzTable, and optionally its key
+ * Retrieve the nth element of an OggzTable, and optionally its key.
+ * Elements are numbered in the order in which their keys were first
+ * inserted, excluding any that have since been removed.
  * \param table An OggzTable
  * \param n An index into the \a table
  * \param key Return pointer for key corresponding to nth data element
@@ -143,6 +143,41 @@ int oggz_write_set_hungry_callback (OGGZ * oggz,
 				    OggzWriteHungry hungry,
 				    int only_when_empty,
 				    void * user_data);
+
+/**
+ * Set the maximum delay for which an OGGZ_SORT writer holds packets
+ * back while waiting for other logical bitstreams to be fed. Once the
+ * packets queued span this many units, the earliest are written even
+ * if a bitstream has fallen behind; its later packets are then written
+ * out of order. The default is 1000 units.
+ *
+ * \param oggz An OGGZ handle opened with OGGZ_WRITE | OGGZ_SORT
+ * \param units The maximum delay, in units of the metrics in use
+ * (milliseconds for the bitstreams recognised by OGGZ_AUTO)
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ, or
+ * \a units is negative
+ */
+int oggz_write_set_max_delay (OGGZ * oggz, ogg_int64_t units);
+
+/**
+ * Release the packets an OGGZ_SORT writer is holding back, so that the
+ * following calls to oggz_write() or oggz_write_output() write them in
+ * time order without waiting for other logical bitstreams. Call this
+ * before writing out the last pages if a bitstream may not have ended
+ * with an e_o_s packet. Packets still held back when the writer is
+ * closed are written out if it was opened with oggz_open() or has an
+ * OggzIOWrite or OggzIOWritev callback. Otherwise, such as when output
+ * is taken with oggz_write_output(), they are silently discarded by
+ * oggz_close(); call this first and write out the packets it reports.
+ *
+ * \param oggz An OGGZ handle opened with OGGZ_WRITE | OGGZ_SORT
+ * \returns The number of packets released
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ */
+int oggz_write_sort_flush (OGGZ * oggz);
 /**
  * Add a packet to \a oggz's packet queue.
  * \param oggz An OGGZ handle previously opened for writing
@@ -186,6 +221,39 @@ int oggz_write_set_hungry_callback (OGGZ * oggz,
 int oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 		     int * guard);
 
+/**
+ * This is the signature of a function which you provide to
+ * oggz_write_feed_release(), to be called when Oggz has finished with
+ * the data of a packet.
+ *
+ * \param packet The \a packet field of the ogg_packet which was fed
+ * \param user_data The \a user_data passed to oggz_write_feed_release()
+ */
+typedef void (*OggzWriteRelease) (unsigned char * packet, void * user_data);
+
+/**
+ * Add a packet to \a oggz's packet queue without copying its data,
+ * handing Oggz a reference to it. Oggz calls \a release exactly once,
+ * as soon as the data has been copied into its Ogg stream while
+ * writing, or when \a oggz is closed with the packet still queued.
+ * This suits buffers with a reference count, which \a release can
+ * drop; the data must not change until then.
+ *
+ * \param oggz An OGGZ handle previously opened for writing
+ * \param op An ogg_packet with all fields filled in
+ * \param serialno Identify the logical bitstream in \a oggz to add the
+ * packet to
+ * \param flush Bitmask of OGGZ_FLUSH_BEFORE, OGGZ_FLUSH_AFTER
+ * \param release Your release function
+ * \param user_data Arbitrary data you wish to pass to \a release
+ * \returns As for oggz_write_feed(), or OGGZ_ERR_INVALID if \a release
+ * is NULL. If an error is returned, \a release will not be called and
+ * the packet data remains yours.
+ */
+int oggz_write_feed_release (OGGZ * oggz, ogg_packet * op, long serialno,
+			     int flush, OggzWriteRelease release,
+			     void * user_data);
+
 /**
  * Output data from an OGGZ handle. Oggz will call your write callback
  * as needed.
@@ -206,6 +274,29 @@ int oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
  */
 long oggz_write_output (OGGZ * oggz, unsigned char * buf, long n);
 
+/**
+ * Output the next page from an OGGZ handle without copying it.
+ * The header and body of \a og point into the Oggz writer, and remain
+ * valid only until the next call to write from \a oggz or to close it,
+ * so they can be sent directly, for example with scatter-gather I/O.
+ * If part of the page has already been output by oggz_write_output(),
+ * \a og describes only the remainder, and may have an empty header.
+ *
+ * \param oggz An OGGZ handle previously opened for writing
+ * \param og An ogg_page to fill in
+ * \retval "> 0" The number of bytes in \a og
+ * \retval 0 End of stream
+ * \retval OGGZ_ERR_RECURSIVE_WRITE Attempt to initiate writing from
+ * within an OggzHungry callback
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_STOP_OK Writing was stopped by an OggzHungry callback
+ * returning OGGZ_STOP_OK
+ * \retval OGGZ_ERR_STOP_ERR Reading was stopped by an OggzHungry callback
+ * returning OGGZ_STOP_ERR
+ */
+long oggz_write_output_page (OGGZ * oggz, ogg_page * og);
+
 /**
  * Write n bytes from an OGGZ handle. Oggz will call your write callback
  * as needed.
@@ -84,6 +84,10 @@ oggz_new (int flags)
   oggz->flags = flags;
   oggz->file = NULL;
   oggz->io = NULL;
+  oggz->map = NULL;
+  oggz->readahead = NULL;
+  oggz->uring = NULL;
+  oggz->io_pool = NULL;
 
   oggz->offset = 0;
   oggz->offset_data_begin = 0;
@@ -95,6 +99,9 @@ oggz_new (int flags)
   if (oggz->streams == NULL) {
     goto err_oggz_new;
   }
+  oggz->stream_index = NULL;
+  oggz->stream_index_size = 0;
+  oggz->last_stream = NULL;
   
   oggz->all_at_eos = 0;
 
@@ -105,22 +112,29 @@ oggz_new (int flags)
   oggz->order = NULL;
   oggz->order_user_data = NULL;
 
-  oggz->packet_buffer = oggz_dlist_new ();
+  oggz->packet_buffer = oggz_ring_new (sizeof (OggzBufferedPacket));
   if (oggz->packet_buffer == NULL) {
     goto err_streams_new;
   }
 
+  oggz->packet_pool = oggz_pool_new (OGGZ_PACKET_POOL_BLOCKSIZE);
+  if (oggz->packet_pool == NULL) {
+    goto err_packet_buffer_new;
+  }
+
   if (OGGZ_CONFIG_WRITE && (oggz->flags & OGGZ_WRITE)) {
     if (oggz_write_init (oggz) == NULL)
-      goto err_packet_buffer_new;
+      goto err_packet_pool_new;
   } else if (OGGZ_CONFIG_READ) {
     oggz_read_init (oggz);
   }
 
   return oggz;
 
+err_packet_pool_new:
+  oggz_pool_delete (oggz->packet_pool);
 err_packet_buffer_new:
-  oggz_free (oggz->packet_buffer);
+  oggz_ring_delete (oggz->packet_buffer);
 err_streams_new:
   oggz_free (oggz->streams);
 err_oggz_new:
@@ -150,6 +164,16 @@ oggz_open (char * filename, int flags)
 
   oggz->file = file;
 
+  if ((flags & OGGZ_MMAP) && !(flags & OGGZ_WRITE)) {
+    /* Fall back to normal reads if the file cannot be mapped */
+    oggz_mmap_init (oggz);
+  }
+
+  if (!(flags & OGGZ_WRITE)) {
+    /* Use a prebuilt seek index, if there is a valid one */
+    oggz_index_open (oggz, filename);
+  }
+
   return oggz;
 }
 
@@ -165,6 +189,11 @@ oggz_open_stdio (FILE * file, int flags)
 
   oggz->file = file;
 
+  if ((flags & OGGZ_MMAP) && !(flags & OGGZ_WRITE)) {
+    /* Fall back to normal reads if the file cannot be mapped */
+    oggz_mmap_init (oggz);
+  }
+
   return oggz;
 }
 
@@ -187,6 +216,8 @@ oggz_stream_clear (void * data)
 
   oggz_comments_free (stream);
 
+  oggz_ring_delete (stream->sort_queue);
+
   if (stream->ogg_stream.serialno != -1)
     ogg_stream_clear (&stream->ogg_stream);
 
@@ -214,13 +245,20 @@ oggz_close (OGGZ * oggz)
 
   oggz_vector_foreach (oggz->streams, oggz_stream_clear);
   oggz_vector_delete (oggz->streams);
+  oggz_free (oggz->stream_index);
 
-  oggz_dlist_deliter(oggz->packet_buffer, oggz_read_free_pbuffers);
-  oggz_dlist_delete(oggz->packet_buffer);
+  oggz_ring_deliter(oggz->packet_buffer, oggz_read_free_pbuffers);
+  oggz_ring_delete(oggz->packet_buffer);
+  oggz_pool_delete(oggz->packet_pool);
   
   if (oggz->metric_internal)
     oggz_free (oggz->metric_user_data);
 
+  oggz_readahead_close (oggz);
+  oggz_io_pool_close (oggz);
+  oggz_uring_close (oggz);
+  oggz_mmap_close (oggz);
+
   if (oggz->file != NULL) {
     if (fclose (oggz->file) == EOF) {
       return OGGZ_ERR_SYSTEM;
@@ -319,12 +357,98 @@ oggz_find_stream (void * data, long serialno)
   return (stream->ogg_stream.serialno == serialno);
 }
 
+/*
+ * The streams are also indexed by serialno in an open addressed hash
+ * table, oggz->stream_index, which is kept at most half full. If the
+ * index could not be allocated, lookups fall back to a linear search.
+ */
+
+#define STREAM_INDEX_MIN_SIZE 16
+
+static unsigned int
+oggz_stream_index_hash (long serialno, int size)
+{
+  ogg_uint32_t h = (ogg_uint32_t)serialno * 0x9e3779b1UL;
+
+  return (unsigned int)(h ^ (h >> 16)) & (size - 1);
+}
+
+static void
+oggz_stream_index_put (oggz_stream_t ** index, int size, oggz_stream_t * stream)
+{
+  unsigned int i;
+
+  i = oggz_stream_index_hash (stream->ogg_stream.serialno, size);
+  while (index[i] != NULL) {
+    i = (i + 1) & (size - 1);
+  }
+
+  index[i] = stream;
+}
+
+static int
+oggz_stream_index_add (OGGZ * oggz, oggz_stream_t * stream)
+{
+  oggz_stream_t ** new_index;
+  int i, n, new_size;
+
+  n = oggz_vector_size (oggz->streams);
+
+  if (2 * n > oggz->stream_index_size) {
+    new_size = MAX (STREAM_INDEX_MIN_SIZE, 2 * oggz->stream_index_size);
+    while (2 * n > new_size) new_size *= 2;
+
+    new_index = oggz_malloc (new_size * sizeof (oggz_stream_t *));
+    if (new_index == NULL) {
+      oggz_free (oggz->stream_index);
+      oggz->stream_index = NULL;
+      oggz->stream_index_size = 0;
+      return -1;
+    }
+    memset (new_index, 0, new_size * sizeof (oggz_stream_t *));
+
+    /* Rehash all streams, including the new one */
+    for (i = 0; i < n; i++) {
+      oggz_stream_index_put (new_index, new_size,
+                             oggz_vector_nth_p (oggz->streams, i));
+    }
+
+    oggz_free (oggz->stream_index);
+    oggz->stream_index = new_index;
+    oggz->stream_index_size = new_size;
+  } else {
+    oggz_stream_index_put (oggz->stream_index, oggz->stream_index_size, stream);
+  }
+
+  return 0;
+}
+
 oggz_stream_t *
 oggz_get_stream (OGGZ * oggz, long serialno)
 {
+  oggz_stream_t * stream;
+  unsigned int i;
+
   if (serialno == -1) return NULL;
 
-  return oggz_vector_find_with (oggz->streams, oggz_find_stream, serialno);
+  /* Consecutive lookups are usually for the same stream */
+  stream = oggz->last_stream;
+  if (stream != NULL && stream->ogg_stream.serialno == serialno)
+    return stream;
+
+  if (oggz->stream_index == NULL) {
+    stream = oggz_vector_find_with (oggz->streams, oggz_find_stream, serialno);
+  } else {
+    i = oggz_stream_index_hash (serialno, oggz->stream_index_size);
+    while ((stream = oggz->stream_index[i]) != NULL) {
+      if (stream->ogg_stream.serialno == serialno) break;
+      i = (i + 1) & (oggz->stream_index_size - 1);
+    }
+  }
+
+  if (stream != NULL) oggz->last_stream = stream;
+
+  return stream;
 }
 
 oggz_stream_t *
@@ -357,6 +481,9 @@ oggz_add_stream (OGGZ * oggz, long serialno)
   stream->granulepos = 0;
   stream->packetno = -1; /* will be incremented on first read or write */
 
+  stream->sort_queue = NULL;
+  stream->sort_unit = 0;
+
   stream->metric = NULL;
   stream->metric_user_data = NULL;
   stream->metric_internal = 0;
@@ -364,12 +491,22 @@ oggz_add_stream (OGGZ * oggz, long serialno)
   stream->order_user_data = NULL;
   stream->read_packet = NULL;
   stream->read_user_data = NULL;
+  stream->read_packets = NULL;
+  stream->read_packets_user_data = NULL;
   stream->read_page = NULL;
   stream->read_page_user_data = NULL;
 
   stream->calculate_data = NULL;
   
-  oggz_vector_insert_p (oggz->streams, stream);
+  if (oggz_vector_insert_p (oggz->streams, stream) == NULL) {
+    oggz_stream_clear (stream);
+    return NULL;
+  }
+
+  /* On failure, lookups fall back to searching oggz->streams */
+  oggz_stream_index_add (oggz, stream);
+
+  oggz->last_stream = stream;
 
   return stream;
 }
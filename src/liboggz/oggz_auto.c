@@ -494,9 +494,101 @@ auto_fisbone (OGGZ * oggz, long serialno, unsigned char * data, long length, voi
   return 1;
 }
 
+/*
+ * Read a Skeleton variable length integer, returning a pointer to the
+ * following byte, or NULL if it runs past end.
+ */
+static unsigned char *
+skeleton_vint_at (unsigned char * c, unsigned char * end, ogg_int64_t * n)
+{
+  int shift;
+
+  *n = 0;
+
+  for (shift = 0; c < end && shift < 63; shift += 7) {
+    *n |= (ogg_int64_t)(*c & 0x7f) << shift;
+    if (*c++ & 0x80) return c;
+  }
+
+  return NULL;
+}
+
+static int
+auto_skeleton_index (OGGZ * oggz, long serialno, unsigned char * data, long length, void * user_data)
+{
+  long index_serialno; /* The serialno referred to in this index */
+  ogg_int64_t nr_keypoints, time_denominator;
+  ogg_int64_t i, offset = 0, time = 0, delta;
+  unsigned char * c, * end = data + length;
+  int numheaders;
+
+  if (length < 42) return 0;
+
+  index_serialno = (long) int32_le_at(&data[6]);
+  nr_keypoints = int64_le_at(&data[10]);
+  time_denominator = int64_le_at(&data[18]);
+
+  /* Each keypoint takes at least two bytes */
+  if (time_denominator <= 0 || nr_keypoints < 0 ||
+      nr_keypoints > (length - 42) / 2) return 0;
+
+#ifdef DEBUG
+  printf ("Got skeleton index of %lld keypoints for serialno %010lu\n",
+          nr_keypoints, index_serialno);
+#endif
+
+  c = &data[42];
+  for (i = 0; i < nr_keypoints; i++) {
+    if ((c = skeleton_vint_at (c, end, &delta)) == NULL) break;
+    offset += delta;
+    if ((c = skeleton_vint_at (c, end, &delta)) == NULL) break;
+    time += delta;
+
+    /* Keypoint times are converted to the units of the automatic
+     * metrics, ie. milliseconds */
+    if (oggz_index_add_keypoint (oggz, index_serialno, offset,
+                                 time * OGGZ_AUTO_MULT / time_denominator) != 0)
+      break;
+  }
+
+  /* Increment the number of headers for this stream */
+  numheaders = oggz_stream_get_numheaders (oggz, serialno);
+  oggz_stream_set_numheaders (oggz, serialno, numheaders+1);
+
+  return 1;
+}
+
+/*
+ * Secondary Skeleton packets are fisbones, or in Skeleton 4.0, keypoint
+ * indexes
+ */
+static int
+auto_skeleton_secondary (OGGZ * oggz, long serialno, unsigned char * data, long length, void * user_data)
+{
+  if (length >= 6 && memcmp (data, "index\0", 6) == 0) {
+    return auto_skeleton_index (oggz, serialno, data, length, user_data);
+  }
+
+  return auto_fisbone (oggz, serialno, data, length, user_data);
+}
+
 static int
 auto_fishead (OGGZ * oggz, long serialno, unsigned char * data, long length, void * user_data)
 {
+  ogg_int64_t segment_length = 0;
+
+  /* Skeleton 4.0 gives the length of the segment its index refers to */
+  if (length >= 80 && int16_le_at(&data[8]) >= 4) {
+    segment_length = int64_le_at(&data[64]);
+  }
+
+  oggz_index_keypoints_reset (oggz, segment_length);
+
+  if (length >= 28) {
+    oggz_seek_set_presentation_time (oggz, int64_le_at(&data[12]),
+                                     int64_le_at(&data[20]));
+  }
+
   oggz_set_granulerate (oggz, serialno, 0, 1);
 
   /* For skeleton, numheaders will get incremented as each header is seen */
@@ -1405,7 +1497,7 @@ oggz_auto_read_bos_page (OGGZ * oggz, ogg_page * og, long serialno,
   if (content < 0 || content >= OGGZ_CONTENT_UNKNOWN) {
     return 0;
   } else if (content == OGGZ_CONTENT_SKELETON && !ogg_page_bos(og)) {
-    return auto_fisbone(oggz, serialno, og->body, og->body_len, user_data);
+    return auto_skeleton_secondary(oggz, serialno, og->body, og->body_len, user_data);
   } else {
     return oggz_auto_codec_ident[content].reader(oggz, serialno, og->body, og->body_len, user_data);
   }
@@ -1421,7 +1513,7 @@ oggz_auto_read_bos_packet (OGGZ * oggz, ogg_packet * op, long serialno,
   if (content < 0 || content >= OGGZ_CONTENT_UNKNOWN) {
     return 0;
   } else if (content == OGGZ_CONTENT_SKELETON && !op->b_o_s) {
-    return auto_fisbone(oggz, serialno, op->packet, op->bytes, user_data);
+    return auto_skeleton_secondary(oggz, serialno, op->packet, op->bytes, user_data);
   } else {
     return oggz_auto_codec_ident[content].reader(oggz, serialno, op->packet, op->bytes, user_data);
   }
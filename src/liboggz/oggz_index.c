@@ -0,0 +1,874 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_index.c
+ *
+ * Seek index. While reading sequentially from the start of the data,
+ * Oggz records the offset and granulepos of every page carrying a
+ * granulepos, in a separate list for each logical bitstream. Once the
+ * region of the file being sought in has been read, oggz_seek_units()
+ * finds its target page from the index and reads it directly, instead
+ * of bisecting through the file.
+ *
+ * Units and keyframes are not stored: they are derived from the
+ * granulepos when the index is used, so that the index remains valid
+ * if metrics are set after the data has been read.
+ *
+ * An exported index has the following layout, with all values stored
+ * little-endian:
+ *
+ *   8 bytes  "OggzIdx" followed by a version byte (1)
+ *   8 bytes  size of the indexed file, or 0 if unknown
+ *   8 bytes  modification time of the indexed file, or 0 if unknown
+ *   8 bytes  number of bytes of the file covered by the index
+ *   4 bytes  number of logical bitstreams
+ *   4 bytes  reserved (0)
+ *
+ * followed, for each logical bitstream, by:
+ *
+ *   4 bytes  serialno
+ *   4 bytes  number of entries
+ *   then for each entry, in file order:
+ *   8 bytes  page offset
+ *   8 bytes  granulepos
+ *
+ * All entries are 8 byte aligned, so an index file can be mapped and
+ * searched in place. oggz_open() does this for a file named like the
+ * Ogg file with OGGZ_SEEK_INDEX_SUFFIX appended, if its size and
+ * modification time still match those of the Ogg file.
+ */
+
+#include "config.h"
+
+#if OGGZ_CONFIG_READ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define OGGZ_INDEX_MMAP 1
+#endif
+
+#include <ogg/ogg.h>
+
+#include "oggz_compat.h"
+#include "oggz_private.h"
+
+#include "oggz/oggz_seek.h"
+
+/*#define DEBUG*/
+
+#define OGGZ_INDEX_MAGIC "OggzIdx"
+#define OGGZ_INDEX_VERSION 1
+
+#define OGGZ_INDEX_HEADER_LEN 40
+#define OGGZ_INDEX_STREAM_LEN 8
+#define OGGZ_INDEX_ENTRY_LEN 16
+
+#define OGGZ_INDEX_MIN_ENTRIES 64
+
+typedef struct {
+  oggz_off_t offset; /* offset of page start */
+  ogg_int64_t granulepos;
+} OggzIndexEntry;
+
+typedef struct {
+  OggzIndexEntry * entries;
+  const unsigned char * records; /* entries still in a mapped index file */
+  int nr_entries;
+  int max_entries;
+} OggzStreamIndex;
+
+static ogg_uint32_t
+oggz_index_get_32 (const unsigned char * c)
+{
+  return (ogg_uint32_t)c[0] | ((ogg_uint32_t)c[1] << 8) |
+    ((ogg_uint32_t)c[2] << 16) | ((ogg_uint32_t)c[3] << 24);
+}
+
+static ogg_int64_t
+oggz_index_get_64 (const unsigned char * c)
+{
+  return (ogg_int64_t)oggz_index_get_32 (c) |
+    ((ogg_int64_t)oggz_index_get_32 (c+4) << 32);
+}
+
+static void
+oggz_index_put_32 (unsigned char * c, ogg_uint32_t v)
+{
+  c[0] = v & 0xff;
+  c[1] = (v >> 8) & 0xff;
+  c[2] = (v >> 16) & 0xff;
+  c[3] = (v >> 24) & 0xff;
+}
+
+static void
+oggz_index_put_64 (unsigned char * c, ogg_int64_t v)
+{
+  oggz_index_put_32 (c, (ogg_uint32_t)(v & 0xffffffff));
+  oggz_index_put_32 (c+4, (ogg_uint32_t)((v >> 32) & 0xffffffff));
+}
+
+static oggz_off_t
+oggz_index_offset (OggzStreamIndex * sindex, int i)
+{
+  if (sindex->records != NULL)
+    return (oggz_off_t)
+      oggz_index_get_64 (sindex->records + i * OGGZ_INDEX_ENTRY_LEN);
+
+  return sindex->entries[i].offset;
+}
+
+static ogg_int64_t
+oggz_index_granulepos (OggzStreamIndex * sindex, int i)
+{
+  if (sindex->records != NULL)
+    return oggz_index_get_64 (sindex->records + i * OGGZ_INDEX_ENTRY_LEN + 8);
+
+  return sindex->entries[i].granulepos;
+}
+
+static OggzStreamIndex *
+oggz_index_get_stream (OggzTable * table, long serialno)
+{
+  OggzStreamIndex * sindex;
+
+  sindex = oggz_table_lookup (table, serialno);
+  if (sindex != NULL) return sindex;
+
+  sindex = oggz_malloc (sizeof (OggzStreamIndex));
+  if (sindex == NULL) return NULL;
+
+  sindex->entries = NULL;
+  sindex->records = NULL;
+  sindex->nr_entries = 0;
+  sindex->max_entries = 0;
+
+  if (oggz_table_insert (table, serialno, sindex) == NULL) {
+    oggz_free (sindex);
+    return NULL;
+  }
+
+  return sindex;
+}
+
+static int
+oggz_index_append (OggzStreamIndex * sindex, oggz_off_t offset,
+                   ogg_int64_t granulepos)
+{
+  OggzIndexEntry * entries;
+  int i, new_max;
+
+  if (sindex->records != NULL) {
+    /* Copy out the entries of a mapped index before extending it */
+    new_max = MAX (OGGZ_INDEX_MIN_ENTRIES, sindex->nr_entries * 2);
+    entries = oggz_malloc (new_max * sizeof (OggzIndexEntry));
+    if (entries == NULL) return -1;
+
+    for (i = 0; i < sindex->nr_entries; i++) {
+      entries[i].offset = oggz_index_offset (sindex, i);
+      entries[i].granulepos = oggz_index_granulepos (sindex, i);
+    }
+
+    sindex->entries = entries;
+    sindex->records = NULL;
+    sindex->max_entries = new_max;
+  }
+
+  if (sindex->nr_entries == sindex->max_entries) {
+    new_max = MAX (OGGZ_INDEX_MIN_ENTRIES, sindex->max_entries * 2);
+    entries = oggz_realloc (sindex->entries,
+                            new_max * sizeof (OggzIndexEntry));
+    if (entries == NULL) return -1;
+
+    sindex->entries = entries;
+    sindex->max_entries = new_max;
+  }
+
+  sindex->entries[sindex->nr_entries].offset = offset;
+  sindex->entries[sindex->nr_entries].granulepos = granulepos;
+  sindex->nr_entries++;
+
+  return 0;
+}
+
+static void
+oggz_index_table_delete (OggzTable * table)
+{
+  OggzStreamIndex * sindex;
+  int i, size;
+
+  size = oggz_table_size (table);
+  for (i = 0; i < size; i++) {
+    sindex = oggz_table_nth (table, i, NULL);
+    oggz_free (sindex->entries);
+    oggz_free (sindex);
+  }
+
+  oggz_table_delete (table);
+}
+
+void
+oggz_index_clear (OGGZ * oggz)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (reader->index != NULL) {
+    oggz_index_table_delete (reader->index);
+    reader->index = NULL;
+  }
+
+#ifdef OGGZ_INDEX_MMAP
+  if (reader->index_map != NULL) {
+    munmap (reader->index_map, reader->index_map_size);
+    reader->index_map = NULL;
+  }
+#endif
+
+  reader->index_end = 0;
+}
+
+int
+oggz_index_add_page (OGGZ * oggz, ogg_page * og, long serialno)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzStreamIndex * sindex;
+  ogg_int64_t granulepos;
+
+  /* Only pages following on directly from the indexed region are
+   * recorded, so that the index never has holes */
+  if (oggz->offset != reader->index_end) return 0;
+
+  granulepos = ogg_page_granulepos (og);
+
+  if (granulepos != -1) {
+    if (reader->index == NULL) {
+      if ((reader->index = oggz_table_new ()) == NULL)
+        return OGGZ_ERR_OUT_OF_MEMORY;
+    }
+
+    /* On failure the indexed region simply ends before this page */
+    if ((sindex = oggz_index_get_stream (reader->index, serialno)) == NULL ||
+        oggz_index_append (sindex, oggz->offset, granulepos) == -1)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+  }
+
+  reader->index_end += og->header_len + og->body_len;
+
+  return 0;
+}
+
+/*
+ * Find the first entry of sindex whose unit is greater than unit_target,
+ * or nr_entries if there is none. Units are nondecreasing within a
+ * logical bitstream.
+ */
+static int
+oggz_index_bsearch_unit (OGGZ * oggz, long serialno, OggzStreamIndex * sindex,
+                         ogg_int64_t unit_target)
+{
+  int lo = 0, hi = sindex->nr_entries, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (oggz_get_unit (oggz, serialno, oggz_index_granulepos (sindex, mid)) >
+        unit_target)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return lo;
+}
+
+/*
+ * Find the first entry of sindex at or after offset, or nr_entries if
+ * there is none.
+ */
+static int
+oggz_index_bsearch_offset (OggzStreamIndex * sindex, oggz_off_t offset)
+{
+  int lo = 0, hi = sindex->nr_entries, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (oggz_index_offset (sindex, mid) >= offset)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return lo;
+}
+
+int
+oggz_index_find (OGGZ * oggz, ogg_int64_t unit_target,
+                 oggz_off_t offset_begin, oggz_off_t offset_end,
+                 oggz_off_t * offset_found, ogg_int64_t * unit_found)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzStreamIndex * sindex;
+  oggz_off_t offset, offset_after, offset_at = -1, offset_prev;
+  ogg_int64_t unit, unit_at = -1, unit_max = -1;
+  long serialno;
+  int i, j, size, found_after = 0;
+
+  if (reader->index == NULL || reader->index_end <= 0) return 0;
+
+  size = oggz_table_size (reader->index);
+
+  /* Find the first page in the file whose unit is past the target */
+  offset_after = reader->index_end;
+  for (i = 0; i < size; i++) {
+    sindex = oggz_table_nth (reader->index, i, &serialno);
+    if (sindex->nr_entries == 0) continue;
+
+    unit = oggz_get_unit (oggz, serialno,
+                          oggz_index_granulepos (sindex, sindex->nr_entries-1));
+    if (unit == -1) continue; /* no metric for this bitstream */
+    if (unit > unit_max) unit_max = unit;
+
+    j = oggz_index_bsearch_unit (oggz, serialno, sindex, unit_target);
+    if (j < sindex->nr_entries &&
+        (offset = oggz_index_offset (sindex, j)) < offset_after) {
+      offset_after = offset;
+      found_after = 1;
+    }
+  }
+
+  if (!found_after) {
+    /* The target may lie beyond the indexed region */
+    if (reader->index_end < offset_end) return 0;
+
+    if (unit_target > unit_max) return -1;
+  }
+
+  /* Then the last page before that, which must be at or before the
+   * target */
+  for (i = 0; i < size; i++) {
+    sindex = oggz_table_nth (reader->index, i, &serialno);
+
+    j = oggz_index_bsearch_offset (sindex, offset_after) - 1;
+    if (j < 0) continue;
+
+    offset = oggz_index_offset (sindex, j);
+    if (offset <= offset_at || offset < offset_begin) continue;
+
+    unit = oggz_get_unit (oggz, serialno, oggz_index_granulepos (sindex, j));
+    if (unit == -1) continue;
+
+    offset_at = offset;
+    unit_at = unit;
+  }
+
+  if (offset_at == -1 || offset_at > offset_end) return 0;
+
+  /* As when bisecting, report the position in units of the last page
+   * before the one found */
+  offset_prev = -1;
+  for (i = 0; i < size; i++) {
+    sindex = oggz_table_nth (reader->index, i, &serialno);
+
+    j = oggz_index_bsearch_offset (sindex, offset_at) - 1;
+    if (j < 0) continue;
+
+    offset = oggz_index_offset (sindex, j);
+    if (offset <= offset_prev) continue;
+
+    unit = oggz_get_unit (oggz, serialno, oggz_index_granulepos (sindex, j));
+    if (unit == -1) continue;
+
+    offset_prev = offset;
+    unit_at = unit;
+  }
+
+#ifdef DEBUG
+  printf ("oggz_index_find: u%lld found u%lld @%" PRI_OGGZ_OFF_T "d\n",
+          unit_target, unit_at, offset_at);
+#endif
+
+  *offset_found = offset_at;
+  *unit_found = unit_at;
+
+  return 1;
+}
+
+int
+oggz_index_last_unit (OGGZ * oggz, oggz_off_t offset_end,
+                      ogg_int64_t * unit_found)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzStreamIndex * sindex;
+  oggz_off_t offset, offset_at = -1;
+  ogg_int64_t unit, unit_at = -1;
+  long serialno;
+  int i, size;
+
+  if (reader->index == NULL || reader->index_end < offset_end) return 0;
+
+  size = oggz_table_size (reader->index);
+  for (i = 0; i < size; i++) {
+    sindex = oggz_table_nth (reader->index, i, &serialno);
+    if (sindex->nr_entries == 0) continue;
+
+    offset = oggz_index_offset (sindex, sindex->nr_entries-1);
+    if (offset <= offset_at) continue;
+
+    unit = oggz_get_unit (oggz, serialno,
+                          oggz_index_granulepos (sindex, sindex->nr_entries-1));
+    if (unit == -1) continue;
+
+    offset_at = offset;
+    unit_at = unit;
+  }
+
+  if (offset_at == -1) return 0;
+
+  *unit_found = unit_at;
+
+  return 1;
+}
+
+/*
+ * Keypoints from a Skeleton 4.0 index. Each keypoint gives the offset of
+ * a page from which a logical bitstream can be decoded, and the time in
+ * units from which it can then be presented; the time is kept in the
+ * granulepos field of the entries.
+ */
+
+void
+oggz_index_keypoints_reset (OGGZ * oggz, ogg_int64_t segment_length)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (oggz->flags & OGGZ_WRITE) return;
+
+  if (reader->keypoints != NULL) {
+    oggz_index_table_delete (reader->keypoints);
+    reader->keypoints = NULL;
+  }
+
+  reader->keypoints_length = segment_length;
+}
+
+int
+oggz_index_add_keypoint (OGGZ * oggz, long serialno, oggz_off_t offset,
+                         ogg_int64_t unit)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzStreamIndex * sindex;
+  int n;
+
+  if (oggz->flags & OGGZ_WRITE) return -1;
+
+  if (reader->keypoints == NULL &&
+      (reader->keypoints = oggz_table_new ()) == NULL)
+    return -1;
+
+  sindex = oggz_index_get_stream (reader->keypoints, serialno);
+  if (sindex == NULL) return -1;
+
+  /* Keypoints must be in order of both offset and time; this also
+   * rejects an index packet which is read a second time */
+  n = sindex->nr_entries;
+  if (n > 0 && (offset <= oggz_index_offset (sindex, n-1) ||
+                unit < oggz_index_granulepos (sindex, n-1)))
+    return -1;
+
+  return oggz_index_append (sindex, offset, unit);
+}
+
+int
+oggz_index_find_keypoint (OGGZ * oggz, ogg_int64_t unit_target,
+                          oggz_off_t offset_begin, oggz_off_t offset_end,
+                          oggz_off_t * offset_found, ogg_int64_t * unit_found)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzStreamIndex * sindex;
+  oggz_off_t offset, offset_at = -1;
+  ogg_int64_t unit_at = -1;
+  int i, size, lo, hi, mid;
+
+  if (reader->keypoints == NULL) return 0;
+
+  /* The index is not valid if the segment has changed length */
+  if (reader->keypoints_length > 0 && reader->keypoints_length != offset_end)
+    return 0;
+
+  /* Every bitstream must be decoded from its last keypoint at or before
+   * the target, so start from the earliest of these */
+  size = oggz_table_size (reader->keypoints);
+  for (i = 0; i < size; i++) {
+    sindex = oggz_table_nth (reader->keypoints, i, NULL);
+    if (sindex->nr_entries == 0) continue;
+
+    lo = 0;
+    hi = sindex->nr_entries;
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (oggz_index_granulepos (sindex, mid) <= unit_target) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    /* No keypoint for this bitstream; fall back to bisection */
+    if (lo == 0) return 0;
+
+    offset = oggz_index_offset (sindex, lo-1);
+    if (offset_at == -1 || offset < offset_at) offset_at = offset;
+
+    if (unit_at == -1 || oggz_index_granulepos (sindex, lo-1) < unit_at)
+      unit_at = oggz_index_granulepos (sindex, lo-1);
+  }
+
+  if (offset_at < offset_begin || offset_at >= offset_end) return 0;
+
+#ifdef DEBUG
+  printf ("oggz_index_find_keypoint: %lld -> offset %" PRI_OGGZ_OFF_T "d\n",
+          unit_target, offset_at);
+#endif
+
+  *offset_found = offset_at;
+  *unit_found = unit_at;
+
+  return 1;
+}
+
+/*
+ * Retrieve the size and modification time of the file being read, for
+ * checking that an index belongs to it.
+ */
+static int
+oggz_index_file_stat (OGGZ * oggz, ogg_int64_t * size, ogg_int64_t * mtime)
+{
+  struct stat statbuf;
+  int fd;
+
+  if (oggz->file == NULL) return -1;
+
+  if ((fd = fileno (oggz->file)) == -1) return -1;
+  if (fstat (fd, &statbuf) == -1) return -1;
+  if (!oggz_stat_regular (statbuf.st_mode)) return -1;
+
+  *size = (ogg_int64_t)statbuf.st_size;
+  *mtime = (ogg_int64_t)statbuf.st_mtime;
+
+  return 0;
+}
+
+/*
+ * Replace the index of oggz with the exported index in buf. If in_place
+ * is set, the entries are searched where they lie in buf, which must
+ * then remain valid for as long as the index is used. If sidecar is set,
+ * an index which does not record the size and modification time of the
+ * file it was made from is refused.
+ */
+static int
+oggz_index_parse (OGGZ * oggz, const unsigned char * buf, long n,
+                  int in_place, int sidecar)
+{
+  OggzReader * reader;
+  OggzTable * table;
+  OggzStreamIndex * sindex;
+  const unsigned char * c, * end;
+  oggz_off_t index_end, offset, offset_prev;
+  ogg_int64_t granulepos, file_size, file_mtime, size, mtime;
+  ogg_uint32_t nr_streams, nr_entries, i, j;
+  long serialno;
+
+  if (buf == NULL || n < OGGZ_INDEX_HEADER_LEN ||
+      memcmp (buf, OGGZ_INDEX_MAGIC, 7) != 0 ||
+      buf[7] != OGGZ_INDEX_VERSION)
+    return OGGZ_ERR_INVALID;
+
+  file_size = oggz_index_get_64 (buf+8);
+  file_mtime = oggz_index_get_64 (buf+16);
+  index_end = oggz_index_get_64 (buf+24);
+  nr_streams = oggz_index_get_32 (buf+32);
+  if (index_end < 0) return OGGZ_ERR_INVALID;
+
+  /* Refuse an index made from a different version of the file */
+  if (file_size != 0 && oggz_index_file_stat (oggz, &size, &mtime) == 0 &&
+      (size != file_size || mtime != file_mtime))
+    return OGGZ_ERR_INVALID;
+
+  /* An index file found next to the Ogg file must have been made from it */
+  if (sidecar && file_size == 0)
+    return OGGZ_ERR_INVALID;
+
+  if ((table = oggz_table_new ()) == NULL)
+    return OGGZ_ERR_OUT_OF_MEMORY;
+
+  c = buf + OGGZ_INDEX_HEADER_LEN;
+  end = buf + n;
+
+  for (i = 0; i < nr_streams; i++) {
+    if (end - c < OGGZ_INDEX_STREAM_LEN) goto err_invalid;
+
+    serialno = (long)(ogg_int32_t)oggz_index_get_32 (c);
+    nr_entries = oggz_index_get_32 (c+4);
+    c += OGGZ_INDEX_STREAM_LEN;
+
+    if (oggz_table_lookup (table, serialno) != NULL ||
+        (end - c) / OGGZ_INDEX_ENTRY_LEN < (long)nr_entries)
+      goto err_invalid;
+
+    if ((sindex = oggz_index_get_stream (table, serialno)) == NULL)
+      goto err_out_of_memory;
+
+    if (in_place) {
+      sindex->records = c;
+      sindex->nr_entries = (int)nr_entries;
+    }
+
+    offset_prev = -1;
+    for (j = 0; j < nr_entries; j++) {
+      offset = oggz_index_get_64 (c);
+      granulepos = oggz_index_get_64 (c+8);
+      c += OGGZ_INDEX_ENTRY_LEN;
+
+      if (offset <= offset_prev || offset >= index_end || granulepos == -1)
+        goto err_invalid;
+      offset_prev = offset;
+
+      if (!in_place && oggz_index_append (sindex, offset, granulepos) == -1)
+        goto err_out_of_memory;
+    }
+  }
+
+  reader = &oggz->x.reader;
+
+  oggz_index_clear (oggz);
+  reader->index = table;
+  reader->index_end = index_end;
+
+  return 0;
+
+err_invalid:
+  oggz_index_table_delete (table);
+  return OGGZ_ERR_INVALID;
+
+err_out_of_memory:
+  oggz_index_table_delete (table);
+  return OGGZ_ERR_OUT_OF_MEMORY;
+}
+
+int
+oggz_index_open (OGGZ * oggz, const char * filename)
+{
+  OggzReader * reader = &oggz->x.reader;
+  FILE * file;
+  struct stat statbuf;
+  unsigned char * data;
+  char * path;
+  size_t len;
+  int ret = -1;
+
+  len = strlen (filename);
+  path = oggz_malloc (len + sizeof (OGGZ_SEEK_INDEX_SUFFIX));
+  if (path == NULL) return -1;
+
+  memcpy (path, filename, len);
+  memcpy (path + len, OGGZ_SEEK_INDEX_SUFFIX, sizeof (OGGZ_SEEK_INDEX_SUFFIX));
+
+  file = fopen (path, "rb");
+  oggz_free (path);
+  if (file == NULL) return -1;
+
+  if (fstat (fileno (file), &statbuf) == -1 ||
+      statbuf.st_size < OGGZ_INDEX_HEADER_LEN ||
+      (oggz_off_t)(long)statbuf.st_size != statbuf.st_size) {
+    fclose (file);
+    return -1;
+  }
+
+  len = (size_t)statbuf.st_size;
+
+#ifdef OGGZ_INDEX_MMAP
+  data = mmap (NULL, len, PROT_READ, MAP_SHARED, fileno (file), 0);
+  fclose (file);
+  if (data == MAP_FAILED) return -1;
+
+  if (oggz_index_parse (oggz, data, (long)len, 1, 1) == 0) {
+    reader->index_map = data;
+    reader->index_map_size = len;
+    ret = 0;
+  } else {
+    munmap (data, len);
+  }
+#else
+  data = oggz_malloc (len);
+  if (data != NULL && fread (data, 1, len, file) == len)
+    ret = oggz_index_parse (oggz, data, (long)len, 0, 1) == 0 ? 0 : -1;
+  fclose (file);
+  oggz_free (data);
+#endif
+
+#ifdef DEBUG
+  printf ("oggz_index_open: %s index for %s\n", ret ? "no" : "loaded",
+          filename);
+#endif
+
+  return ret;
+}
+
+int
+oggz_seek_index_enable (OGGZ * oggz)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  oggz->x.reader.index_record = 1;
+
+  return 0;
+}
+
+long
+oggz_seek_index_export (OGGZ * oggz, unsigned char * buf, long n)
+{
+  OggzReader * reader;
+  OggzStreamIndex * sindex;
+  ogg_int64_t size = 0, mtime = 0;
+  unsigned char * c;
+  long len, serialno;
+  int i, j, nr_streams;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  reader = &oggz->x.reader;
+
+  nr_streams = oggz_table_size (reader->index);
+
+  len = OGGZ_INDEX_HEADER_LEN;
+  for (i = 0; i < nr_streams; i++) {
+    sindex = oggz_table_nth (reader->index, i, NULL);
+    len += OGGZ_INDEX_STREAM_LEN + sindex->nr_entries * OGGZ_INDEX_ENTRY_LEN;
+  }
+
+  if (buf == NULL || n < len) return len;
+
+  oggz_index_file_stat (oggz, &size, &mtime);
+
+  c = buf;
+  memcpy (c, OGGZ_INDEX_MAGIC, 7);
+  c[7] = OGGZ_INDEX_VERSION;
+  oggz_index_put_64 (c+8, size);
+  oggz_index_put_64 (c+16, mtime);
+  oggz_index_put_64 (c+24, reader->index_end);
+  oggz_index_put_32 (c+32, (ogg_uint32_t)nr_streams);
+  oggz_index_put_32 (c+36, 0);
+  c += OGGZ_INDEX_HEADER_LEN;
+
+  for (i = 0; i < nr_streams; i++) {
+    sindex = oggz_table_nth (reader->index, i, &serialno);
+    oggz_index_put_32 (c, (ogg_uint32_t)serialno);
+    oggz_index_put_32 (c+4, (ogg_uint32_t)sindex->nr_entries);
+    c += OGGZ_INDEX_STREAM_LEN;
+
+    for (j = 0; j < sindex->nr_entries; j++) {
+      oggz_index_put_64 (c, oggz_index_offset (sindex, j));
+      oggz_index_put_64 (c+8, oggz_index_granulepos (sindex, j));
+      c += OGGZ_INDEX_ENTRY_LEN;
+    }
+  }
+
+  return len;
+}
+
+int
+oggz_seek_index_import (OGGZ * oggz, const unsigned char * buf, long n)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  return oggz_index_parse (oggz, buf, n, 0, 0);
+}
+
+#else /* OGGZ_CONFIG_READ */
+
+#include <ogg/ogg.h>
+#include "oggz_private.h"
+
+int
+oggz_index_open (OGGZ * oggz, const char * filename)
+{
+  return -1;
+}
+
+void
+oggz_index_keypoints_reset (OGGZ * oggz, ogg_int64_t segment_length)
+{
+}
+
+int
+oggz_index_add_keypoint (OGGZ * oggz, long serialno, oggz_off_t offset,
+                         ogg_int64_t unit)
+{
+  return -1;
+}
+
+int
+oggz_seek_index_enable (OGGZ * oggz)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+long
+oggz_seek_index_export (OGGZ * oggz, unsigned char * buf, long n)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_seek_index_import (OGGZ * oggz, const unsigned char * buf, long n)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+#endif
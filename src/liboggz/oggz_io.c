@@ -44,18 +44,37 @@
 #include <string.h>
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include "oggz_compat.h"
 #include "oggz_private.h"
 
 /*#define DEBUG*/
 
+/*
+ * oggz_io_read_raw (oggz, buf, n)
+ *
+ * Read directly from the handle's file (through io_uring if enabled) or
+ * I/O callbacks, bypassing any file mapping or read-ahead. This is called
+ * from the read-ahead helper thread when one is running.
+ */
 size_t
-oggz_io_read (OGGZ * oggz, void * buf, size_t n)
+oggz_io_read_raw (OGGZ * oggz, void * buf, size_t n)
 {
   OggzIO * io;
   size_t bytes;
 
-  if (oggz->file != NULL) {
+  if (oggz->uring != NULL) {
+    bytes = oggz_uring_read (oggz, buf, n);
+  }
+
+  else if (oggz->file != NULL) {
     if ((bytes = read (fileno(oggz->file), buf, n)) == 0) {
       if (ferror (oggz->file)) {
         return (size_t) OGGZ_ERR_SYSTEM;
@@ -73,6 +92,18 @@ oggz_io_read (OGGZ * oggz, void * buf, size_t n)
   return bytes;
 }
 
+size_t
+oggz_io_read (OGGZ * oggz, void * buf, size_t n)
+{
+  if (oggz->map != NULL)
+    return oggz_mmap_read (oggz, buf, n);
+
+  if (oggz->readahead != NULL)
+    return oggz_readahead_read (oggz, buf, n);
+
+  return oggz_io_read_raw (oggz, buf, n);
+}
+
 size_t
 oggz_io_write (OGGZ * oggz, void * buf, size_t n)
 {
@@ -95,12 +126,122 @@ oggz_io_write (OGGZ * oggz, void * buf, size_t n)
   return bytes;
 }
 
+/*
+ * oggz_io_can_writev (oggz)
+ *
+ * Whether oggz_io_writev() writes several regions with one call.
+ */
 int
-oggz_io_seek (OGGZ * oggz, long offset, int whence)
+oggz_io_can_writev (OGGZ * oggz)
+{
+#ifdef HAVE_SYS_UIO_H
+  if (oggz->file != NULL) return (fileno (oggz->file) != -1);
+#endif
+
+  return (oggz->io != NULL && oggz->io->writev != NULL);
+}
+
+#ifdef HAVE_SYS_UIO_H
+/*
+ * Write all of iov to fd, resuming after short writes. Returns the
+ * number of bytes written, or -1 on error.
+ */
+static long
+oggz_io_writev_fd (int fd, const OggzIOVec * iov, int iovcnt)
+{
+  struct iovec v[OGGZ_IOV_MAX];
+  ssize_t bytes;
+  long total = 0;
+  size_t skip = 0;
+  int i, n;
+
+  while (iovcnt > 0) {
+    n = MIN (iovcnt, OGGZ_IOV_MAX);
+    for (i = 0; i < n; i++) {
+      v[i].iov_base = iov[i].base;
+      v[i].iov_len = iov[i].len;
+    }
+    v[0].iov_base = (char *)v[0].iov_base + skip;
+    v[0].iov_len -= skip;
+
+    bytes = writev (fd, v, n);
+    if (bytes == -1 && errno == EINTR) continue;
+    if (bytes == -1) return -1;
+
+    total += (long)bytes;
+
+    /* Step past the regions written */
+    bytes += (ssize_t)skip;
+    skip = 0;
+    while (iovcnt > 0 && (size_t)bytes >= iov[0].len) {
+      bytes -= (ssize_t)iov[0].len;
+      iov++;
+      iovcnt--;
+    }
+    skip = (size_t)bytes;
+  }
+
+  return total;
+}
+#endif
+
+/*
+ * oggz_io_writev (oggz, iov, iovcnt)
+ *
+ * Write iovcnt regions in order: with writev() on a file, through an
+ * OggzIOWritev callback, or else one at a time with oggz_io_write().
+ * Returns the number of bytes written, or OGGZ_ERR_SYSTEM on error.
+ */
+long
+oggz_io_writev (OGGZ * oggz, const OggzIOVec * iov, int iovcnt)
 {
   OggzIO * io;
+  long total = 0;
+  size_t bytes;
+  int i;
 
-  if (oggz->file != NULL) {
+#ifdef HAVE_SYS_UIO_H
+  if (oggz->file != NULL && fileno (oggz->file) != -1) {
+    /* Anything written through stdio must go out first */
+    if (fflush (oggz->file) == EOF) return OGGZ_ERR_SYSTEM;
+
+    total = oggz_io_writev_fd (fileno (oggz->file), iov, iovcnt);
+    return (total < 0) ? OGGZ_ERR_SYSTEM : total;
+  }
+#endif
+
+  if ((io = oggz->io) != NULL && io->writev != NULL) {
+    total = io->writev (io->writev_user_handle, iov, iovcnt);
+    return (total < 0) ? OGGZ_ERR_SYSTEM : total;
+  }
+
+  for (i = 0; i < iovcnt; i++) {
+    bytes = oggz_io_write (oggz, iov[i].base, iov[i].len);
+    if ((long)bytes < 0) return OGGZ_ERR_SYSTEM;
+    total += (long)bytes;
+  }
+
+  return total;
+}
+
+int
+oggz_io_seek_raw (OGGZ * oggz, long offset, int whence)
+{
+  OggzIO * io;
+
+  if (oggz->uring != NULL) {
+    if (oggz_uring_seek (oggz, offset, whence) == -1)
+      return OGGZ_ERR_SYSTEM;
+  }
+
+  else if (oggz->file != NULL && (oggz->flags & OGGZ_WRITE) == 0) {
+    /* Reads bypass stdio with read(), so move the descriptor directly;
+     * fseek() may leave it part of a buffered block further on */
+    if (lseek (fileno (oggz->file), (off_t)offset, whence) == -1)
+      return OGGZ_ERR_SYSTEM;
+  }
+
+  else if (oggz->file != NULL) {
     if (fseek (oggz->file, offset, whence) == -1) {
       if (errno == ESPIPE) {
 	/*oggz_set_error (oggz, OGGZ_ERR_NOSEEK);*/
@@ -122,13 +263,39 @@ oggz_io_seek (OGGZ * oggz, long offset, int whence)
   return 0;
 }
 
+int
+oggz_io_seek (OGGZ * oggz, long offset, int whence)
+{
+  if (oggz->map != NULL) {
+    if (oggz_mmap_seek (oggz, offset, whence) == -1)
+      return OGGZ_ERR_SYSTEM;
+    return 0;
+  }
+
+  /* Stop any read-ahead, so that the seek is relative to the data
+   * actually consumed */
+  if (oggz_readahead_stop (oggz) == -1)
+    return OGGZ_ERR_SYSTEM;
+
+  return oggz_io_seek_raw (oggz, offset, whence);
+}
+
 long
-oggz_io_tell (OGGZ * oggz)
+oggz_io_tell_raw (OGGZ * oggz)
 {
   OggzIO * io;
   long offset;
 
-  if (oggz->file != NULL) {
+  if (oggz->uring != NULL) {
+    offset = oggz_uring_tell (oggz);
+  }
+
+  else if (oggz->file != NULL && (oggz->flags & OGGZ_WRITE) == 0) {
+    if ((offset = (long) lseek (fileno (oggz->file), 0, SEEK_CUR)) == -1)
+      return -1;
+  }
+
+  else if (oggz->file != NULL) {
     if ((offset = ftell (oggz->file)) == -1) {
       if (errno == ESPIPE) {
 	/*oggz_set_error (oggz, OGGZ_ERR_NOSEEK);*/
@@ -150,6 +317,18 @@ oggz_io_tell (OGGZ * oggz)
   return offset;
 }
 
+long
+oggz_io_tell (OGGZ * oggz)
+{
+  if (oggz->map != NULL)
+    return oggz_mmap_tell (oggz);
+
+  if (oggz->readahead != NULL)
+    return oggz_readahead_tell (oggz);
+
+  return oggz_io_tell_raw (oggz);
+}
+
 int
 oggz_io_flush (OGGZ * oggz)
 {
@@ -175,6 +354,388 @@ oggz_io_flush (OGGZ * oggz)
   return 0;
 }
 
+/*
+ * oggz_io_pread (fd, probe)
+ *
+ * Fill probe->buf from probe->offset of the file fd, without moving the
+ * file position.
+ */
+static void
+oggz_io_pread (int fd, OggzIOProbe * probe)
+{
+  ssize_t bytes;
+
+  probe->len = 0;
+
+  while (probe->len < probe->n) {
+    bytes = pread (fd, probe->buf + probe->len, probe->n - probe->len,
+                   (off_t)(probe->offset + probe->len));
+    if (bytes == -1 && errno == EINTR) continue;
+    if (bytes == -1) {
+      probe->len = -1;
+      return;
+    }
+    if (bytes == 0) return;
+    probe->len += bytes;
+  }
+}
+
+/*
+ * oggz_io_can_read_at (oggz)
+ *
+ * Whether oggz_io_read_at() can read from this handle.
+ */
+int
+oggz_io_can_read_at (OGGZ * oggz)
+{
+  if (oggz->flags & OGGZ_WRITE) return 0;
+
+  if (oggz->map != NULL || oggz->uring != NULL) return 1;
+
+  if (oggz->file != NULL) return (fileno (oggz->file) != -1);
+
+  return (oggz->io != NULL && oggz->io->read_at != NULL);
+}
+
+/*
+ * oggz_io_read_at (oggz, buf, n, offset)
+ *
+ * Read up to n bytes at offset into buf, without seeking: from a
+ * mapping, with io_uring or pread() on a file, or through an
+ * OggzIOReadAt callback. The position of sequential reads is unchanged.
+ * Returns the number of bytes read, which is short only at end of
+ * file, or an OGGZ_ERR_* if oggz_io_can_read_at() is false or the
+ * read fails.
+ */
+long
+oggz_io_read_at (OGGZ * oggz, unsigned char * buf, long n, oggz_off_t offset)
+{
+  OggzIOProbe probe;
+  OggzIO * io;
+  size_t bytes;
+  long len = 0;
+  int err;
+
+  if (!oggz_io_can_read_at (oggz)) return OGGZ_ERR_INVALID;
+
+  probe.offset = offset;
+  probe.buf = buf;
+  probe.n = n;
+  probe.len = -1;
+
+  if (oggz->map != NULL) {
+    if (offset >= oggz->map->size) return 0;
+    if ((oggz_off_t)n > oggz->map->size - offset)
+      n = (long)(oggz->map->size - offset);
+    memcpy (buf, oggz->map->data + offset, (size_t)n);
+    return n;
+  }
+
+  else if (oggz->uring != NULL) {
+    if ((err = oggz_uring_read_multi (oggz, &probe, 1)) != 0) return err;
+  }
+
+  else if (oggz->file != NULL) {
+    oggz_io_pread (fileno (oggz->file), &probe);
+  }
+
+  else {
+    io = oggz->io;
+    while (len < n) {
+      bytes = io->read_at (io->read_at_user_handle, buf + len,
+                           (size_t)(n - len), offset + len);
+      if ((long)bytes < 0) return OGGZ_ERR_SYSTEM;
+      if (bytes == 0) break;
+      len += (long)bytes;
+    }
+    return len;
+  }
+
+  if (probe.len < 0) return OGGZ_ERR_SYSTEM;
+
+  return probe.len;
+}
+
+/******** Positional read pool ********/
+
+#ifdef HAVE_PTHREAD
+
+/* The most threads a pool keeps for one handle */
+#define OGGZ_IO_POOL_MAX 8
+
+/*
+ * Worker threads which take the probes of one oggz_io_read_multi() call
+ * in turn, along with the caller, until none are left.
+ */
+struct _OggzIOPool {
+  pthread_t threads[OGGZ_IO_POOL_MAX];
+  int nr_threads;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t work; /* signalled when probes are given, or on close */
+  pthread_cond_t done; /* signalled when the last probe is read */
+
+  int fd;
+  OggzIOProbe * probes;
+  int n;
+  int next; /* the next probe to take */
+  int pending; /* probes not yet read */
+  int quit;
+};
+
+/*
+ * Take and read probes until none are left. Called with the mutex held.
+ */
+static void
+oggz_io_pool_take (OggzIOPool * pool)
+{
+  int i;
+
+  while (pool->next < pool->n) {
+    i = pool->next++;
+
+    pthread_mutex_unlock (&pool->mutex);
+    oggz_io_pread (pool->fd, &pool->probes[i]);
+    pthread_mutex_lock (&pool->mutex);
+
+    if (--pool->pending == 0) pthread_cond_signal (&pool->done);
+  }
+}
+
+static void *
+oggz_io_pool_thread (void * data)
+{
+  OggzIOPool * pool = (OggzIOPool *)data;
+
+  pthread_mutex_lock (&pool->mutex);
+
+  while (!pool->quit) {
+    oggz_io_pool_take (pool);
+    if (!pool->quit) pthread_cond_wait (&pool->work, &pool->mutex);
+  }
+
+  pthread_mutex_unlock (&pool->mutex);
+
+  return NULL;
+}
+
+/*
+ * oggz_io_pool_close (oggz)
+ *
+ * Stop the positional read threads of oggz, if any.
+ */
+int
+oggz_io_pool_close (OGGZ * oggz)
+{
+  OggzIOPool * pool = oggz->io_pool;
+  int i;
+
+  if (pool == NULL) return 0;
+
+  pthread_mutex_lock (&pool->mutex);
+  pool->quit = 1;
+  pthread_cond_broadcast (&pool->work);
+  pthread_mutex_unlock (&pool->mutex);
+
+  for (i = 0; i < pool->nr_threads; i++)
+    pthread_join (pool->threads[i], NULL);
+
+  pthread_cond_destroy (&pool->done);
+  pthread_cond_destroy (&pool->work);
+  pthread_mutex_destroy (&pool->mutex);
+
+  oggz_free (pool);
+  oggz->io_pool = NULL;
+
+  return 0;
+}
+
+/*
+ * oggz_io_pool_open (oggz, nr_reads)
+ *
+ * Start threads for oggz_io_read_multi() to make up to nr_reads reads
+ * of the file of oggz at once, replacing any already started. Nothing is
+ * started unless the file can be read positionally, or for one read at
+ * a time. Returns 0 on success, or an OGGZ_ERR_* on failure, in which
+ * case reads are made in turn.
+ */
+int
+oggz_io_pool_open (OGGZ * oggz, int nr_reads)
+{
+  OggzIOPool * pool;
+
+  oggz_io_pool_close (oggz);
+
+  if (nr_reads < 2 || oggz->map != NULL || oggz->uring != NULL ||
+      oggz->file == NULL || fileno (oggz->file) == -1)
+    return 0;
+
+  pool = oggz_malloc (sizeof (OggzIOPool));
+  if (pool == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  memset (pool, 0, sizeof (OggzIOPool));
+
+  if (pthread_mutex_init (&pool->mutex, NULL) != 0) goto err_mutex;
+  if (pthread_cond_init (&pool->work, NULL) != 0) goto err_work;
+  if (pthread_cond_init (&pool->done, NULL) != 0) goto err_done;
+
+  /* The caller makes one of the reads itself */
+  while (pool->nr_threads < MIN (nr_reads - 1, OGGZ_IO_POOL_MAX)) {
+    if (pthread_create (&pool->threads[pool->nr_threads], NULL,
+                        oggz_io_pool_thread, pool) != 0)
+      break;
+    pool->nr_threads++;
+  }
+
+  oggz->io_pool = pool;
+
+  if (pool->nr_threads == 0) {
+    oggz_io_pool_close (oggz);
+    return OGGZ_ERR_SYSTEM;
+  }
+
+  return 0;
+
+err_done:
+  pthread_cond_destroy (&pool->work);
+err_work:
+  pthread_mutex_destroy (&pool->mutex);
+err_mutex:
+  oggz_free (pool);
+  return OGGZ_ERR_SYSTEM;
+}
+
+/*
+ * Read the n probes from fd with the pool threads and the caller.
+ */
+static void
+oggz_io_pool_read (OggzIOPool * pool, int fd, OggzIOProbe * probes, int n)
+{
+  pthread_mutex_lock (&pool->mutex);
+
+  pool->fd = fd;
+  pool->probes = probes;
+  pool->n = n;
+  pool->next = 0;
+  pool->pending = n;
+  pthread_cond_broadcast (&pool->work);
+
+  oggz_io_pool_take (pool);
+
+  while (pool->pending > 0)
+    pthread_cond_wait (&pool->done, &pool->mutex);
+
+  pool->probes = NULL;
+  pool->n = 0;
+  pool->next = 0;
+
+  pthread_mutex_unlock (&pool->mutex);
+}
+
+#else /* HAVE_PTHREAD */
+
+int
+oggz_io_pool_open (OGGZ * oggz, int nr_reads)
+{
+  return 0;
+}
+
+int
+oggz_io_pool_close (OGGZ * oggz)
+{
+  return 0;
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*
+ * oggz_io_read_multi (oggz, probes, n)
+ *
+ * Make n positional reads, concurrently where the backend allows: as a
+ * batch of io_uring reads, or on a plain file with the threads started
+ * by oggz_io_pool_open().
+ * Reads through I/O callbacks or a mapping are made one at a time, with
+ * oggz_io_read_at() where possible.
+ * The file position is left undefined.
+ * Returns 0 on success, or an OGGZ_ERR_* if the reads could not be made
+ * at all; an individual read which fails has its len set to -1.
+ */
+int
+oggz_io_read_multi (OGGZ * oggz, OggzIOProbe * probes, int n)
+{
+  size_t bytes;
+  int fd, i;
+
+  if (oggz->uring != NULL) return oggz_uring_read_multi (oggz, probes, n);
+
+  if (oggz->map == NULL && oggz->file != NULL &&
+      (fd = fileno (oggz->file)) != -1) {
+#ifdef HAVE_PTHREAD
+    /* The read-ahead thread may be moving the file position, but
+     * positional reads do not use it */
+    if (oggz->io_pool != NULL && n > 1) {
+      oggz_io_pool_read (oggz->io_pool, fd, probes, n);
+      return 0;
+    }
+#endif
+
+    for (i = 0; i < n; i++) oggz_io_pread (fd, &probes[i]);
+    return 0;
+  }
+
+  for (i = 0; i < n; i++) {
+    probes[i].len = 0;
+
+    if (oggz_io_can_read_at (oggz)) {
+      probes[i].len = oggz_io_read_at (oggz, probes[i].buf, probes[i].n,
+                                       probes[i].offset);
+      if (probes[i].len < 0) probes[i].len = -1;
+      continue;
+    }
+
+    if (oggz_io_seek (oggz, (long)probes[i].offset, SEEK_SET) != 0) {
+      probes[i].len = -1;
+      continue;
+    }
+
+    while (probes[i].len < probes[i].n) {
+      bytes = oggz_io_read (oggz, probes[i].buf + probes[i].len,
+                            probes[i].n - probes[i].len);
+      if ((long)bytes < 0) {
+        probes[i].len = -1;
+        break;
+      }
+      if (bytes == 0) break;
+      probes[i].len += bytes;
+    }
+  }
+
+  return 0;
+}
+
+int
+oggz_io_set_uring (OGGZ * oggz, int depth)
+{
+  int ret;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+  if (oggz->file == NULL) return OGGZ_ERR_INVALID;
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+  if (depth < 0) return OGGZ_ERR_INVALID;
+
+  /* The read-ahead thread may be reading through the current backend */
+  if (oggz_readahead_stop (oggz) == -1) return OGGZ_ERR_SYSTEM;
+
+  oggz_uring_close (oggz);
+
+  if (depth == 0) return 0;
+
+  if ((ret = oggz_uring_init (oggz, depth)) != 0)
+    return ret;
+
+  return 0;
+}
+
 /* get/set functions */
 
 static int
@@ -199,6 +760,8 @@ oggz_io_set_read (OGGZ * oggz, OggzIORead read, void * user_handle)
       return OGGZ_ERR_OUT_OF_MEMORY;
   }
 
+  oggz_readahead_stop (oggz);
+
   oggz->io->read = read;
   oggz->io->read_user_handle = user_handle;
 
@@ -255,6 +818,8 @@ oggz_io_set_seek (OGGZ * oggz, OggzIOSeek seek, void * user_handle)
       return OGGZ_ERR_OUT_OF_MEMORY;
   }
 
+  oggz_readahead_stop (oggz);
+
   oggz->io->seek = seek;
   oggz->io->seek_user_handle = user_handle;
 
@@ -283,6 +848,8 @@ oggz_io_set_tell (OGGZ * oggz, OggzIOTell tell, void * user_handle)
       return OGGZ_ERR_OUT_OF_MEMORY;
   }
 
+  oggz_readahead_stop (oggz);
+
   oggz->io->tell = tell;
   oggz->io->tell_user_handle = user_handle;
 
@@ -327,3 +894,61 @@ oggz_io_get_flush_user_handle (OGGZ * oggz)
 
   return oggz->io->flush_user_handle;
 }
+
+int
+oggz_io_set_read_at (OGGZ * oggz, OggzIOReadAt read_at, void * user_handle)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+  if (oggz->file != NULL) return OGGZ_ERR_INVALID;
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+
+  if (oggz->io == NULL) {
+    if (oggz_io_init (oggz) == -1)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+  }
+
+  oggz->io->read_at = read_at;
+  oggz->io->read_at_user_handle = user_handle;
+
+  return 0;
+}
+
+void *
+oggz_io_get_read_at_user_handle (OGGZ * oggz)
+{
+  if (oggz == NULL) return NULL;
+  if (oggz->file != NULL) return NULL;
+
+  if (oggz->io == NULL) return NULL;
+
+  return oggz->io->read_at_user_handle;
+}
+
+int
+oggz_io_set_writev (OGGZ * oggz, OggzIOWritev writev, void * user_handle)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+  if (oggz->file != NULL) return OGGZ_ERR_INVALID;
+  if (!(oggz->flags & OGGZ_WRITE)) return OGGZ_ERR_INVALID;
+
+  if (oggz->io == NULL) {
+    if (oggz_io_init (oggz) == -1)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+  }
+
+  oggz->io->writev = writev;
+  oggz->io->writev_user_handle = user_handle;
+
+  return 0;
+}
+
+void *
+oggz_io_get_writev_user_handle (OGGZ * oggz)
+{
+  if (oggz == NULL) return NULL;
+  if (oggz->file != NULL) return NULL;
+
+  if (oggz->io == NULL) return NULL;
+
+  return oggz->io->writev_user_handle;
+}
@@ -0,0 +1,264 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_mmap.c
+ *
+ * Zero-copy reading of regular files via mmap(). Pages are located and
+ * checked directly in the mapping, so ogg_page header and body pointers
+ * refer to the mapped file data rather than to a copy in the ogg_sync
+ * buffer.
+ */
+
+#include "config.h"
+
+#if OGGZ_CONFIG_READ && defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <ogg/ogg.h>
+
+#include "oggz_compat.h"
+#include "oggz_private.h"
+
+/*#define DEBUG*/
+
+int
+oggz_mmap_init (OGGZ * oggz)
+{
+  OggzMmap * map;
+  struct stat statbuf;
+  void * data;
+  long offset;
+  int fd;
+
+  if (oggz->file == NULL) return -1;
+
+  if ((fd = fileno (oggz->file)) == -1) return -1;
+  if (fstat (fd, &statbuf) == -1) return -1;
+  if (!oggz_stat_regular (statbuf.st_mode)) return -1;
+
+  /* Zero-length files cannot be mapped; files too large for the address
+   * space are read normally */
+  if (statbuf.st_size <= 0) return -1;
+  if ((oggz_off_t)(size_t)statbuf.st_size != statbuf.st_size) return -1;
+
+  if ((offset = ftell (oggz->file)) == -1) return -1;
+
+  /* The mapping is only ever read: pages are handed to callbacks as
+   * const, and packets are copied out by ogg_stream_pagein() */
+  data = mmap (NULL, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) return -1;
+
+#ifdef MADV_SEQUENTIAL
+  madvise (data, (size_t)statbuf.st_size, MADV_SEQUENTIAL);
+#endif
+
+  map = (OggzMmap *) oggz_malloc (sizeof (OggzMmap));
+  if (map == NULL) {
+    munmap (data, (size_t)statbuf.st_size);
+    return -1;
+  }
+
+  map->data = (unsigned char *)data;
+  map->size = statbuf.st_size;
+  map->fill = map->returned = offset;
+
+  oggz->map = map;
+
+#ifdef DEBUG
+  printf ("oggz_mmap_init: mapped %" PRI_OGGZ_OFF_T "d bytes\n", map->size);
+#endif
+
+  return 0;
+}
+
+int
+oggz_mmap_close (OGGZ * oggz)
+{
+  OggzMmap * map = oggz->map;
+
+  if (map == NULL) return 0;
+
+  munmap (map->data, (size_t)map->size);
+  oggz_free (map);
+  oggz->map = NULL;
+
+  return 0;
+}
+
+/*
+ * oggz_mmap_pageseek (oggz, og)
+ *
+ * Equivalent of ogg_sync_pageseek() over the mapped data. Returns:
+ *   n > 0 : a page of n bytes was found and returned in og
+ *   n < 0 : -n bytes were skipped looking for a page boundary
+ *   0     : more data is needed (see oggz_mmap_wrote())
+ */
+long
+oggz_mmap_pageseek (OGGZ * oggz, ogg_page * og)
+{
+  OggzMmap * map = oggz->map;
+  long more;
+
+  if (map->returned >= map->fill) return 0;
+
+  more = oggz_read_pageseek_mem (map->data + map->returned,
+                                 (long)(map->fill - map->returned), og);
+
+  if (more > 0) map->returned += more;
+  else if (more < 0) map->returned += -more;
+
+  return more;
+}
+
+/*
+ * oggz_mmap_wrote (oggz, n)
+ *
+ * Make up to n more bytes of the mapping available to
+ * oggz_mmap_pageseek(). Returns the number of bytes made available,
+ * or 0 at end of file.
+ */
+long
+oggz_mmap_wrote (OGGZ * oggz, long n)
+{
+  OggzMmap * map = oggz->map;
+  oggz_off_t avail;
+
+  if (n <= 0 || map->fill >= map->size) return 0;
+
+  avail = map->size - map->fill;
+  if ((oggz_off_t)n > avail) n = (long)avail;
+
+  map->fill += n;
+
+  return n;
+}
+
+size_t
+oggz_mmap_read (OGGZ * oggz, void * buf, size_t n)
+{
+  OggzMmap * map = oggz->map;
+  long bytes;
+
+  bytes = oggz_mmap_wrote (oggz, (long)MIN (n, (size_t)0x7fffffff));
+  if (bytes > 0) {
+    memcpy (buf, map->data + map->fill - bytes, (size_t)bytes);
+  }
+
+  map->returned = map->fill;
+
+  return (size_t)bytes;
+}
+
+int
+oggz_mmap_seek (OGGZ * oggz, long offset, int whence)
+{
+  OggzMmap * map = oggz->map;
+  oggz_off_t pos;
+
+  switch (whence) {
+  case SEEK_SET: pos = offset; break;
+  case SEEK_CUR: pos = map->fill + offset; break;
+  case SEEK_END: pos = map->size + offset; break;
+  default: return -1;
+  }
+
+  if (pos < 0) return -1;
+
+  map->fill = map->returned = pos;
+
+  return 0;
+}
+
+long
+oggz_mmap_tell (OGGZ * oggz)
+{
+  return (long)oggz->map->fill;
+}
+
+#else /* OGGZ_CONFIG_READ && HAVE_SYS_MMAN_H && HAVE_MMAP */
+
+#include "oggz_private.h"
+
+int
+oggz_mmap_init (OGGZ * oggz)
+{
+  return -1;
+}
+
+int
+oggz_mmap_close (OGGZ * oggz)
+{
+  return 0;
+}
+
+long
+oggz_mmap_pageseek (OGGZ * oggz, ogg_page * og)
+{
+  return 0;
+}
+
+long
+oggz_mmap_wrote (OGGZ * oggz, long n)
+{
+  return 0;
+}
+
+size_t
+oggz_mmap_read (OGGZ * oggz, void * buf, size_t n)
+{
+  return 0;
+}
+
+int
+oggz_mmap_seek (OGGZ * oggz, long offset, int whence)
+{
+  return -1;
+}
+
+long
+oggz_mmap_tell (OGGZ * oggz)
+{
+  return -1;
+}
+
+#endif
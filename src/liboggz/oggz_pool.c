@@ -0,0 +1,217 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+
+#include <ogg/ogg.h>
+
+#include "oggz_pool.h"
+#include "oggz_macros.h"
+
+/* Maximum number of unused blocks to keep around for recycling */
+#define OGGZ_POOL_MAX_IDLE 2
+
+typedef struct _OggzPoolBlock OggzPoolBlock;
+
+/* Header preceding each allocation, padded for alignment */
+typedef union {
+  OggzPoolBlock * block;
+  ogg_int64_t align_int;
+  double align_double;
+  void * align_ptr;
+} OggzPoolHeader;
+
+struct _OggzPoolBlock {
+  OggzPoolBlock * next;
+  OggzPool * pool;
+  unsigned char * data;
+  size_t size; /* usable bytes at data */
+  size_t used; /* bytes handed out so far */
+  int live; /* allocations not yet released */
+};
+
+struct _OggzPool {
+  OggzPoolBlock * blocks;
+  OggzPoolBlock * current;
+  size_t block_size;
+  int nr_idle;
+};
+
+#define POOL_ALIGN(n) \
+  (((n) + sizeof (OggzPoolHeader) - 1) / sizeof (OggzPoolHeader) \
+   * sizeof (OggzPoolHeader))
+
+OggzPool *
+oggz_pool_new (size_t block_size)
+{
+  OggzPool * pool;
+
+  pool = oggz_malloc (sizeof (OggzPool));
+  if (pool == NULL) return NULL;
+
+  pool->blocks = NULL;
+  pool->current = NULL;
+  pool->block_size = block_size;
+  pool->nr_idle = 0;
+
+  return pool;
+}
+
+void
+oggz_pool_delete (OggzPool * pool)
+{
+  OggzPoolBlock * block, * next;
+
+  if (pool == NULL) return;
+
+  for (block = pool->blocks; block != NULL; block = next) {
+    next = block->next;
+    oggz_free (block);
+  }
+
+  oggz_free (pool);
+}
+
+static OggzPoolBlock *
+oggz_pool_block_new (OggzPool * pool, size_t size)
+{
+  OggzPoolBlock * block;
+
+  block = oggz_malloc (POOL_ALIGN (sizeof (OggzPoolBlock)) + size);
+  if (block == NULL) return NULL;
+
+  block->pool = pool;
+  block->data = (unsigned char *)block + POOL_ALIGN (sizeof (OggzPoolBlock));
+  block->size = size;
+  block->used = 0;
+  block->live = 0;
+
+  block->next = pool->blocks;
+  pool->blocks = block;
+
+  return block;
+}
+
+static void
+oggz_pool_block_free (OggzPool * pool, OggzPoolBlock * block)
+{
+  OggzPoolBlock ** b;
+
+  for (b = &pool->blocks; *b != NULL; b = &(*b)->next) {
+    if (*b == block) {
+      *b = block->next;
+      break;
+    }
+  }
+
+  oggz_free (block);
+}
+
+/*
+ * A block which is no longer current and has nothing live in it
+ * becomes idle; keep a few standard sized ones for reuse.
+ */
+static void
+oggz_pool_block_idle (OggzPool * pool, OggzPoolBlock * block)
+{
+  if (block->size > pool->block_size || pool->nr_idle >= OGGZ_POOL_MAX_IDLE) {
+    oggz_pool_block_free (pool, block);
+  } else {
+    pool->nr_idle++;
+  }
+}
+
+void *
+oggz_pool_alloc (OggzPool * pool, size_t n)
+{
+  OggzPoolBlock * block, * prev;
+  OggzPoolHeader * header;
+  size_t need;
+
+  if (pool == NULL) return NULL;
+
+  need = sizeof (OggzPoolHeader) + POOL_ALIGN (n);
+
+  block = pool->current;
+
+  /* Rewind the current block if everything in it has been released */
+  if (block != NULL && block->live == 0) block->used = 0;
+
+  if (block == NULL || block->size - block->used < need) {
+    prev = block;
+
+    /* Look for an idle block to recycle */
+    for (block = pool->blocks; block != NULL; block = block->next) {
+      if (block != prev && block->live == 0 && block->size >= need) {
+        pool->nr_idle--;
+        block->used = 0;
+        break;
+      }
+    }
+
+    if (block == NULL) {
+      block = oggz_pool_block_new (pool, MAX (pool->block_size, need));
+      if (block == NULL) return NULL;
+    }
+
+    pool->current = block;
+
+    if (prev != NULL && prev->live == 0)
+      oggz_pool_block_idle (pool, prev);
+  }
+
+  header = (OggzPoolHeader *)(block->data + block->used);
+  header->block = block;
+
+  block->used += need;
+  block->live++;
+
+  return header + 1;
+}
+
+void
+oggz_pool_release (void * ptr)
+{
+  OggzPoolHeader * header;
+  OggzPoolBlock * block;
+
+  if (ptr == NULL) return;
+
+  header = (OggzPoolHeader *)ptr - 1;
+  block = header->block;
+
+  block->live--;
+
+  if (block->live == 0 && block != block->pool->current)
+    oggz_pool_block_idle (block->pool, block);
+}
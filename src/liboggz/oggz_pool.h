@@ -0,0 +1,80 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_POOL_H__
+#define __OGGZ_POOL_H__
+
+#include <stddef.h>
+
+/*
+ * A simple block allocator for short-lived allocations that are
+ * released in roughly the order they were made, such as packets held
+ * back for reverse granulepos calculation. Memory is handed out from
+ * large blocks which are recycled once everything allocated from them
+ * has been released, so the system allocator is only involved when
+ * the pool needs to grow.
+ */
+
+struct _OggzPool;
+typedef struct _OggzPool OggzPool;
+
+/**
+ * Create a new pool.
+ * \param block_size The size of blocks to allocate from the system;
+ * larger requests are given a block of their own.
+ * \retval a pointer to the new pool.
+ * \retval NULL on failure.
+ */
+OggzPool *
+oggz_pool_new (size_t block_size);
+
+/**
+ * Destroy a pool, freeing all memory allocated from it.
+ */
+void
+oggz_pool_delete (OggzPool * pool);
+
+/**
+ * Allocate \a n bytes from a pool.
+ * \retval a pointer to the allocated memory, suitably aligned for any type.
+ * \retval NULL on failure.
+ */
+void *
+oggz_pool_alloc (OggzPool * pool, size_t n);
+
+/**
+ * Release memory previously returned by oggz_pool_alloc().
+ */
+void
+oggz_pool_release (void * ptr);
+
+#endif /* __OGGZ_POOL_H__ */
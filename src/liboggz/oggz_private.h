@@ -41,16 +41,25 @@
 #include <oggz/oggz_off_t.h>
 
 #include "oggz/oggz_packet.h"
+#include "oggz/oggz_table.h"
 
 #include "oggz_macros.h"
 #include "oggz_vector.h"
-#include "oggz_dlist.h"
+#include "oggz_ring.h"
+#include "oggz_pool.h"
 
 #define OGGZ_AUTO_MULT 1000Ull
 
+/* Size of blocks used to store reverse buffered packets */
+#define OGGZ_PACKET_POOL_BLOCKSIZE 65536
+
 typedef struct _OGGZ OGGZ;
 typedef struct _OggzComment OggzComment;
 typedef struct _OggzIO OggzIO;
+typedef struct _OggzIOPool OggzIOPool;
+typedef struct _OggzMmap OggzMmap;
+typedef struct _OggzReadAhead OggzReadAhead;
+typedef struct _OggzUring OggzUring;
 typedef struct _OggzReader OggzReader;
 typedef struct _OggzWriter OggzWriter;
 
@@ -59,6 +68,9 @@ typedef int (*OggzReadPacket) (OGGZ * oggz, oggz_packet * op, long serialno,
 			       void * user_data);
 typedef int (*OggzReadPage) (OGGZ * oggz, const ogg_page * og, long serialno,
 			     void * user_data);
+typedef int (*OggzReadPackets) (OGGZ * oggz, const ogg_page * og,
+                                oggz_packet * packets, int n, long serialno,
+                                void * user_data);
 
 /* oggz_stream */
 #include "oggz_stream_private.h"
@@ -72,12 +84,27 @@ typedef int (*OggzOrder) (OGGZ * oggz, ogg_packet * op, void * target,
 
 typedef int (*OggzWriteHungry) (OGGZ * oggz, int empty, void * user_data);
 
+typedef void (*OggzWriteRelease) (unsigned char * packet, void * user_data);
+
 /* oggz_io */
 typedef size_t (*OggzIORead) (void * user_handle, void * buf, size_t n);
 typedef size_t (*OggzIOWrite) (void * user_handle, void * buf, size_t n);
 typedef int (*OggzIOSeek) (void * user_handle, long offset, int whence);
 typedef long (*OggzIOTell) (void * user_handle);
 typedef int (*OggzIOFlush) (void * user_handle);
+typedef size_t (*OggzIOReadAt) (void * user_handle, void * buf, size_t n,
+                                oggz_off_t offset);
+
+typedef struct {
+  void * base;
+  size_t len;
+} OggzIOVec;
+
+typedef long (*OggzIOWritev) (void * user_handle, const OggzIOVec * iov,
+                              int iovcnt);
+
+/* The most regions passed to one vectored write */
+#define OGGZ_IOV_MAX 128
 
 struct _oggz_stream_t {
   ogg_stream_state ogg_stream;
@@ -105,6 +132,10 @@ struct _oggz_stream_t {
   ogg_int64_t granulepos;
   ogg_int64_t packetno;
 
+  /* packets queued for writing by an OGGZ_SORT writer */
+  OggzRing * sort_queue;
+  ogg_int64_t sort_unit; /* unit of the last packet queued */
+
   /** CALLBACKS **/
   OggzMetric metric;
   void * metric_user_data;
@@ -116,6 +147,9 @@ struct _oggz_stream_t {
   OggzReadPacket read_packet;
   void * read_user_data;
 
+  OggzReadPackets read_packets;
+  void * read_packets_user_data;
+
   OggzReadPage read_page;
   void * read_page_user_data;
 
@@ -126,6 +160,27 @@ struct _oggz_stream_t {
   ogg_packet * last_packet;
 };
 
+/**
+ * A point in the file learned while seeking: the first page at or after
+ * offset which carries a granulepos belongs to serialno, and has the
+ * given granulepos
+ */
+typedef struct {
+  oggz_off_t offset;
+  long serialno;
+  ogg_int64_t granulepos;
+} OggzSeekLandmark;
+
+/**
+ * One of a set of positional reads made at once by oggz_io_read_multi()
+ */
+typedef struct {
+  oggz_off_t offset;
+  unsigned char * buf;
+  long n;
+  long len; /* bytes read, short only at end of file, or -1 on error */
+} OggzIOProbe;
+
 struct _OggzReader {
   ogg_sync_state ogg_sync;
 
@@ -136,6 +191,9 @@ struct _OggzReader {
   OggzReadPacket read_packet;
   void * read_user_data;
 
+  OggzReadPackets read_packets;
+  void * read_packets_user_data;
+
   OggzReadPage read_page;
   void * read_page_user_data;
 
@@ -145,11 +203,84 @@ struct _OggzReader {
   /* Read positioning */
   long current_page_bytes;
 
+  /* Caller's buffer lent to oggz_read_input_borrowed(); pages are
+   * parsed in place from [input_returned, input_fill) */
+  unsigned char * input;
+  long input_fill;
+  long input_returned;
+
   /* Calculation of position */
   oggz_off_t current_packet_begin_page_offset;
   int current_packet_pages;
   int current_packet_begin_segment_index;
 
+  /* Total bytes of packet data held back for reverse granulepos
+   * calculation (OGGZ_AUTO) */
+  ogg_int64_t reverse_buffered_bytes;
+
+  /* Most recent page submitted to a stream */
+  ogg_page current_page;
+
+  /* Pull mode (oggz_read_next_packet): packets are handed out through
+   * pull_packet instead of being passed to read callbacks */
+  int pull;
+  int pull_ready;
+  oggz_packet pull_packet;
+  long pull_serialno;
+  const ogg_page * pull_page;
+  unsigned char * pull_held; /* pool data of a reverse buffered packet */
+
+  /* Packets collected for an OggzReadPackets callback, all from the
+   * stream batch_stream */
+  oggz_packet * batch;
+  unsigned char ** batch_held; /* pool data of reverse buffered packets */
+  int batch_count;
+  int batch_max;
+  long batch_serialno;
+  oggz_stream_t * batch_stream;
+
+  /* Seek index (oggz_index.c), holding an OggzStreamIndex for each
+   * serialno; it covers the pages in [0, index_end) */
+  OggzTable * index;
+  oggz_off_t index_end;
+  void * index_map; /* mapped index file searched in place, or NULL */
+  size_t index_map_size;
+  int index_record; /* set by oggz_seek_index_enable() */
+
+  /* Keypoints from a Skeleton 4.0 index, holding an OggzStreamIndex for
+   * each serialno, and the segment length they are valid for (or 0) */
+  OggzTable * keypoints;
+  ogg_int64_t keypoints_length;
+
+  /* Seek landmarks (oggz_seek.c), learned from the pages probed while
+   * seeking and read after a seek, in order of offset. They are valid
+   * for a file of landmarks_size bytes (or -1 if not yet known), whose
+   * last page carrying a granulepos is given by landmark_end_serialno
+   * and landmark_end_granulepos (or -1 if not yet found). Pages read
+   * after a seek are recorded only once they are a stride past
+   * landmark_read_offset, the last one recorded (or -1) */
+  OggzSeekLandmark * landmarks;
+  int nr_landmarks;
+  oggz_off_t landmarks_size;
+  oggz_off_t landmark_read_offset;
+  long landmark_end_serialno;
+  ogg_int64_t landmark_end_granulepos;
+
+  /* Seek statistics (oggz_seek.c): running counts of repositionings and
+   * bytes read by the seek code, and those of the last oggz_seek_units() */
+  long seeks;
+  long seek_probes;
+  ogg_int64_t seek_bytes_read;
+  long seek_last_probes;
+  ogg_int64_t seek_last_bytes_read;
+
+  /* Number of probes made at once while seeking (oggz_seek_set_probes()) */
+  int seek_nr_probes;
+
+  /* Skeleton presentation time in milliseconds, which
+   * oggz_get_duration() subtracts from the end time */
+  ogg_int64_t presentation_time;
+
 #if 0
   oggz_off_t offset_page_end; /* offset of end of current page */
 #endif
@@ -157,15 +288,31 @@ struct _OggzReader {
 
 /**
  * Bundle a packet with the stream it is being queued for; used in
- * the packet_queue vector
+ * the packet_queue ring
  */
 typedef struct {
   ogg_packet op;
   oggz_stream_t * stream;
   int flush;
   int * guard;
+  OggzWriteRelease release; /* until the data has been taken by libogg */
+  void * release_user_data;
+  ogg_int64_t unit; /* position in time, for OGGZ_SORT */
+  long seq; /* feed order, for OGGZ_SORT */
 } oggz_writer_packet_t;
 
+/**
+ * A packet held back while reading until its granulepos can be
+ * calculated; used in the packet_buffer ring
+ */
+typedef struct {
+  oggz_packet     zp;
+  oggz_stream_t * stream;
+  OggzReader    * reader;
+  OGGZ          * oggz;
+  long            serialno;
+} OggzBufferedPacket;
+
 enum oggz_writer_state {
   OGGZ_MAKING_PACKETS = 0,
   OGGZ_WRITING_PAGES = 1
@@ -173,7 +320,18 @@ enum oggz_writer_state {
 
 struct _OggzWriter {
   oggz_writer_packet_t * next_zpacket; /* stashed in case of FLUSH_BEFORE */
-  OggzVector * packet_queue;
+  OggzRing * packet_queue; /* oggz_writer_packet_t *, in feed order */
+
+  /* For OGGZ_SORT, packets are queued per stream instead: a min-heap of
+   * the streams with packets queued, keyed on their first packet */
+  oggz_stream_t ** sort_heap;
+  int sort_heap_len;
+  int sort_heap_size;
+  int sort_queued; /* packets queued across all streams */
+  long sort_seq;
+  ogg_int64_t sort_unit_max; /* latest unit fed */
+  ogg_int64_t sort_max_delay;
+  int sort_release; /* write held packets without waiting */
 
   OggzWriteHungry hungry;
   void * hungry_user_data;
@@ -200,6 +358,19 @@ struct _OggzWriter {
   int no_more_packets; /* used only in the local oggz_write loop to indicate
                           end of stream */
 
+  /* Output queued by oggz_write() for oggz_io_writev(). Page bodies are
+   * referenced in place while their ogg_stream_state in batch_streams
+   * takes no more packets; headers, and bodies which would move, are
+   * copied into batch_data at batch_offsets */
+  OggzIOVec * batch_iov;
+  long * batch_offsets;
+  ogg_stream_state ** batch_streams;
+  unsigned char * batch_data;
+  long batch_data_len;
+  long batch_data_size;
+  long batch_bytes;
+  int batch_iovcnt;
+  int batch_error;
 };
 
 struct _OggzIO {
@@ -217,6 +388,24 @@ struct _OggzIO {
 
   OggzIOFlush flush;
   void * flush_user_handle;
+
+  OggzIOReadAt read_at;
+  void * read_at_user_handle;
+
+  OggzIOWritev writev;
+  void * writev_user_handle;
+};
+
+/**
+ * A read-only file mapping, used in place of the ogg_sync buffer when
+ * a file is opened with OGGZ_MMAP. Pages are parsed directly out of
+ * the region [returned, fill).
+ */
+struct _OggzMmap {
+  unsigned char * data; /* start of mapping */
+  oggz_off_t size; /* length of mapping */
+  oggz_off_t fill; /* end of data made available for reading */
+  oggz_off_t returned; /* start of data not yet returned as pages */
 };
 
 struct _OggzComment {
@@ -231,6 +420,10 @@ struct _OGGZ {
   int flags;
   FILE * file;
   OggzIO * io;
+  OggzMmap * map; /* non-NULL if file is mapped (OGGZ_MMAP) */
+  OggzReadAhead * readahead; /* non-NULL if read-ahead is enabled */
+  OggzUring * uring; /* non-NULL if reading through io_uring */
+  OggzIOPool * io_pool; /* threads for positional reads, or NULL */
 
   ogg_packet current_packet;
   ogg_page current_page;
@@ -242,6 +435,9 @@ struct _OGGZ {
   int cb_next;
 
   OggzVector * streams;
+  oggz_stream_t ** stream_index; /* streams hashed by serialno */
+  int stream_index_size;
+  oggz_stream_t * last_stream; /* most recently looked up stream */
   int all_at_eos; /* all streams are at eos */
 
   OggzMetric metric;
@@ -256,7 +452,8 @@ struct _OGGZ {
     OggzWriter writer;
   } x;
 
-  OggzDList * packet_buffer;
+  OggzRing * packet_buffer; /* OggzBufferedPacket */
+  OggzPool * packet_pool; /* storage for packet data in packet_buffer */
 };
 
 OGGZ * oggz_read_init (OGGZ * oggz);
@@ -265,6 +462,7 @@ OGGZ * oggz_read_close (OGGZ * oggz);
 OGGZ * oggz_write_init (OGGZ * oggz);
 int oggz_write_flush (OGGZ * oggz);
 OGGZ * oggz_write_close (OGGZ * oggz);
+long oggz_write (OGGZ * oggz, long n);
 
 int oggz_map_return_value_to_error (int cb_ret);
 
@@ -323,12 +521,77 @@ long oggz_comments_encode (OGGZ * oggz, long serialno,
 
 /* oggz_io */
 size_t oggz_io_read (OGGZ * oggz, void * buf, size_t n);
+size_t oggz_io_read_raw (OGGZ * oggz, void * buf, size_t n);
 size_t oggz_io_write (OGGZ * oggz, void * buf, size_t n);
+int oggz_io_can_writev (OGGZ * oggz);
+long oggz_io_writev (OGGZ * oggz, const OggzIOVec * iov, int iovcnt);
 int oggz_io_seek (OGGZ * oggz, long offset, int whence);
+int oggz_io_seek_raw (OGGZ * oggz, long offset, int whence);
 long oggz_io_tell (OGGZ * oggz);
+long oggz_io_tell_raw (OGGZ * oggz);
 int oggz_io_flush (OGGZ * oggz);
+int oggz_io_can_read_at (OGGZ * oggz);
+long oggz_io_read_at (OGGZ * oggz, unsigned char * buf, long n,
+                      oggz_off_t offset);
+int oggz_io_read_multi (OGGZ * oggz, OggzIOProbe * probes, int n);
+int oggz_io_pool_open (OGGZ * oggz, int nr_reads);
+int oggz_io_pool_close (OGGZ * oggz);
+
+/* oggz_mmap */
+int oggz_mmap_init (OGGZ * oggz);
+int oggz_mmap_close (OGGZ * oggz);
+long oggz_mmap_pageseek (OGGZ * oggz, ogg_page * og);
+long oggz_mmap_wrote (OGGZ * oggz, long n);
+size_t oggz_mmap_read (OGGZ * oggz, void * buf, size_t n);
+int oggz_mmap_seek (OGGZ * oggz, long offset, int whence);
+long oggz_mmap_tell (OGGZ * oggz);
+
+/* oggz_uring */
+int oggz_uring_init (OGGZ * oggz, int depth);
+int oggz_uring_close (OGGZ * oggz);
+size_t oggz_uring_read (OGGZ * oggz, void * buf, size_t n);
+int oggz_uring_seek (OGGZ * oggz, long offset, int whence);
+long oggz_uring_tell (OGGZ * oggz);
+int oggz_uring_read_multi (OGGZ * oggz, OggzIOProbe * probes, int n);
+
+/* oggz_index */
+int oggz_index_open (OGGZ * oggz, const char * filename);
+void oggz_index_clear (OGGZ * oggz);
+int oggz_index_add_page (OGGZ * oggz, ogg_page * og, long serialno);
+int oggz_index_find (OGGZ * oggz, ogg_int64_t unit_target,
+                     oggz_off_t offset_begin, oggz_off_t offset_end,
+                     oggz_off_t * offset_found, ogg_int64_t * unit_found);
+int oggz_index_last_unit (OGGZ * oggz, oggz_off_t offset_end,
+                          ogg_int64_t * unit_found);
+void oggz_index_keypoints_reset (OGGZ * oggz, ogg_int64_t segment_length);
+int oggz_index_add_keypoint (OGGZ * oggz, long serialno, oggz_off_t offset,
+                             ogg_int64_t unit);
+int oggz_index_find_keypoint (OGGZ * oggz, ogg_int64_t unit_target,
+                              oggz_off_t offset_begin, oggz_off_t offset_end,
+                              oggz_off_t * offset_found,
+                              ogg_int64_t * unit_found);
+
+/* oggz_seek */
+void oggz_seek_landmark_add (OGGZ * oggz, oggz_off_t offset, long serialno,
+                             ogg_int64_t granulepos);
+void oggz_seek_landmark_read (OGGZ * oggz, oggz_off_t offset, long serialno,
+                              ogg_int64_t granulepos);
+void oggz_seek_landmarks_clear (OGGZ * oggz);
+void oggz_seek_set_presentation_time (OGGZ * oggz, ogg_int64_t numerator,
+                                      ogg_int64_t denominator);
+
+/* oggz_readahead */
+int oggz_readahead_new (OGGZ * oggz, int nbuffers);
+int oggz_readahead_stop (OGGZ * oggz);
+int oggz_readahead_close (OGGZ * oggz);
+size_t oggz_readahead_read (OGGZ * oggz, void * buf, size_t n);
+long oggz_readahead_tell (OGGZ * oggz);
 
 /* oggz_read */
-OggzDListIterResponse oggz_read_free_pbuffers(void *elem);
+OggzRingIterResponse oggz_read_free_pbuffers(void *elem);
+long oggz_read_pageseek_mem (unsigned char * data, long bytes, ogg_page * og);
+long oggz_read_pageseek (OGGZ * oggz, ogg_page * og);
+long oggz_read_fill (OGGZ * oggz, long n);
+void oggz_read_batch_clear (OGGZ * oggz);
 
 #endif /* __OGGZ_PRIVATE_H__ */
@@ -82,6 +82,9 @@ oggz_read_init (OGGZ * oggz)
   reader->read_packet = NULL;
   reader->read_user_data = NULL;
 
+  reader->read_packets = NULL;
+  reader->read_packets_user_data = NULL;
+
   reader->read_page = NULL;
   reader->read_page_user_data = NULL;
 
@@ -89,9 +92,52 @@ oggz_read_init (OGGZ * oggz)
 
   reader->current_page_bytes = 0;
 
+  reader->input = NULL;
+  reader->input_fill = 0;
+  reader->input_returned = 0;
+
   reader->current_packet_begin_page_offset = 0;
   reader->current_packet_pages = 0;
 
+  reader->reverse_buffered_bytes = 0;
+
+  reader->pull = 0;
+  reader->pull_ready = 0;
+  reader->pull_held = NULL;
+
+  reader->batch = NULL;
+  reader->batch_held = NULL;
+  reader->batch_count = 0;
+  reader->batch_max = 0;
+  reader->batch_serialno = -1;
+  reader->batch_stream = NULL;
+
+  reader->index = NULL;
+  reader->index_end = 0;
+  reader->index_map = NULL;
+  reader->index_map_size = 0;
+  reader->index_record = 0;
+
+  reader->keypoints = NULL;
+  reader->keypoints_length = 0;
+
+  reader->landmarks = NULL;
+  reader->nr_landmarks = 0;
+  reader->landmarks_size = -1;
+  reader->landmark_read_offset = -1;
+  reader->landmark_end_serialno = -1;
+  reader->landmark_end_granulepos = -1;
+
+  reader->seeks = 0;
+  reader->seek_probes = 0;
+  reader->seek_bytes_read = 0;
+  reader->seek_last_probes = 0;
+  reader->seek_last_bytes_read = 0;
+
+  reader->seek_nr_probes = 1;
+
+  reader->presentation_time = 0;
+
   return oggz;
 }
 
@@ -100,6 +146,19 @@ oggz_read_close (OGGZ * oggz)
 {
   OggzReader * reader = &oggz->x.reader;
 
+  if (reader->pull_held != NULL) {
+    oggz_pool_release (reader->pull_held);
+    reader->pull_held = NULL;
+  }
+
+  oggz_read_batch_clear (oggz);
+  if (reader->batch != NULL) oggz_free (reader->batch);
+  if (reader->batch_held != NULL) oggz_free (reader->batch_held);
+
+  oggz_index_clear (oggz);
+  oggz_index_keypoints_reset (oggz, 0);
+  oggz_seek_landmarks_clear (oggz);
+
   ogg_stream_clear (&reader->ogg_stream);
   ogg_sync_clear (&reader->ogg_sync);
 
@@ -124,6 +183,7 @@ oggz_set_read_callback (OGGZ * oggz, long serialno,
   if (serialno == -1) {
     reader->read_packet = read_packet;
     reader->read_user_data = user_data;
+    reader->read_packets = NULL;
   } else {
     stream = oggz_get_stream (oggz, serialno);
     if (stream == NULL)
@@ -133,6 +193,41 @@ oggz_set_read_callback (OGGZ * oggz, long serialno,
 
     stream->read_packet = read_packet;
     stream->read_user_data = user_data;
+    stream->read_packets = NULL;
+  }
+
+  return 0;
+}
+
+int
+oggz_set_read_packets (OGGZ * oggz, long serialno,
+                       OggzReadPackets read_packets, void * user_data)
+{
+  OggzReader * reader;
+  oggz_stream_t * stream;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  reader =  &oggz->x.reader;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (serialno == -1) {
+    reader->read_packets = read_packets;
+    reader->read_packets_user_data = user_data;
+    reader->read_packet = NULL;
+  } else {
+    stream = oggz_get_stream (oggz, serialno);
+    if (stream == NULL)
+      stream = oggz_add_stream (oggz, serialno);
+    if (stream == NULL)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+
+    stream->read_packets = read_packets;
+    stream->read_packets_user_data = user_data;
+    stream->read_packet = NULL;
   }
 
   return 0;
@@ -170,6 +265,171 @@ oggz_set_read_page (OGGZ * oggz, long serialno, OggzReadPage read_page,
   return 0;
 }
 
+/* CRC lookup table for the Ogg page checksum (polynomial 0x04c11db7) */
+static ogg_uint32_t crc_lookup[256];
+static int crc_lookup_ready = 0;
+
+static void
+oggz_read_crc_init (void)
+{
+  ogg_uint32_t r;
+  int i, j;
+
+  if (crc_lookup_ready) return;
+
+  for (i = 0; i < 256; i++) {
+    r = (ogg_uint32_t)i << 24;
+    for (j = 0; j < 8; j++) {
+      r = (r & 0x80000000UL) ? ((r << 1) ^ 0x04c11db7UL) : (r << 1);
+    }
+    crc_lookup[i] = r & 0xffffffffUL;
+  }
+
+  crc_lookup_ready = 1;
+}
+
+static ogg_uint32_t
+oggz_read_crc_update (ogg_uint32_t crc, const unsigned char * buf, long n)
+{
+  long i;
+
+  for (i = 0; i < n; i++)
+    crc = (crc << 8) ^ crc_lookup[((crc >> 24) & 0xff) ^ buf[i]];
+
+  return crc;
+}
+
+/*
+ * Verify the checksum of the page at header, without writing to it
+ * (the checksum field is treated as zero for the calculation).
+ */
+static int
+oggz_read_page_check (const unsigned char * header, long header_len,
+                      const unsigned char * body, long body_len)
+{
+  static const unsigned char zeros[4] = {0, 0, 0, 0};
+  ogg_uint32_t crc = 0, stored;
+
+  stored = (ogg_uint32_t)header[22] |
+    ((ogg_uint32_t)header[23] << 8) |
+    ((ogg_uint32_t)header[24] << 16) |
+    ((ogg_uint32_t)header[25] << 24);
+
+  crc = oggz_read_crc_update (crc, header, 22);
+  crc = oggz_read_crc_update (crc, zeros, 4);
+  crc = oggz_read_crc_update (crc, header + 26, header_len - 26);
+  crc = oggz_read_crc_update (crc, body, body_len);
+
+  return ((crc & 0xffffffffUL) == stored);
+}
+
+/*
+ * oggz_read_pageseek_mem (data, bytes, og)
+ *
+ * As per ogg_sync_pageseek(), but locating and checking a page in place
+ * in the memory region [data, data+bytes). On success the header and
+ * body pointers of og refer into that region; nothing is copied.
+ * Returns:
+ *   n > 0 : a page of n bytes was found at data and returned in og
+ *   n < 0 : -n bytes were skipped looking for a page boundary
+ *   0     : more data is needed
+ */
+long
+oggz_read_pageseek_mem (unsigned char * data, long bytes, ogg_page * og)
+{
+  unsigned char * next;
+  long header_len, body_len, i;
+
+  if (bytes < 27) return 0;
+
+  if (memcmp (data, "OggS", 4)) goto sync_fail;
+
+  header_len = data[26] + 27;
+  if (bytes < header_len) return 0;
+
+  body_len = 0;
+  for (i = 0; i < data[26]; i++)
+    body_len += data[27 + i];
+
+  if (bytes < header_len + body_len) return 0;
+
+  oggz_read_crc_init ();
+
+  if (!oggz_read_page_check (data, header_len, data + header_len, body_len))
+    goto sync_fail;
+
+  og->header = data;
+  og->header_len = header_len;
+  og->body = data + header_len;
+  og->body_len = body_len;
+
+  return header_len + body_len;
+
+ sync_fail:
+  /* Skip ahead to the next possible capture pattern */
+  next = memchr (data + 1, 'O', (size_t)(bytes - 1));
+  if (next == NULL) next = data + bytes;
+
+  return -(long)(next - data);
+}
+
+/*
+ * oggz_read_pageseek (oggz, og)
+ *
+ * As per ogg_sync_pageseek(), taking pages from a buffer lent by
+ * oggz_read_input_borrowed() or from the file mapping if either is in
+ * use, otherwise from the ogg_sync buffer.
+ */
+long
+oggz_read_pageseek (OGGZ * oggz, ogg_page * og)
+{
+  OggzReader * reader = &oggz->x.reader;
+  long more;
+
+  if (reader->input != NULL) {
+    more = oggz_read_pageseek_mem (reader->input + reader->input_returned,
+                                   reader->input_fill - reader->input_returned,
+                                   og);
+    if (more > 0) reader->input_returned += more;
+    else if (more < 0) reader->input_returned += -more;
+
+    return more;
+  }
+
+  if (oggz->map != NULL)
+    return oggz_mmap_pageseek (oggz, og);
+
+  return ogg_sync_pageseek (&oggz->x.reader.ogg_sync, og);
+}
+
+/*
+ * oggz_read_fill (oggz, n)
+ *
+ * Make up to n more bytes of input available to oggz_read_pageseek().
+ * For a mapped file this simply extends the readable window of the
+ * mapping; otherwise the data is read into the ogg_sync buffer.
+ * returns the number of bytes made available, 0 on EOF, or an error
+ * as per oggz_io_read()
+ */
+long
+oggz_read_fill (OGGZ * oggz, long n)
+{
+  OggzReader * reader = &oggz->x.reader;
+  char * buffer;
+  long bytes;
+
+  if (oggz->map != NULL)
+    return oggz_mmap_wrote (oggz, n);
+
+  buffer = ogg_sync_buffer (&reader->ogg_sync, n);
+  bytes = (long) oggz_io_read (oggz, buffer, n);
+
+  if (bytes > 0)
+    ogg_sync_wrote (&reader->ogg_sync, bytes);
+
+  return bytes;
+}
+
 /*
  * oggz_read_get_next_page (oggz, og, do_read)
  *
@@ -194,9 +454,10 @@ oggz_read_get_next_page (OGGZ * oggz, ogg_page * og)
           oggz->offset, reader->current_page_bytes);
 #endif
   oggz->offset += reader->current_page_bytes;
+  reader->current_page_bytes = 0;
 
   do {
-    more = ogg_sync_pageseek (&reader->ogg_sync, og);
+    more = oggz_read_pageseek (oggz, og);
 
     if (more == 0) {
       /* No page available */
@@ -205,6 +466,9 @@ oggz_read_get_next_page (OGGZ * oggz, ogg_page * og)
 #ifdef DEBUG_VERBOSE
   printf ("%s: skipping; incrementing oggz->offset by 0x%lx bytes\n", __func__, -more);
 #endif
+      /* Skipped bytes directly following the indexed region extend it */
+      if (reader->index_record && oggz->offset == reader->index_end)
+        reader->index_end += (-more);
       oggz->offset += (-more);
     } else {
 #ifdef DEBUG_VERBOSE
@@ -219,14 +483,11 @@ oggz_read_get_next_page (OGGZ * oggz, ogg_page * og)
   return oggz->offset;
 }
 
-typedef struct {
-  oggz_packet     zp;
-  oggz_stream_t * stream;
-  OggzReader    * reader;
-  OGGZ          * oggz;
-  long            serialno;
-} OggzBufferedPacket;
-
+/*
+ * oggz_read_new_pbuffer_entry (oggz, zp, serialno, stream, reader)
+ *
+ * Append a copy of a packet to the reverse buffer.
+ */
 OggzBufferedPacket *
 oggz_read_new_pbuffer_entry(OGGZ *oggz, oggz_packet * zp, 
                             long serialno, oggz_stream_t * stream, 
@@ -234,15 +495,19 @@ oggz_read_new_pbuffer_entry(OGGZ *oggz, oggz_packet * zp,
 {
   OggzBufferedPacket *p;
   ogg_packet * op = &zp->op;
+  unsigned char * data;
 
-  if ((p = oggz_malloc(sizeof(OggzBufferedPacket))) == NULL)
+  if ((data = oggz_pool_alloc(oggz->packet_pool, op->bytes)) == NULL)
     return NULL;
-  memcpy(&(p->zp), zp, sizeof(oggz_packet));
 
-  if ((p->zp.op.packet = oggz_malloc(op->bytes)) == NULL) {
-    oggz_free (p);
+  if ((p = oggz_ring_append(oggz->packet_buffer)) == NULL) {
+    oggz_pool_release (data);
     return NULL;
   }
+
+  memcpy(&(p->zp), zp, sizeof(oggz_packet));
+
+  p->zp.op.packet = data;
   memcpy(p->zp.op.packet, op->packet, op->bytes);
 
   p->stream = stream;
@@ -250,27 +515,28 @@ oggz_read_new_pbuffer_entry(OGGZ *oggz, oggz_packet * zp,
   p->reader = reader;
   p->oggz = oggz;
 
+  reader->reverse_buffered_bytes += op->bytes;
+
   return p;
 }
 
 void
 oggz_read_free_pbuffer_entry(OggzBufferedPacket *p)
 {
-  oggz_free(p->zp.op.packet);
-  oggz_free(p);
+  oggz_pool_release(p->zp.op.packet);
 }
 
-OggzDListIterResponse
+OggzRingIterResponse
 oggz_read_free_pbuffers(void *elem)
 {
   OggzBufferedPacket *p = (OggzBufferedPacket *)elem;
 
   oggz_read_free_pbuffer_entry(p);
 
-  return DLIST_ITER_CONTINUE;
+  return RING_ITER_CONTINUE;
 }
 
-OggzDListIterResponse
+OggzRingIterResponse
 oggz_read_update_gp(void *elem) {
 
   OggzBufferedPacket *p = (OggzBufferedPacket *)elem;
@@ -281,7 +547,7 @@ oggz_read_update_gp(void *elem) {
     /* Cancel the iteration (backwards through buffered packets)
      * if we don't know the codec */
     if (content < 0 || content >= OGGZ_CONTENT_UNKNOWN)
-      return DLIST_ITER_CANCEL;
+      return RING_ITER_CANCEL;
 
     p->zp.pos.calc_granulepos = 
       oggz_auto_calculate_gp_backwards(content, p->stream->last_granulepos,
@@ -292,10 +558,142 @@ oggz_read_update_gp(void *elem) {
     p->stream->last_packet = &(p->zp.op);
   }
 
-  return DLIST_ITER_CONTINUE;
+  return RING_ITER_CONTINUE;
 }
 
-OggzDListIterResponse
+/*
+ * oggz_read_is_batched (reader, stream)
+ *
+ * Determine whether packets of stream are delivered to an
+ * OggzReadPackets callback. As for packet callbacks, a callback set for
+ * the stream takes precedence over one set for all streams.
+ */
+static int
+oggz_read_is_batched (OggzReader * reader, oggz_stream_t * stream)
+{
+  if (reader->pull) return 0;
+  if (stream->read_packet) return 0;
+  if (stream->read_packets) return 1;
+  if (reader->read_packet) return 0;
+  return (reader->read_packets != NULL);
+}
+
+/*
+ * oggz_read_batch_append (reader, zp, serialno, stream, held)
+ *
+ * Add a packet to the current batch. held is the pool allocation holding
+ * the data of a reverse buffered packet, to be released once the batch
+ * has been delivered, or NULL.
+ * returns 0 on success, -1 if out of memory
+ */
+static int
+oggz_read_batch_append (OggzReader * reader, oggz_packet * zp, long serialno,
+                        oggz_stream_t * stream, unsigned char * held)
+{
+  oggz_packet * new_batch;
+  unsigned char ** new_held;
+  int new_max;
+
+  if (reader->batch_count == reader->batch_max) {
+    new_max = (reader->batch_max == 0) ? 16 : reader->batch_max * 2;
+
+    new_batch = oggz_realloc (reader->batch, new_max * sizeof (oggz_packet));
+    if (new_batch == NULL) return -1;
+    reader->batch = new_batch;
+
+    new_held = oggz_realloc (reader->batch_held,
+                             new_max * sizeof (unsigned char *));
+    if (new_held == NULL) return -1;
+    reader->batch_held = new_held;
+
+    reader->batch_max = new_max;
+  }
+
+  reader->batch[reader->batch_count] = *zp;
+  reader->batch_held[reader->batch_count] = held;
+  reader->batch_count++;
+
+  reader->batch_serialno = serialno;
+  reader->batch_stream = stream;
+
+  return 0;
+}
+
+/*
+ * oggz_read_batch_flush (oggz, og)
+ *
+ * Deliver the current batch to its OggzReadPackets callback, along with
+ * the page og on which the packets completed (NULL for reverse buffered
+ * packets). The unit is calculated once, for the last packet.
+ * returns the callback's return value
+ */
+static int
+oggz_read_batch_flush (OGGZ * oggz, const ogg_page * og)
+{
+  OggzReader * reader = &oggz->x.reader;
+  oggz_stream_t * stream = reader->batch_stream;
+  OggzReadPackets read_packets;
+  void * user_data;
+  ogg_int64_t gp_stored, unit_stored, granulepos;
+  int i, n, cb_ret = 0;
+
+  if ((n = reader->batch_count) == 0) return 0;
+
+  reader->batch_count = 0;
+
+  gp_stored = reader->current_granulepos;
+  unit_stored = reader->current_unit;
+
+  granulepos = reader->batch[n-1].pos.calc_granulepos;
+  reader->current_granulepos = granulepos;
+
+  if ((oggz->metric || stream->metric) && granulepos != -1) {
+    reader->current_unit =
+      oggz_get_unit (oggz, reader->batch_serialno, granulepos);
+  }
+
+  if (stream->read_packets) {
+    read_packets = stream->read_packets;
+    user_data = stream->read_packets_user_data;
+  } else {
+    read_packets = reader->read_packets;
+    user_data = reader->read_packets_user_data;
+  }
+
+  if (read_packets) {
+    cb_ret = read_packets (oggz, og, reader->batch, n,
+                           reader->batch_serialno, user_data);
+  }
+
+  for (i = 0; i < n; i++) {
+    if (reader->batch_held[i] != NULL)
+      oggz_pool_release (reader->batch_held[i]);
+  }
+
+  /* Reverse buffered packets are delivered out of band */
+  if (og == NULL) {
+    reader->current_granulepos = gp_stored;
+    reader->current_unit = unit_stored;
+  }
+
+  return cb_ret;
+}
+
+void
+oggz_read_batch_clear (OGGZ * oggz)
+{
+  OggzReader * reader = &oggz->x.reader;
+  int i;
+
+  for (i = 0; i < reader->batch_count; i++) {
+    if (reader->batch_held[i] != NULL)
+      oggz_pool_release (reader->batch_held[i]);
+  }
+
+  reader->batch_count = 0;
+}
+
+OggzRingIterResponse
 oggz_read_deliver_packet(void *elem) {
 
   OggzBufferedPacket *p = (OggzBufferedPacket *)elem;
@@ -304,9 +702,41 @@ oggz_read_deliver_packet(void *elem) {
   int cb_ret;
 
   if (p->zp.pos.calc_granulepos == -1) {
-    return DLIST_ITER_CANCEL;
+    return RING_ITER_CANCEL;
+  }
+
+  /* In pull mode, hand out one packet per call to oggz_read_next_packet().
+   * Its data stays allocated until the next call. */
+  if (p->reader->pull) {
+    if (p->reader->pull_ready) return RING_ITER_CANCEL;
+
+    p->reader->pull_packet = p->zp;
+    p->reader->pull_serialno = p->serialno;
+    p->reader->pull_page = NULL;
+    p->reader->pull_held = p->zp.op.packet;
+    p->reader->pull_ready = 1;
+
+    return RING_ITER_CONTINUE;
+  }
+
+  /* Collect packets for a batch callback, one stream at a time; the
+   * caller delivers them */
+  if (oggz_read_is_batched (p->reader, p->stream)) {
+    if (p->reader->batch_count > 0 &&
+        p->reader->batch_serialno != p->serialno)
+      return RING_ITER_CANCEL;
+
+    if (oggz_read_batch_append (p->reader, &(p->zp), p->serialno, p->stream,
+                                p->zp.op.packet) == -1)
+      return RING_ITER_CANCEL;
+
+    return RING_ITER_CONTINUE;
   }
 
+  /* Stop so that packets already collected for a batch callback are
+   * delivered before this one */
+  if (p->reader->batch_count > 0) return RING_ITER_CANCEL;
+
   gp_stored = p->reader->current_granulepos;
   unit_stored = p->reader->current_unit;
 
@@ -319,15 +749,19 @@ oggz_read_deliver_packet(void *elem) {
     if ((cb_ret = p->stream->read_packet(p->oggz, &(p->zp), p->serialno, 
 			       p->stream->read_user_data)) < 0) {
       p->oggz->cb_next = cb_ret;
-      if (cb_ret == -1)
-        return DLIST_ITER_ERROR;
+      if (cb_ret == -1) {
+        oggz_read_free_pbuffer_entry(p);
+        return RING_ITER_ERROR;
+      }
     }
   } else if (p->reader->read_packet) {
     if ((cb_ret = p->reader->read_packet(p->oggz, &(p->zp), p->serialno, 
 			       p->reader->read_user_data)) < 0) {
       p->oggz->cb_next = cb_ret;
-      if (cb_ret == -1)
-        return DLIST_ITER_ERROR;
+      if (cb_ret == -1) {
+        oggz_read_free_pbuffer_entry(p);
+        return RING_ITER_ERROR;
+      }
     }
   }
 
@@ -336,7 +770,7 @@ oggz_read_deliver_packet(void *elem) {
 
   oggz_read_free_pbuffer_entry(p);
 
-  return DLIST_ITER_CONTINUE;
+  return RING_ITER_CONTINUE;
 }
 
 static int
@@ -446,8 +880,10 @@ oggz_read_sync (OGGZ * oggz)
 
           stream->last_granulepos = reader->current_granulepos;
         
-          /* Set unit on last packet of page */
-          if ((oggz->metric || stream->metric) && reader->current_granulepos != -1) {
+          /* Set unit on last packet of page; for a batch callback this
+           * is done once per batch */
+          if ((oggz->metric || stream->metric) && reader->current_granulepos != -1 &&
+              !oggz_read_is_batched (reader, stream)) {
             reader->current_unit =
               oggz_get_unit (oggz, serialno, reader->current_granulepos);
           }
@@ -466,28 +902,32 @@ oggz_read_sync (OGGZ * oggz)
           /* Handle reverse buffering */
           if (oggz->flags & OGGZ_AUTO) {
             /* While we are getting invalid granulepos values, store the 
-             * incoming packets in a dlist */
+             * incoming packets in the packet buffer */
             if (reader->current_granulepos == -1) {
-              OggzBufferedPacket *p;
-
-              p = oggz_read_new_pbuffer_entry (oggz, &packet,
-                                               serialno, stream, reader);
-              oggz_dlist_append(oggz->packet_buffer, p);
+              if (oggz_read_new_pbuffer_entry (oggz, &packet, serialno,
+                                               stream, reader) == NULL)
+                return OGGZ_ERR_OUT_OF_MEMORY;
 
               goto prepare_position;
-            } else if (!oggz_dlist_is_empty(oggz->packet_buffer)) {
+            } else if (!oggz_ring_is_empty(oggz->packet_buffer)) {
               /* Move backward through the list assigning gp values based upon
                * the granulepos we just recieved.  Then move forward through
                * the list delivering any packets at the beginning with valid
                * gp values.
                */
               ogg_int64_t gp_stored = stream->last_granulepos;
+              int batch_ret = 0;
               stream->last_packet = op;
-              oggz_dlist_reverse_iter(oggz->packet_buffer, oggz_read_update_gp);
+              oggz_ring_reverse_iter(oggz->packet_buffer, oggz_read_update_gp);
 	      oggz->cb_next = 0;
-              if (oggz_dlist_deliter(oggz->packet_buffer, oggz_read_deliver_packet) == -1) {
-                return OGGZ_ERR_HOLE_IN_DATA;
-	      }
+              do {
+                if (oggz_ring_deliter(oggz->packet_buffer, oggz_read_deliver_packet) == -1) {
+                  return OGGZ_ERR_HOLE_IN_DATA;
+                }
+                /* Deliver packets collected for a batch callback */
+                if (reader->batch_count == 0) break;
+                batch_ret = oggz_read_batch_flush (oggz, NULL);
+              } while (batch_ret == 0);
 	      if (oggz->cb_next > 0) {
                 cb_ret = oggz->cb_next;
 		oggz->cb_next = 0;
@@ -498,13 +938,17 @@ oggz_read_sync (OGGZ * oggz)
               /* Fix up the stream granulepos. */
               stream->last_granulepos = gp_stored;
 
-              if (!oggz_dlist_is_empty(oggz->packet_buffer)) {
-                OggzBufferedPacket *p;
-
-                p = oggz_read_new_pbuffer_entry(oggz, &packet,
-                                                serialno, stream, reader);
+              /* Queue this packet behind any still buffered, or behind
+               * the one just handed out in pull mode, or if a batch
+               * callback asked to stop */
+              if (!oggz_ring_is_empty(oggz->packet_buffer) ||
+                  reader->pull_ready || batch_ret != 0) {
+                if (oggz_read_new_pbuffer_entry(oggz, &packet, serialno,
+                                                stream, reader) == NULL)
+                  return OGGZ_ERR_OUT_OF_MEMORY;
 
-                oggz_dlist_append(oggz->packet_buffer, p);
+                if (reader->pull_ready) cb_ret = OGGZ_STOP_OK;
+                else if (batch_ret != 0) cb_ret = batch_ret;
 
                 goto prepare_position;
               }
@@ -515,9 +959,20 @@ oggz_read_sync (OGGZ * oggz)
           printf ("%s: set begin_page to %llx, calling read_packet\n", __func__, pos->begin_page_offset);
 #endif
 
-          if (stream->read_packet) {
+          if (reader->pull) {
+            reader->pull_packet = packet;
+            reader->pull_serialno = serialno;
+            reader->pull_page = &reader->current_page;
+            reader->pull_ready = 1;
+            cb_ret = OGGZ_STOP_OK;
+          } else if (stream->read_packet) {
             cb_ret =
               stream->read_packet (oggz, &packet, serialno, stream->read_user_data);
+          } else if (oggz_read_is_batched (reader, stream)) {
+            /* Delivered once all packets of this page have been read */
+            if (oggz_read_batch_append (reader, &packet, serialno, stream,
+                                        NULL) == -1)
+              return OGGZ_ERR_OUT_OF_MEMORY;
           } else if (reader->read_packet) {
             cb_ret =
               reader->read_packet (oggz, &packet, serialno, reader->read_user_data);
@@ -558,6 +1013,12 @@ prepare_position:
 	cb_ret == OGGZ_ERR_HOLE_IN_DATA) 
       return cb_ret;
 
+    /* Deliver the packets of the last page to a batch callback */
+    if (reader->batch_count > 0) {
+      cb_ret = oggz_read_batch_flush (oggz, &reader->current_page);
+      if (cb_ret != 0) return cb_ret;
+    }
+
     if(oggz_read_get_next_page (oggz, &og) < 0)
       return OGGZ_READ_EMPTY; /* eof. leave uninitialized */
 
@@ -598,8 +1059,15 @@ prepare_position:
       } else if (granulepos == 0) {
        reader->current_unit = 0;
       }
+
+      /* Pages read beyond the indexed region are kept as landmarks */
+      if (oggz->offset != reader->index_end)
+        oggz_seek_landmark_read (oggz, oggz->offset, serialno, granulepos);
     }
 
+    if (reader->index_record)
+      oggz_index_add_page (oggz, &og, serialno);
+
     if (stream->read_page) {
       cb_ret =
         stream->read_page (oggz, &og, serialno, stream->read_page_user_data);
@@ -609,6 +1077,7 @@ prepare_position:
     }
 
     ogg_stream_pagein(os, &og);
+    reader->current_page = og;
     if (ogg_page_continued(&og)) {
       if (reader->current_packet_pages != -1)
         reader->current_packet_pages++;
@@ -629,8 +1098,6 @@ prepare_position:
 long
 oggz_read (OGGZ * oggz, long n)
 {
-  OggzReader * reader;
-  char * buffer;
   long bytes, bytes_read = 1, remaining = n, nread = 0;
   int cb_ret = 0;
 
@@ -645,8 +1112,6 @@ oggz_read (OGGZ * oggz, long n)
     return oggz_map_return_value_to_error (cb_ret);
   }
 
-  reader = &oggz->x.reader;
-
   cb_ret = oggz_read_sync (oggz);
   if (cb_ret == OGGZ_ERR_OUT_OF_MEMORY)
     return cb_ret;
@@ -654,15 +1119,12 @@ oggz_read (OGGZ * oggz, long n)
   while (cb_ret != OGGZ_STOP_ERR && cb_ret != OGGZ_STOP_OK &&
          bytes_read > 0 && remaining > 0) {
     bytes = MIN (remaining, CHUNKSIZE);
-    buffer = ogg_sync_buffer (&reader->ogg_sync, bytes);
-    bytes_read = (long) oggz_io_read (oggz, buffer, bytes);
+    bytes_read = oggz_read_fill (oggz, bytes);
     if (bytes_read == OGGZ_ERR_SYSTEM) {
       return OGGZ_ERR_SYSTEM;
     }
 
     if (bytes_read > 0) {
-      ogg_sync_wrote (&reader->ogg_sync, bytes_read);
-      
       remaining -= bytes_read;
       nread += bytes_read;
       
@@ -698,6 +1160,30 @@ oggz_read (OGGZ * oggz, long n)
   return nread;
 }
 
+int
+oggz_set_read_ahead (OGGZ * oggz, int nbuffers)
+{
+  int ret;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (nbuffers < 0) return OGGZ_ERR_INVALID;
+
+  if (oggz_readahead_close (oggz) == -1)
+    return OGGZ_ERR_SYSTEM;
+
+  if (nbuffers == 0) return 0;
+
+  if ((ret = oggz_readahead_new (oggz, nbuffers)) != 0)
+    return ret;
+
+  return 0;
+}
+
 /* generic */
 long
 oggz_read_input (OGGZ * oggz, unsigned char * buf, long n)
@@ -758,6 +1244,205 @@ oggz_read_input (OGGZ * oggz, unsigned char * buf, long n)
 }
 
 
+/*
+ * oggz_read_sync_needed (oggz)
+ *
+ * Determine how many more bytes the ogg_sync buffer needs before it can
+ * complete (or reject) the partial page left at its head by a previous
+ * call. Returns 0 if the sync buffer holds no unconsumed data.
+ */
+static long
+oggz_read_sync_needed (OGGZ * oggz)
+{
+  ogg_sync_state * oy = &oggz->x.reader.ogg_sync;
+  unsigned char * page;
+  long avail, header_len, body_len, i;
+
+  avail = oy->fill - oy->returned;
+  if (avail <= 0) return 0;
+
+  page = oy->data + oy->returned;
+
+  if (avail < 27) return 27 - avail;
+
+  header_len = page[26] + 27;
+  if (avail < header_len) return header_len - avail;
+
+  body_len = 0;
+  for (i = 0; i < page[26]; i++)
+    body_len += page[27 + i];
+
+  /* A complete page is already buffered; one more byte is enough to
+   * make progress */
+  if (avail >= header_len + body_len) return 1;
+
+  return header_len + body_len - avail;
+}
+
+long
+oggz_read_input_borrowed (OGGZ * oggz, unsigned char * buf, long n)
+{
+  OggzReader * reader;
+  char * buffer;
+  long bytes, remaining = n, nread = 0;
+  int cb_ret = 0;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if ((cb_ret = oggz->cb_next) != OGGZ_CONTINUE) {
+    oggz->cb_next = 0;
+    return oggz_map_return_value_to_error (cb_ret);
+  }
+
+  reader = &oggz->x.reader;
+
+  cb_ret = oggz_read_sync (oggz);
+  if (cb_ret == OGGZ_ERR_OUT_OF_MEMORY)
+    return cb_ret;
+
+  /* Complete any partial page left in the sync buffer by a previous call,
+   * copying only as much as that page needs */
+  while (cb_ret != OGGZ_STOP_ERR && cb_ret != OGGZ_STOP_OK &&
+         remaining > 0 && (bytes = oggz_read_sync_needed (oggz)) > 0) {
+    bytes = MIN (remaining, bytes);
+    buffer = ogg_sync_buffer (&reader->ogg_sync, bytes);
+    memcpy (buffer, buf, bytes);
+    ogg_sync_wrote (&reader->ogg_sync, bytes);
+
+    buf += bytes;
+    remaining -= bytes;
+    nread += bytes;
+
+    cb_ret = oggz_read_sync (oggz);
+    if (cb_ret == OGGZ_ERR_OUT_OF_MEMORY)
+      return cb_ret;
+  }
+
+  /* Parse the remainder in place, in a single pass of the sync loop */
+  if (cb_ret != OGGZ_STOP_ERR && cb_ret != OGGZ_STOP_OK && remaining > 0) {
+    reader->input = buf;
+    reader->input_fill = remaining;
+    reader->input_returned = 0;
+
+    cb_ret = oggz_read_sync (oggz);
+
+    bytes = reader->input_returned;
+    reader->input = NULL;
+
+    if (cb_ret == OGGZ_ERR_OUT_OF_MEMORY)
+      return cb_ret;
+
+    buf += bytes;
+    remaining -= bytes;
+    nread += bytes;
+
+    /* The buffer is only lent for the duration of this call, so keep a
+     * copy of any trailing partial page. If a callback stopped reading,
+     * the unread pages are left to the caller instead. */
+    if (cb_ret == OGGZ_READ_EMPTY && remaining > 0) {
+      buffer = ogg_sync_buffer (&reader->ogg_sync, remaining);
+      memcpy (buffer, buf, remaining);
+      ogg_sync_wrote (&reader->ogg_sync, remaining);
+
+      nread += remaining;
+      remaining = 0;
+    }
+  }
+
+  if (cb_ret == OGGZ_STOP_ERR) oggz_purge (oggz);
+
+  if (nread == 0) {
+    /* Don't return 0 unless it's actually an EOF condition */
+    if (cb_ret == OGGZ_READ_EMPTY) {
+      return OGGZ_ERR_STOP_OK;
+    } else {
+      return oggz_map_return_value_to_error (cb_ret);
+    }
+  } else {
+    if (cb_ret == OGGZ_READ_EMPTY) cb_ret = OGGZ_CONTINUE;
+    oggz->cb_next = cb_ret;
+  }
+
+  return nread;
+}
+
+int
+oggz_read_next_packet (OGGZ * oggz, oggz_packet * zp, long * serialno,
+                       const ogg_page ** og)
+{
+  OggzReader * reader;
+  long bytes;
+  int cb_ret = 0;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (zp == NULL) return OGGZ_ERR_INVALID;
+
+  reader = &oggz->x.reader;
+
+  /* The data of a reverse buffered packet handed out by the previous call
+   * is no longer needed */
+  if (reader->pull_held != NULL) {
+    oggz_pool_release (reader->pull_held);
+    reader->pull_held = NULL;
+  }
+
+  reader->pull = 1;
+  reader->pull_ready = 0;
+
+  /* Hand out a reverse buffered packet if one has become ready */
+  oggz_ring_deliter (oggz->packet_buffer, oggz_read_deliver_packet);
+
+  while (!reader->pull_ready) {
+    cb_ret = oggz_read_sync (oggz);
+    if (reader->pull_ready) break;
+
+    if (cb_ret != OGGZ_READ_EMPTY) {
+      reader->pull = 0;
+      if (cb_ret == OGGZ_ERR_OUT_OF_MEMORY || cb_ret == OGGZ_ERR_HOLE_IN_DATA)
+        return cb_ret;
+      /* stopped by a page callback */
+      if (cb_ret == OGGZ_STOP_ERR) oggz_purge (oggz);
+      return oggz_map_return_value_to_error (cb_ret);
+    }
+
+    bytes = oggz_read_fill (oggz, CHUNKSIZE);
+    if (bytes <= 0) {
+      /* EOF, or an error as per oggz_io_read() */
+      reader->pull = 0;
+      return (int)bytes;
+    }
+  }
+
+  reader->pull = 0;
+
+  *zp = reader->pull_packet;
+  if (serialno != NULL) *serialno = reader->pull_serialno;
+  if (og != NULL) *og = reader->pull_page;
+
+  return 1;
+}
+
+ogg_int64_t
+oggz_get_reverse_buffered_bytes (OGGZ * oggz)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  return oggz->x.reader.reverse_buffered_bytes;
+}
+
 #else /* OGGZ_CONFIG_READ */
 
 #include <ogg/ogg.h>
@@ -782,16 +1467,48 @@ oggz_set_read_callback (OGGZ * oggz, long serialno,
   return OGGZ_ERR_DISABLED;
 }
 
+int
+oggz_set_read_packets (OGGZ * oggz, long serialno,
+                       OggzReadPackets read_packets, void * user_data)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_read (OGGZ * oggz, long n)
 {
   return OGGZ_ERR_DISABLED;
 }
 
+int
+oggz_set_read_ahead (OGGZ * oggz, int nbuffers)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_read_input (OGGZ * oggz, unsigned char * buf, long n)
 {
   return OGGZ_ERR_DISABLED;
 }
 
+long
+oggz_read_input_borrowed (OGGZ * oggz, unsigned char * buf, long n)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_read_next_packet (OGGZ * oggz, oggz_packet * zp, long * serialno,
+                       const ogg_page ** og)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+ogg_int64_t
+oggz_get_reverse_buffered_bytes (OGGZ * oggz)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 #endif
@@ -0,0 +1,367 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_readahead.c
+ *
+ * Background read-ahead. A helper thread keeps a small ring of
+ * fixed-size buffers filled through the handle's underlying I/O while
+ * the caller's thread parses pages and runs callbacks. Only the helper
+ * thread reads while it is running; seeking, telling and closing stop
+ * it first and return the underlying I/O to the position of the data
+ * actually consumed.
+ */
+
+#include "config.h"
+
+#if OGGZ_CONFIG_READ && defined(HAVE_PTHREAD)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "oggz_private.h"
+
+/*#define DEBUG*/
+
+#define OGGZ_READAHEAD_BUFSIZE 65536
+
+typedef struct {
+  unsigned char * data;
+  long len;
+} OggzReadAheadBuffer;
+
+struct _OggzReadAhead {
+  OGGZ * oggz;
+
+  OggzReadAheadBuffer * buffers;
+  int nbuffers;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty; /* signalled when a buffer is filled */
+  pthread_cond_t not_full; /* signalled when a buffer is consumed */
+  int running; /* helper thread has been started and not yet joined */
+  int stop; /* ask the helper thread to exit */
+  int done; /* helper thread hit end of input or an error */
+  long result; /* return value of the read which ended input */
+
+  int head; /* oldest filled buffer */
+  int count; /* number of filled buffers */
+  long consumed; /* bytes of buffers[head] already returned */
+
+  long offset; /* offset of the next byte to be returned, or -1 */
+};
+
+static void *
+oggz_readahead_thread (void * data)
+{
+  OggzReadAhead * ra = (OggzReadAhead *)data;
+  OggzReadAheadBuffer * buffer;
+  long bytes;
+
+  pthread_mutex_lock (&ra->mutex);
+
+  while (!ra->stop) {
+    while (ra->count == ra->nbuffers && !ra->stop)
+      pthread_cond_wait (&ra->not_full, &ra->mutex);
+
+    if (ra->stop) break;
+
+    /* The slot after the filled ones is not touched by the consumer */
+    buffer = &ra->buffers[(ra->head + ra->count) % ra->nbuffers];
+
+    pthread_mutex_unlock (&ra->mutex);
+    bytes = (long) oggz_io_read_raw (ra->oggz, buffer->data,
+                                     OGGZ_READAHEAD_BUFSIZE);
+    pthread_mutex_lock (&ra->mutex);
+
+    if (bytes <= 0) {
+      ra->done = 1;
+      ra->result = bytes;
+      pthread_cond_signal (&ra->not_empty);
+      break;
+    }
+
+    buffer->len = bytes;
+    ra->count++;
+    pthread_cond_signal (&ra->not_empty);
+  }
+
+  pthread_mutex_unlock (&ra->mutex);
+
+  return NULL;
+}
+
+static int
+oggz_readahead_start (OggzReadAhead * ra)
+{
+  ra->stop = 0;
+  ra->done = 0;
+  ra->result = 0;
+  ra->head = 0;
+  ra->count = 0;
+  ra->consumed = 0;
+
+  ra->offset = oggz_io_tell_raw (ra->oggz);
+
+  if (pthread_create (&ra->thread, NULL, oggz_readahead_thread, ra) != 0)
+    return -1;
+
+  ra->running = 1;
+
+  return 0;
+}
+
+/*
+ * Join the helper thread and discard what it has read ahead. Returns the
+ * number of bytes read from the underlying I/O but not consumed.
+ */
+static long
+oggz_readahead_join (OggzReadAhead * ra)
+{
+  long ahead;
+  int i;
+
+  pthread_mutex_lock (&ra->mutex);
+  ra->stop = 1;
+  pthread_cond_signal (&ra->not_full);
+  pthread_mutex_unlock (&ra->mutex);
+
+  pthread_join (ra->thread, NULL);
+  ra->running = 0;
+
+  ahead = -ra->consumed;
+  for (i = 0; i < ra->count; i++)
+    ahead += ra->buffers[(ra->head + i) % ra->nbuffers].len;
+
+  ra->count = 0;
+  ra->consumed = 0;
+
+  return ahead;
+}
+
+int
+oggz_readahead_new (OGGZ * oggz, int nbuffers)
+{
+  OggzReadAhead * ra;
+  int i;
+
+  ra = (OggzReadAhead *) oggz_malloc (sizeof (OggzReadAhead));
+  if (ra == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  ra->buffers = (OggzReadAheadBuffer *)
+    oggz_malloc (nbuffers * sizeof (OggzReadAheadBuffer));
+  if (ra->buffers == NULL) goto err_buffers;
+
+  for (i = 0; i < nbuffers; i++) {
+    ra->buffers[i].len = 0;
+    ra->buffers[i].data = oggz_malloc (OGGZ_READAHEAD_BUFSIZE);
+    if (ra->buffers[i].data == NULL) goto err_data;
+  }
+
+  if (pthread_mutex_init (&ra->mutex, NULL) != 0) goto err_data;
+  if (pthread_cond_init (&ra->not_empty, NULL) != 0) goto err_not_empty;
+  if (pthread_cond_init (&ra->not_full, NULL) != 0) goto err_not_full;
+
+  ra->oggz = oggz;
+  ra->nbuffers = nbuffers;
+  ra->running = 0;
+  ra->stop = 0;
+  ra->done = 0;
+  ra->result = 0;
+  ra->head = 0;
+  ra->count = 0;
+  ra->consumed = 0;
+  ra->offset = -1;
+
+  oggz->readahead = ra;
+
+  return 0;
+
+ err_not_full:
+  pthread_cond_destroy (&ra->not_empty);
+ err_not_empty:
+  pthread_mutex_destroy (&ra->mutex);
+ err_data:
+  while (--i >= 0)
+    oggz_free (ra->buffers[i].data);
+  oggz_free (ra->buffers);
+ err_buffers:
+  oggz_free (ra);
+  return OGGZ_ERR_OUT_OF_MEMORY;
+}
+
+int
+oggz_readahead_stop (OGGZ * oggz)
+{
+  OggzReadAhead * ra = oggz->readahead;
+  long ahead;
+
+  if (ra == NULL || !ra->running) return 0;
+
+  ahead = oggz_readahead_join (ra);
+
+#ifdef DEBUG
+  printf ("oggz_readahead_stop: discarding %ld bytes\n", ahead);
+#endif
+
+  /* Return the underlying I/O to the first unconsumed byte */
+  if (ahead > 0) {
+    if (ra->offset == -1) return -1;
+    if (oggz_io_seek_raw (oggz, ra->offset, SEEK_SET) != 0) return -1;
+  }
+
+  return 0;
+}
+
+int
+oggz_readahead_close (OGGZ * oggz)
+{
+  OggzReadAhead * ra = oggz->readahead;
+  int i, ret;
+
+  if (ra == NULL) return 0;
+
+  ret = oggz_readahead_stop (oggz);
+
+  pthread_cond_destroy (&ra->not_full);
+  pthread_cond_destroy (&ra->not_empty);
+  pthread_mutex_destroy (&ra->mutex);
+
+  for (i = 0; i < ra->nbuffers; i++)
+    oggz_free (ra->buffers[i].data);
+  oggz_free (ra->buffers);
+  oggz_free (ra);
+
+  oggz->readahead = NULL;
+
+  return ret;
+}
+
+size_t
+oggz_readahead_read (OGGZ * oggz, void * buf, size_t n)
+{
+  OggzReadAhead * ra = oggz->readahead;
+  OggzReadAheadBuffer * buffer;
+  long bytes;
+
+  if (!ra->running) {
+    if (oggz_readahead_start (ra) == -1)
+      return oggz_io_read_raw (oggz, buf, n);
+  }
+
+  pthread_mutex_lock (&ra->mutex);
+
+  while (ra->count == 0 && !ra->done)
+    pthread_cond_wait (&ra->not_empty, &ra->mutex);
+
+  if (ra->count == 0) {
+    /* End of input or an error; the next read will try again */
+    bytes = ra->result;
+    pthread_mutex_unlock (&ra->mutex);
+    pthread_join (ra->thread, NULL);
+    ra->running = 0;
+    return (size_t) bytes;
+  }
+
+  buffer = &ra->buffers[ra->head];
+
+  pthread_mutex_unlock (&ra->mutex);
+
+  /* A filled buffer is not touched by the helper thread */
+  bytes = MIN ((long)n, buffer->len - ra->consumed);
+  memcpy (buf, buffer->data + ra->consumed, bytes);
+
+  pthread_mutex_lock (&ra->mutex);
+
+  ra->consumed += bytes;
+  if (ra->consumed == buffer->len) {
+    ra->head = (ra->head + 1) % ra->nbuffers;
+    ra->count--;
+    ra->consumed = 0;
+    pthread_cond_signal (&ra->not_full);
+  }
+
+  pthread_mutex_unlock (&ra->mutex);
+
+  if (ra->offset != -1) ra->offset += bytes;
+
+  return (size_t) bytes;
+}
+
+long
+oggz_readahead_tell (OGGZ * oggz)
+{
+  OggzReadAhead * ra = oggz->readahead;
+
+  if (!ra->running) return oggz_io_tell_raw (oggz);
+
+  return ra->offset;
+}
+
+#else /* OGGZ_CONFIG_READ && HAVE_PTHREAD */
+
+#include "oggz_private.h"
+
+int
+oggz_readahead_new (OGGZ * oggz, int nbuffers)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_readahead_stop (OGGZ * oggz)
+{
+  return 0;
+}
+
+int
+oggz_readahead_close (OGGZ * oggz)
+{
+  return 0;
+}
+
+size_t
+oggz_readahead_read (OGGZ * oggz, void * buf, size_t n)
+{
+  return oggz_io_read_raw (oggz, buf, n);
+}
+
+long
+oggz_readahead_tell (OGGZ * oggz)
+{
+  return oggz_io_tell_raw (oggz);
+}
+
+#endif
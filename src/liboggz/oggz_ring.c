@@ -0,0 +1,191 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz_ring.h"
+#include "oggz_macros.h"
+
+/* Initial number of element slots, must be a power of two */
+#define OGGZ_RING_MIN_SLOTS 16
+
+struct _OggzRing {
+  unsigned char * data;
+  size_t elem_size;
+  int nr_slots; /* always a power of two */
+  int head; /* slot index of the first element */
+  int count; /* number of elements */
+};
+
+#define RING_SLOT(r,i) \
+  ((r)->data + (size_t)(((r)->head + (i)) & ((r)->nr_slots - 1)) * (r)->elem_size)
+
+OggzRing *
+oggz_ring_new (size_t elem_size)
+{
+  OggzRing * ring;
+
+  ring = oggz_malloc (sizeof (OggzRing));
+  if (ring == NULL) return NULL;
+
+  ring->data = NULL;
+  ring->elem_size = elem_size;
+  ring->nr_slots = 0;
+  ring->head = 0;
+  ring->count = 0;
+
+  return ring;
+}
+
+void
+oggz_ring_delete (OggzRing * ring)
+{
+  if (ring == NULL) return;
+
+  oggz_free (ring->data);
+  oggz_free (ring);
+}
+
+int
+oggz_ring_is_empty (OggzRing * ring)
+{
+  return (ring->count == 0);
+}
+
+int
+oggz_ring_size (OggzRing * ring)
+{
+  return ring->count;
+}
+
+static int
+oggz_ring_grow (OggzRing * ring)
+{
+  unsigned char * new_data;
+  int new_slots, first;
+
+  new_slots = ring->nr_slots ? ring->nr_slots * 2 : OGGZ_RING_MIN_SLOTS;
+
+  new_data = oggz_realloc (ring->data, (size_t)new_slots * ring->elem_size);
+  if (new_data == NULL) return -1;
+
+  /* If the elements wrapped around the end of the old buffer, move the
+   * part at the start of the buffer to follow on from the rest */
+  first = ring->nr_slots - ring->head;
+  if (ring->count > first) {
+    memcpy (new_data + (size_t)ring->nr_slots * ring->elem_size, new_data,
+            (size_t)(ring->count - first) * ring->elem_size);
+  }
+
+  ring->data = new_data;
+  ring->nr_slots = new_slots;
+
+  return 0;
+}
+
+void *
+oggz_ring_append (OggzRing * ring)
+{
+  if (ring == NULL) return NULL;
+
+  if (ring->count == ring->nr_slots) {
+    if (oggz_ring_grow (ring) == -1)
+      return NULL;
+  }
+
+  ring->count++;
+
+  return RING_SLOT (ring, ring->count - 1);
+}
+
+void
+oggz_ring_remove_tail (OggzRing * ring)
+{
+  if (ring->count > 0) ring->count--;
+}
+
+void
+oggz_ring_remove_head (OggzRing * ring)
+{
+  if (ring->count == 0) return;
+
+  ring->head = (ring->head + 1) & (ring->nr_slots - 1);
+  ring->count--;
+
+  if (ring->count == 0) ring->head = 0;
+}
+
+void *
+oggz_ring_nth (OggzRing * ring, int n)
+{
+  if (n < 0 || n >= ring->count) return NULL;
+
+  return RING_SLOT (ring, n);
+}
+
+void
+oggz_ring_reverse_iter (OggzRing * ring, OggzRingIterFunc func)
+{
+  int i;
+
+  for (i = ring->count - 1; i >= 0; i--) {
+    if (func (RING_SLOT (ring, i)) == RING_ITER_CANCEL) {
+      break;
+    }
+  }
+}
+
+int
+oggz_ring_deliter (OggzRing * ring, OggzRingIterFunc func)
+{
+  int result = 0;
+
+  while (ring->count > 0) {
+    int r = func (RING_SLOT (ring, 0));
+    if (r == RING_ITER_ERROR) {
+      result = -1;
+    }
+
+    if (r == RING_ITER_CANCEL) {
+      break;
+    }
+
+    ring->head = (ring->head + 1) & (ring->nr_slots - 1);
+    ring->count--;
+  }
+
+  if (ring->count == 0) ring->head = 0;
+
+  return result;
+}
@@ -0,0 +1,119 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_RING_H__
+#define __OGGZ_RING_H__
+
+#include <stddef.h>
+
+/*
+ * A FIFO queue of fixed-size elements, stored by value in a contiguous
+ * circular buffer which grows as needed. Elements are appended at the
+ * tail and removed from the head.
+ *
+ * Pointers to elements remain valid only until the next append.
+ */
+
+struct _OggzRing;
+typedef struct _OggzRing OggzRing;
+
+typedef enum {RING_ITER_ERROR=-1, RING_ITER_CANCEL=0, RING_ITER_CONTINUE=1} OggzRingIterResponse;
+
+typedef OggzRingIterResponse (*OggzRingIterFunc) (void *elem);
+
+/**
+ * Create a new ring.
+ * \param elem_size The size of each element
+ * \retval a pointer to the new ring.
+ * \retval NULL on failure.
+ */
+OggzRing *
+oggz_ring_new (size_t elem_size);
+
+/**
+ * Destroy a ring. Any remaining elements are discarded.
+ */
+void
+oggz_ring_delete (OggzRing * ring);
+
+int
+oggz_ring_is_empty (OggzRing * ring);
+
+int
+oggz_ring_size (OggzRing * ring);
+
+/**
+ * Add an element at the tail of a ring.
+ * \retval a pointer to the new (uninitialized) element
+ * \retval NULL on failure.
+ */
+void *
+oggz_ring_append (OggzRing * ring);
+
+/**
+ * Remove the element most recently appended to a ring.
+ */
+void
+oggz_ring_remove_tail (OggzRing * ring);
+
+/**
+ * Remove the element at the head of a ring.
+ */
+void
+oggz_ring_remove_head (OggzRing * ring);
+
+/**
+ * Retrieve the nth element of a ring, counting from the head.
+ * \retval NULL if n is out of range
+ */
+void *
+oggz_ring_nth (OggzRing * ring, int n);
+
+/**
+ * Call a function on each element of a ring, from tail to head,
+ * stopping if it returns RING_ITER_CANCEL.
+ */
+void
+oggz_ring_reverse_iter (OggzRing * ring, OggzRingIterFunc func);
+
+/**
+ * Call a function on each element of a ring, from head to tail,
+ * removing each element after it has been processed. Iteration stops
+ * (without removing the current element) when the function returns
+ * RING_ITER_CANCEL.
+ * \retval 0 on success
+ * \retval -1 if the function returned RING_ITER_ERROR for any element
+ */
+int
+oggz_ring_deliter (OggzRing * ring, OggzRingIterFunc func);
+
+#endif /* __OGGZ_RING_H__ */
@@ -60,6 +60,8 @@
 #include "oggz_compat.h"
 #include "oggz_private.h"
 
+#include "oggz/oggz_seek.h"
+
 /*#define DEBUG*/
 /*#define DEBUG_VERBOSE*/
 
@@ -108,6 +110,8 @@ oggz_seek_raw (OGGZ * oggz, oggz_off_t offset, int whence)
   OggzReader  * reader = &oggz->x.reader;
   oggz_off_t    offset_at;
 
+  reader->seek_probes++;
+
   if (oggz_io_seek (oggz, offset, whence) == -1) {
     return -1;
   }
@@ -115,6 +119,7 @@ oggz_seek_raw (OGGZ * oggz, oggz_off_t offset, int whence)
   offset_at = oggz_io_tell (oggz);
 
   oggz->offset = offset_at;
+  reader->current_page_bytes = 0;
 
   ogg_sync_reset (&reader->ogg_sync);
 
@@ -139,6 +144,9 @@ static void
 oggz_reset_streams (OGGZ * oggz)
 {
   oggz_vector_foreach (oggz->streams, oggz_stream_reset);
+
+  /* Drop any packets collected for a batch callback */
+  oggz_read_batch_clear (oggz);
 }
 
 static long
@@ -199,19 +207,19 @@ static oggz_off_t
 oggz_get_next_page (OGGZ * oggz, ogg_page * og)
 {
   OggzReader * reader = &oggz->x.reader;
-  char * buffer;
-  long bytes = 0, more;
-  oggz_off_t page_offset = 0, ret;
+  long bytes, more;
   int found = 0;
 
+  /* Step past the page last returned; oggz->offset then tracks the
+   * offset of the next byte held in the sync buffer */
+  oggz->offset += reader->current_page_bytes;
+  reader->current_page_bytes = 0;
+
   do {
-    more = ogg_sync_pageseek (&reader->ogg_sync, og);
+    more = oggz_read_pageseek (oggz, og);
 
     if (more == 0) {
-      page_offset = 0;
-
-      buffer = ogg_sync_buffer (&reader->ogg_sync, CHUNKSIZE);
-      if ((bytes = (long) oggz_io_read (oggz, buffer, CHUNKSIZE)) == 0) {
+      if ((bytes = oggz_read_fill (oggz, CHUNKSIZE)) == 0) {
 	if (oggz->file && feof (oggz->file)) {
 #ifdef DEBUG_VERBOSE
 	  printf ("get_next_page: feof (oggz->file), returning -2\n");
@@ -220,7 +228,7 @@ oggz_get_next_page (OGGZ * oggz, ogg_page * og)
 	  return -2;
 	}
       }
-      if (bytes == OGGZ_ERR_SYSTEM) {
+      if (bytes < 0) {
 	  /*oggz_set_error (oggz, OGGZ_ERR_SYSTEM);*/
 	  return -1;
       }
@@ -232,33 +240,24 @@ oggz_get_next_page (OGGZ * oggz, ogg_page * og)
 	return -2;
       }
 
-      ogg_sync_wrote(&reader->ogg_sync, bytes);
+      reader->seek_bytes_read += bytes;
 
     } else if (more < 0) {
 #ifdef DEBUG_VERBOSE
       printf ("get_next_page: skipped %ld bytes\n", -more);
 #endif
-      page_offset -= more;
+      oggz->offset += (-more);
     } else {
 #ifdef DEBUG_VERBOSE
       printf ("get_next_page: page has %ld bytes\n", more);
 #endif
+      reader->current_page_bytes = more;
       found = 1;
     }
 
   } while (!found);
 
-  /* Calculate the byte offset of the page which was found */
-  if (bytes > 0) {
-    oggz->offset = oggz_tell_raw (oggz) - bytes + page_offset;
-  } else {
-    /* didn't need to do any reading -- accumulate the page_offset */
-    oggz->offset += page_offset;
-  }
-  
-  ret = oggz->offset + more;
-
-  return ret;
+  return oggz->offset;
 }
 
 static oggz_off_t
@@ -287,100 +286,193 @@ oggz_get_next_start_page (OGGZ * oggz, ogg_page * og)
   return page_offset;
 }
 
-static oggz_off_t
-oggz_get_prev_start_page (OGGZ * oggz, ogg_page * og,
-			 ogg_int64_t * granule, long * serialno)
+/*
+ * oggz_read_block (oggz, offset, buf, n)
+ *
+ * Read up to n bytes at offset into buf, bypassing the sync buffer,
+ * with a positional read where possible and otherwise a seek and reads.
+ * Returns the number of bytes read, which is short only at end of
+ * file, or -1 on error.
+ */
+static long
+oggz_read_block (OGGZ * oggz, oggz_off_t offset, unsigned char * buf, long n)
 {
-  oggz_off_t offset_at, offset_start;
-  oggz_off_t page_offset, found_offset = 0;
-  ogg_int64_t unit_at;
-  ogg_int64_t granule_at = -1;
+  OggzReader * reader = &oggz->x.reader;
+  long bytes, len = 0;
 
-#if 0
-  offset_at = oggz_tell_raw (oggz);
-  if (offset_at == -1) return -1;
-#else
-  offset_at = oggz->offset;
-#endif
+  if (oggz_io_can_read_at (oggz)) {
+    reader->seek_probes++;
 
-  offset_start = offset_at;
+    len = oggz_io_read_at (oggz, buf, n, offset);
+    if (len < 0) return -1;
 
-  do {
+    reader->seek_bytes_read += len;
 
-    offset_start = offset_start - CHUNKSIZE;
-    if (offset_start < 0) offset_start = 0;
+    return len;
+  }
 
-    offset_start = oggz_seek_raw (oggz, offset_start, SEEK_SET);
-    if (offset_start == -1) return -1;
+  if (oggz_seek_raw (oggz, offset, SEEK_SET) == -1) return -1;
 
-#ifdef DEBUG
+  while (len < n) {
+    bytes = (long) oggz_io_read (oggz, buf + len, n - len);
+    if (bytes < 0) return -1;
+    if (bytes == 0) break;
+    len += bytes;
+  }
 
-    printf ("get_prev_start_page: [A] offset_at: @%" PRI_OGGZ_OFF_T "d\toffset_start: @%" PRI_OGGZ_OFF_T "d\n",
-	    offset_at, offset_start);
+  reader->seek_bytes_read += len;
 
-    printf ("get_prev_start_page: seeked to %" PRI_OGGZ_OFF_T "d\n", offset_start);
-#endif
+  return len;
+}
 
-    page_offset = 0;
+/*
+ * A function called by oggz_scan_back() for each page carrying a
+ * granulepos, latest first. Return non-zero to stop the scan.
+ */
+typedef int (*OggzScanBack) (OGGZ * oggz, oggz_off_t offset, ogg_page * og,
+                             void * user_data);
+
+/*
+ * oggz_scan_back (oggz, offset_at, func, user_data)
+ *
+ * Visit the pages carrying a granulepos which start before offset_at,
+ * from the latest back to the start of the file or until func returns
+ * non-zero. Blocks of CHUNKSIZE bytes are read once each and searched
+ * backwards for the "OggS" capture pattern; candidates are confirmed by
+ * their CRC. A candidate whose page runs past the end of the block is
+ * confirmed by reading it in full with oggz_get_next_page().
+ *
+ * The file position is left undefined.
+ * Returns the offset of the page at which func stopped the scan, 0 if
+ * it did not, or -1 on error.
+ */
+static oggz_off_t
+oggz_scan_back (OGGZ * oggz, oggz_off_t offset_at, OggzScanBack func,
+                void * user_data)
+{
+  unsigned char buf[CHUNKSIZE+3];
+  ogg_page page;
+  oggz_off_t offset_start, offset_limit, page_offset;
+  long len, more, i;
+
+  offset_limit = offset_at;
+
+  while (offset_limit > 0) {
+    /* Each block overlaps the one after it by the length of the capture
+     * pattern less one, so that a pattern straddling the boundary is
+     * still seen; candidates at or beyond offset_limit were tried with
+     * the previous block */
+    offset_start = offset_limit - CHUNKSIZE;
+    if (offset_start < 0) offset_start = 0;
+
+    len = (long) (offset_limit - offset_start) + 3;
+    len = oggz_read_block (oggz, offset_start, buf, len);
+    if (len == -1) return -1;
 
-    do {
-      page_offset = oggz_get_next_start_page (oggz, og);
-      if (page_offset == -1) {
-#ifdef DEBUG
-	printf ("get_prev_start_page: page_offset = -1\n");
-#endif
-	return -1;
-      }
-      if (page_offset == -2) {
 #ifdef DEBUG
-	printf ("*** get_prev_start_page: page_offset = -2\n");
+    printf ("scan_back: offset_at: @%" PRI_OGGZ_OFF_T "d\t"
+            "block: @%" PRI_OGGZ_OFF_T "d (%ld bytes)\n",
+            offset_at, offset_start, len);
 #endif
-	break;
-      }
 
-      granule_at = ogg_page_granulepos (og);
+    for (i = (long) (offset_limit - offset_start) - 1; i >= 0; i--) {
+      if (i + 4 > len || memcmp (buf + i, "OggS", 4)) continue;
 
-#ifdef DEBUG_VERBOSE
-      printf ("get_prev_start_page: GOT page (%lld) @%" PRI_OGGZ_OFF_T "d\tat @%" PRI_OGGZ_OFF_T  "d\n",
-	      granule_at, page_offset, offset_at);
-#endif
+      page_offset = offset_start + i;
+      more = oggz_read_pageseek_mem (buf + i, len - i, &page);
 
-      /* Need to stash the granule and serialno of this page because og
-       * will be overwritten by the time we realise this was the desired
-       * prev page */
-      if (page_offset >= 0 && page_offset < offset_at) {
-	found_offset = page_offset;
-	*granule = granule_at;
-	*serialno = ogg_page_serialno (og);
+      if (more < 0) continue;
+
+      if (more == 0) {
+        /* The page continues past the end of the block */
+        if (oggz_seek_raw (oggz, page_offset, SEEK_SET) == -1) return -1;
+        if (oggz_get_next_page (oggz, &page) != page_offset) continue;
       }
 
-    } while (page_offset >= 0 && page_offset < offset_at);
+      if (ogg_page_granulepos (&page) > -1 &&
+          func (oggz, page_offset, &page, user_data))
+        return page_offset;
+    }
 
-#ifdef DEBUG
-    printf ("get_prev_start_page: [B] offset_at: @%" PRI_OGGZ_OFF_T "d\toffset_start: @%" PRI_OGGZ_OFF_T "d\n"
-	    "found_offset: @%" PRI_OGGZ_OFF_T "d\tpage_offset: @%" PRI_OGGZ_OFF_T "d\n",
-	    offset_at, offset_start, found_offset, page_offset);
-#endif
-    /* reset the file offset */
-    /*offset_at = offset_start;*/
+    offset_limit = offset_start;
+  }
+
+  return 0;
+}
+
+typedef struct {
+  ogg_int64_t unit_max;
+  ogg_int64_t granulepos;
+  long serialno;
+} OggzPrevStartPage;
+
+static int
+oggz_prev_start_page_found (OGGZ * oggz, oggz_off_t offset, ogg_page * og,
+                            void * user_data)
+{
+  OggzPrevStartPage * prev = (OggzPrevStartPage *) user_data;
+  ogg_int64_t granulepos;
+  long serialno;
+
+  granulepos = ogg_page_granulepos (og);
+  serialno = ogg_page_serialno (og);
+
+  if (prev->unit_max != -1 &&
+      oggz_get_unit (oggz, serialno, granulepos) > prev->unit_max)
+    return 0;
 
-  } while (found_offset == 0 && offset_start > 0);
+  prev->granulepos = granulepos;
+  prev->serialno = serialno;
+
+  return 1;
+}
+
+/*
+ * oggz_get_prev_start_page (oggz, offset, og, unit_max, granule, serialno)
+ *
+ * Find the last page before offset which starts a packet
+ * (ie. has a granulepos), with oggz_scan_back(). Unless unit_max is -1,
+ * pages later than unit_max are passed over in the same scan.
+ *
+ * The handle is left positioned at the start of the page found, with
+ * its granulepos and serialno returned in *granule and *serialno.
+ * Returns the offset of that page, or -1 on error. If no such page
+ * is found the handle is reset to the start of the file.
+ */
+static oggz_off_t
+oggz_get_prev_start_page (OGGZ * oggz, oggz_off_t offset, ogg_page * og,
+			  ogg_int64_t unit_max,
+			  ogg_int64_t * granule, long * serialno)
+{
+  OggzPrevStartPage prev;
+  oggz_off_t offset_at, found_offset;
+  ogg_int64_t unit_at = -1;
+
+  prev.unit_max = unit_max;
+  prev.granulepos = -1;
+  prev.serialno = -1;
+
+  found_offset = oggz_scan_back (oggz, offset,
+                                 oggz_prev_start_page_found, &prev);
+  if (found_offset == -1) return -1;
+
+  *granule = prev.granulepos;
+  *serialno = prev.serialno;
+  if (prev.granulepos != -1) {
+    unit_at = oggz_get_unit (oggz, *serialno, *granule);
+  }
 
-  unit_at = oggz_get_unit (oggz, *serialno, *granule);
   offset_at = oggz_reset (oggz, found_offset, unit_at, SEEK_SET);
 
 #ifdef DEBUG
-    printf ("get_prev_start_page: [C] offset_at: @%" PRI_OGGZ_OFF_T "d\t"
-	    "found_offset: @%" PRI_OGGZ_OFF_T "d\tunit_at: %lld\n",
-	    offset_at, found_offset, unit_at);
+  printf ("get_prev_start_page: offset_at: @%" PRI_OGGZ_OFF_T "d\t"
+          "found_offset: @%" PRI_OGGZ_OFF_T "d\tunit_at: %lld\n",
+          offset_at, found_offset, unit_at);
 #endif
 
   if (offset_at == -1) return -1;
 
-  if (offset_at >= 0)
-    return found_offset;
-  else
-    return -1;
+  return found_offset;
 }
 
 static oggz_off_t
@@ -478,7 +570,8 @@ oggz_scan_for_page (OGGZ * oggz, ogg_page * og, ogg_int64_t unit_target,
       break;
 #else
       do {
-        offset_at = oggz_get_prev_start_page(oggz, og, &granule_at, &serialno);
+        offset_at = oggz_get_prev_start_page(oggz, oggz->offset, og, -1,
+                                             &granule_at, &serialno);
         if (offset_at < 0)
           break;
         unit_at = oggz_get_unit(oggz, serialno, granule_at);
@@ -496,70 +589,538 @@ oggz_scan_for_page (OGGZ * oggz, ogg_page * og, ogg_int64_t unit_target,
   return offset_at;
 }
 
+/*
+ * Seek landmarks. Every page found while seeking tells us the unit at
+ * some position in the file; rather than throwing this away, up to
+ * OGGZ_SEEK_LANDMARKS such points are kept for the handle, along with
+ * the last page of the file, and later seeks start bisecting from the
+ * narrowest bracket the landmarks give. As with the seek index, the
+ * granulepos is stored rather than the unit so that landmarks remain
+ * valid if metrics change.
+ */
+
+#define OGGZ_SEEK_LANDMARKS 64
+
+void
+oggz_seek_landmarks_clear (OGGZ * oggz)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (reader->landmarks != NULL) {
+    oggz_free (reader->landmarks);
+    reader->landmarks = NULL;
+  }
+
+  reader->nr_landmarks = 0;
+  reader->landmark_read_offset = -1;
+  reader->landmark_end_serialno = -1;
+  reader->landmark_end_granulepos = -1;
+}
+
+/*
+ * Discard the landmarks if the file has changed size since they were
+ * learned.
+ */
+static void
+oggz_seek_landmarks_check (OGGZ * oggz, oggz_off_t offset_end)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (reader->landmarks_size != -1 && reader->landmarks_size != offset_end)
+    oggz_seek_landmarks_clear (oggz);
+
+  reader->landmarks_size = offset_end;
+}
+
+void
+oggz_seek_landmark_add (OGGZ * oggz, oggz_off_t offset, long serialno,
+                        ogg_int64_t granulepos)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzSeekLandmark * landmarks;
+  oggz_off_t gap, gap_min;
+  int lo, hi, mid, i, n;
+
+  if (offset < 0 || granulepos == -1) return;
+
+  if (reader->landmarks == NULL) {
+    reader->landmarks =
+      oggz_malloc ((OGGZ_SEEK_LANDMARKS + 1) * sizeof (OggzSeekLandmark));
+    if (reader->landmarks == NULL) return;
+  }
+
+  landmarks = reader->landmarks;
+  n = reader->nr_landmarks;
+
+  lo = 0;
+  hi = n;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (landmarks[mid].offset < offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo < n && landmarks[lo].offset == offset) {
+    landmarks[lo].serialno = serialno;
+    landmarks[lo].granulepos = granulepos;
+    return;
+  }
+
+  memmove (&landmarks[lo+1], &landmarks[lo],
+           (n - lo) * sizeof (OggzSeekLandmark));
+  landmarks[lo].offset = offset;
+  landmarks[lo].serialno = serialno;
+  landmarks[lo].granulepos = granulepos;
+  n++;
+
+  if (n > OGGZ_SEEK_LANDMARKS) {
+    /* Drop the landmark whose neighbours are closest together, so that
+     * those kept stay spread through the file */
+    mid = 1;
+    gap_min = landmarks[2].offset - landmarks[0].offset;
+    for (i = 2; i < n-1; i++) {
+      gap = landmarks[i+1].offset - landmarks[i-1].offset;
+      if (gap < gap_min) {
+        gap_min = gap;
+        mid = i;
+      }
+    }
+
+    memmove (&landmarks[mid], &landmarks[mid+1],
+             (n - mid - 1) * sizeof (OggzSeekLandmark));
+    n--;
+  }
+
+  reader->nr_landmarks = n;
+}
+
+/*
+ * Record a page read sequentially as a landmark. This is on the path of
+ * every page read, so nothing is kept until the first seek has given the
+ * file size, and then only pages a stride of 1/OGGZ_SEEK_LANDMARKS of
+ * the file past the last one recorded; a page before it (ie. after
+ * seeking back) starts a new stride.
+ */
+void
+oggz_seek_landmark_read (OGGZ * oggz, oggz_off_t offset, long serialno,
+                         ogg_int64_t granulepos)
+{
+  OggzReader * reader = &oggz->x.reader;
+  oggz_off_t last = reader->landmark_read_offset;
+
+  if (reader->landmarks_size <= 0 || granulepos == -1) return;
+
+  if (last != -1 && offset >= last &&
+      offset - last < reader->landmarks_size / OGGZ_SEEK_LANDMARKS)
+    return;
+
+  reader->landmark_read_offset = offset;
+  oggz_seek_landmark_add (oggz, offset, serialno, granulepos);
+}
+
+/*
+ * Find the unit of the landmark at exactly offset.
+ * returns 1 if found, 0 otherwise
+ */
+static int
+oggz_seek_landmark_unit (OGGZ * oggz, oggz_off_t offset, ogg_int64_t * unit)
+{
+  OggzReader * reader = &oggz->x.reader;
+  int i;
+
+  for (i = 0; i < reader->nr_landmarks; i++) {
+    if (reader->landmarks[i].offset == offset) {
+      *unit = oggz_get_unit (oggz, reader->landmarks[i].serialno,
+                             reader->landmarks[i].granulepos);
+      return (*unit != -1);
+    }
+    if (reader->landmarks[i].offset > offset) break;
+  }
+
+  return 0;
+}
+
+/*
+ * Narrow the search range [offset_begin, offset_end) for unit_target:
+ * the last landmark in range at or before the target becomes the
+ * beginning, and the first landmark after that past the target becomes
+ * the end.
+ */
+static void
+oggz_seek_landmarks_bracket (OGGZ * oggz, ogg_int64_t unit_target,
+                             oggz_off_t * offset_begin,
+                             ogg_int64_t * unit_begin,
+                             oggz_off_t * offset_end,
+                             ogg_int64_t * unit_end)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzSeekLandmark * landmark;
+  ogg_int64_t unit;
+  int i;
+
+  for (i = 0; i < reader->nr_landmarks; i++) {
+    landmark = &reader->landmarks[i];
+    if (landmark->offset < *offset_begin) continue;
+    if (landmark->offset >= *offset_end) break;
+
+    unit = oggz_get_unit (oggz, landmark->serialno, landmark->granulepos);
+    if (unit != -1 && unit <= unit_target && unit >= *unit_begin) {
+      *offset_begin = landmark->offset;
+      *unit_begin = unit;
+    }
+  }
+
+  for (i = 0; i < reader->nr_landmarks; i++) {
+    landmark = &reader->landmarks[i];
+    if (landmark->offset <= *offset_begin) continue;
+    if (landmark->offset > *offset_end) break;
+
+    unit = oggz_get_unit (oggz, landmark->serialno, landmark->granulepos);
+    if (unit > unit_target && (*unit_end == -1 || unit <= *unit_end)) {
+      *offset_end = landmark->offset;
+      *unit_end = unit;
+      break;
+    }
+  }
+
+#ifdef DEBUG
+  printf ("oggz_seek_landmarks_bracket: (u%lld - u%lld) [@%" PRI_OGGZ_OFF_T "d - @%" PRI_OGGZ_OFF_T "d]\n",
+          *unit_begin, *unit_end, *offset_begin, *offset_end);
+#endif
+}
+
+/*
+ * Find the unit of the last page before offset_end, remembering it if
+ * offset_end is the end of the file.
+ * returns 0 on success, -1 on failure
+ */
+static int
+oggz_seek_unit_end (OGGZ * oggz, oggz_off_t offset_end, ogg_int64_t * unit_end)
+{
+  OggzReader * reader = &oggz->x.reader;
+  ogg_int64_t granulepos;
+  long serialno;
+  int at_end;
+
+  at_end = (offset_end == reader->landmarks_size);
+
+  if (at_end && reader->landmark_end_granulepos != -1) {
+    *unit_end = oggz_get_unit (oggz, reader->landmark_end_serialno,
+                               reader->landmark_end_granulepos);
+    return 0;
+  }
+
+  if (oggz_get_prev_start_page (oggz, offset_end, &oggz->current_page, -1,
+                                &granulepos, &serialno) < 0)
+    return -1;
+
+  if (at_end) {
+    reader->landmark_end_serialno = serialno;
+    reader->landmark_end_granulepos = granulepos;
+  }
+
+  *unit_end = oggz_get_unit (oggz, serialno, granulepos);
+
+  return 0;
+}
+
 #define GUESS_MULTIPLIER (1<<16)
 
+/*
+ * Seeking narrows a bracket of byte offsets around the target using the
+ * ITP method (interpolate, truncate, project) of Oliveira and Takahashi.
+ * Probes follow the linear interpolation while it makes good progress,
+ * but are kept close enough to the midpoint that a seek never needs more
+ * than GUESS_N0 probes beyond those of plain bisection. The search stops
+ * once the bracket is no wider than GUESS_EPSILON*2 bytes, and the target
+ * page is then found by reading backwards from its end.
+ *
+ * Each truncation moves the interpolated guess towards the midpoint by
+ * width^2 / (GUESS_K1_INV * width_0), where width_0 is the initial width
+ * of the bracket.
+ */
+#define GUESS_EPSILON (CHUNKSIZE/2)
+#define GUESS_N0 1
+#define GUESS_K1_INV 50
+
 static oggz_off_t
-guess (ogg_int64_t unit_at, ogg_int64_t unit_target,
+guess (ogg_int64_t unit_target,
        ogg_int64_t unit_begin, ogg_int64_t unit_end,
        oggz_off_t offset_begin, oggz_off_t offset_end)
 {
   ogg_int64_t guess_ratio;
   oggz_off_t offset_guess;
 
-  if (unit_at == unit_begin) return offset_begin;
-
-  if (unit_end != -1) {
-    guess_ratio =
-      GUESS_MULTIPLIER * (unit_target - unit_begin) /
-      (unit_end - unit_begin);
-  } else {
-    guess_ratio =
-      GUESS_MULTIPLIER * (unit_target - unit_begin) /
-      (unit_at - unit_begin);
+  if (unit_end <= unit_begin) {
+    return offset_begin + (offset_end - offset_begin)/2;
   }
 
+  guess_ratio =
+    GUESS_MULTIPLIER * (unit_target - unit_begin) /
+    (unit_end - unit_begin);
+
 #ifdef DEBUG
   printf ("oggz_seek::guess: guess_ratio %lld = (%lld - %lld) / (%lld - %lld)\n",
-	  guess_ratio, unit_target, unit_begin, unit_at, unit_begin);
+	  guess_ratio, unit_target, unit_begin, unit_end, unit_begin);
 #endif
-  
+
   offset_guess = offset_begin +
     (oggz_off_t)(((offset_end - offset_begin) * guess_ratio) /
 		 GUESS_MULTIPLIER);
-  
+
   return offset_guess;
 }
 
+/*
+ * The number of probes plain bisection needs to narrow a bracket of the
+ * given width, plus the GUESS_N0 extra probes allowed
+ */
+static int
+oggz_seek_max_probes (oggz_off_t width)
+{
+  int n = GUESS_N0;
+
+  while (width > 2 * GUESS_EPSILON) {
+    width = (width + 1) / 2;
+    n++;
+  }
+
+  return n;
+}
+
 static oggz_off_t
-oggz_seek_guess (ogg_int64_t unit_at, ogg_int64_t unit_target,
+oggz_seek_guess (ogg_int64_t unit_target,
 		 ogg_int64_t unit_begin, ogg_int64_t unit_end,
-		 oggz_off_t offset_at,
-		 oggz_off_t offset_begin, oggz_off_t offset_end)
+		 oggz_off_t offset_begin, oggz_off_t offset_end,
+		 oggz_off_t width_0, int probes_left)
 {
-  oggz_off_t offset_guess;
+  oggz_off_t width, offset_half, offset_interp, offset_trunc, offset_guess;
+  oggz_off_t delta, radius;
+  int sigma;
+
+  width = offset_end - offset_begin;
+  offset_half = offset_begin + width/2;
+
+  /* Interpolate */
+  offset_interp = guess (unit_target, unit_begin, unit_end,
+			 offset_begin, offset_end);
+
+  /* Truncate towards the midpoint */
+  sigma = (offset_half >= offset_interp) ? 1 : -1;
+  delta = (oggz_off_t)((double)width * width /
+		       ((double)GUESS_K1_INV * width_0));
+  if (delta <= sigma * (offset_half - offset_interp)) {
+    offset_trunc = offset_interp + sigma * delta;
+  } else {
+    offset_trunc = offset_half;
+  }
 
-  if (unit_at == unit_begin) {
-    offset_guess = offset_begin + (offset_end - offset_begin)/2;
-  } else if (unit_end == -1) {
-    offset_guess = guess (unit_at, unit_target, unit_begin, unit_end,
-			  offset_begin, offset_at);
-  } else if (unit_end <= unit_begin) {
-#ifdef DEBUG
-    printf ("oggz_seek_guess: unit_end <= unit_begin (ERROR)\n");
-#endif
-    offset_guess = -1;
+  /* Project into the neighbourhood of the midpoint which still allows
+   * the search to finish within probes_left probes */
+  if (probes_left > 40) probes_left = 40;
+  if (probes_left < 0) {
+    radius = 0;
   } else {
-    offset_guess = guess (unit_at, unit_target, unit_begin, unit_end,
-			  offset_begin, offset_end);
+    radius = ((oggz_off_t)GUESS_EPSILON << probes_left) - width/2;
+    if (radius < 0) radius = 0;
   }
 
+  if (sigma * (offset_half - offset_trunc) <= radius) {
+    offset_guess = offset_trunc;
+  } else {
+    offset_guess = offset_half - sigma * radius;
+  }
+
+  /* Every probe must fall strictly inside the bracket */
+  if (offset_guess <= offset_begin) offset_guess = offset_begin + 1;
+  if (offset_guess >= offset_end) offset_guess = offset_end - 1;
+
 #ifdef DEBUG
-    printf ("oggz_seek_guess: guessed %" PRI_OGGZ_OFF_T "d\n", offset_guess);
+    printf ("oggz_seek_guess: interpolated %" PRI_OGGZ_OFF_T "d, guessed %" PRI_OGGZ_OFF_T "d\n",
+	    offset_interp, offset_guess);
 #endif
 
   return offset_guess;
 }
 
+/*
+ * Where each round trip to the storage is slow, several probes may be
+ * made at once: nr_probes reads of PROBE_SIZE bytes, dividing the
+ * bracket into nr_probes+1 equal sections. Each round narrows the
+ * bracket to one section, after which ITP finishes the search.
+ */
+#define PROBE_SIZE (2*CHUNKSIZE)
+
+/*
+ * Find the first complete page carrying a granulepos in the probe data.
+ * Returns its offset, or -1 if there is none.
+ */
+static oggz_off_t
+oggz_seek_probe_page (OggzIOProbe * probe, ogg_page * og)
+{
+  long more, at = 0;
+
+  while (at < probe->len) {
+    more = oggz_read_pageseek_mem (probe->buf + at, probe->len - at, og);
+    if (more == 0) break;
+
+    if (more > 0 && ogg_page_granulepos (og) > -1)
+      return probe->offset + at;
+
+    at += (more > 0) ? more : -more;
+  }
+
+  return -1;
+}
+
+/*
+ * Find the first page carrying a granulepos at or after offset, as a
+ * probe while seeking. A positional read of PROBE_SIZE bytes is tried
+ * first where possible, falling back to seeking and reading pages in
+ * sequence if no whole page is found in it.
+ * Returns the offset of the page, with its serialno and granulepos, or
+ * -2 if there is none before the end of the file, or -1 on error.
+ */
+static oggz_off_t
+oggz_seek_next_start_page_at (OGGZ * oggz, oggz_off_t offset,
+                              long * serialno, ogg_int64_t * granulepos)
+{
+  unsigned char buf[PROBE_SIZE];
+  OggzIOProbe probe;
+  ogg_page * og = &oggz->current_page;
+  ogg_page page;
+  oggz_off_t offset_page;
+
+  if (oggz_io_can_read_at (oggz)) {
+    probe.offset = offset;
+    probe.buf = buf;
+    probe.n = PROBE_SIZE;
+    probe.len = oggz_read_block (oggz, offset, buf, PROBE_SIZE);
+    if (probe.len == -1) return -1;
+
+    offset_page = oggz_seek_probe_page (&probe, &page);
+    if (offset_page != -1) {
+      *serialno = ogg_page_serialno (&page);
+      *granulepos = ogg_page_granulepos (&page);
+      return offset_page;
+    }
+
+    if (probe.len < probe.n) return -2;
+  }
+
+  if (oggz_seek_raw (oggz, offset, SEEK_SET) == -1) return -1;
+
+  offset_page = oggz_get_next_start_page (oggz, og);
+  if (offset_page >= 0) {
+    *serialno = ogg_page_serialno (og);
+    *granulepos = ogg_page_granulepos (og);
+  }
+
+  return offset_page;
+}
+
+/*
+ * Make one round of probes into the bracket, and narrow it.
+ * Returns the number of probes which narrowed the bracket, or -1 if
+ * the probes could not be made.
+ */
+static int
+oggz_seek_probe_sections (OGGZ * oggz, ogg_int64_t unit_target,
+                          oggz_off_t * offset_begin, ogg_int64_t * unit_begin,
+                          oggz_off_t * offset_end, ogg_int64_t * unit_end)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzIOProbe * probes;
+  unsigned char * data;
+  ogg_page og;
+  oggz_off_t width, offset_page;
+  ogg_int64_t granulepos, unit;
+  long serialno;
+  int i, k, narrowed = 0;
+
+  k = reader->seek_nr_probes;
+  width = *offset_end - *offset_begin;
+
+  probes = oggz_malloc (k * sizeof (OggzIOProbe));
+  if (probes == NULL) return -1;
+
+  data = oggz_malloc (k * PROBE_SIZE);
+  if (data == NULL) {
+    oggz_free (probes);
+    return -1;
+  }
+
+  for (i = 0; i < k; i++) {
+    probes[i].offset = *offset_begin + width * (i+1) / (k+1);
+    probes[i].buf = data + i * PROBE_SIZE;
+    probes[i].n = PROBE_SIZE;
+    probes[i].len = -1;
+  }
+
+  if (oggz_io_read_multi (oggz, probes, k) != 0) {
+    oggz_free (data);
+    oggz_free (probes);
+    return -1;
+  }
+
+  /* The reads happen at once, so count them as a single probe */
+  reader->seek_probes++;
+
+  for (i = 0; i < k; i++) {
+    if (probes[i].len <= 0) continue;
+
+    reader->seek_bytes_read += probes[i].len;
+
+    if (probes[i].offset <= *offset_begin) continue;
+    if (probes[i].offset >= *offset_end) break;
+
+    offset_page = oggz_seek_probe_page (&probes[i], &og);
+
+    if (offset_page == -1) {
+      /* No page starts between the probe and the end of the bracket */
+      if (probes[i].offset + probes[i].len >= *offset_end) {
+        *offset_end = probes[i].offset;
+        narrowed++;
+      }
+      continue;
+    }
+
+    if (offset_page >= *offset_end) {
+      *offset_end = probes[i].offset;
+      narrowed++;
+      continue;
+    }
+
+    serialno = ogg_page_serialno (&og);
+    granulepos = ogg_page_granulepos (&og);
+    unit = oggz_get_unit (oggz, serialno, granulepos);
+
+    oggz_seek_landmark_add (oggz, offset_page, serialno, granulepos);
+
+    if (unit <= unit_target) {
+      *offset_begin = offset_page;
+      *unit_begin = unit;
+    } else {
+      *offset_end = offset_page;
+      *unit_end = unit;
+    }
+    narrowed++;
+  }
+
+#ifdef DEBUG
+  printf ("oggz_seek_probe_sections: %d of %d probes narrowed to [@%" PRI_OGGZ_OFF_T "d - @%" PRI_OGGZ_OFF_T "d]\n",
+          narrowed, k, *offset_begin, *offset_end);
+#endif
+
+  oggz_free (data);
+  oggz_free (probes);
+
+  return narrowed;
+}
+
 static oggz_off_t
 oggz_offset_end (OGGZ * oggz)
 {
@@ -608,6 +1169,8 @@ oggz_offset_end (OGGZ * oggz)
     }
   }
 
+  if (offset_end != -1) oggz_seek_landmarks_check (oggz, offset_end);
+
   return offset_end;
 }
 
@@ -619,12 +1182,13 @@ oggz_bounded_seek_set (OGGZ * oggz,
 {
   OggzReader * reader;
   oggz_off_t offset_orig, offset_at, offset_guess;
-  oggz_off_t offset_next;
+  oggz_off_t offset_next, width_0;
   ogg_int64_t granule_at;
-  ogg_int64_t unit_at, unit_begin = -1, unit_end = -1, unit_last_iter = -1;
+  ogg_int64_t unit_at, unit_begin = -1, unit_end = -1;
   long serialno;
   ogg_page * og;
-  int hit_eof = 0;
+  int found, probes_max, probes;
+  int skip_headers = 0;
 
   if (oggz == NULL) {
     return -1;
@@ -659,6 +1223,34 @@ oggz_bounded_seek_set (OGGZ * oggz,
     return 0;
   }
 
+  /* Go straight to the page if this part of the file is indexed */
+  found = oggz_index_find (oggz, unit_target, offset_begin, offset_end,
+                           &offset_at, &unit_at);
+  if (found == -1) return -1;
+
+  /* Otherwise go to the keypoint given by a Skeleton index */
+  if (found == 0) {
+    found = oggz_index_find_keypoint (oggz, unit_target, offset_begin,
+                                      offset_end, &offset_at, &unit_at);
+  }
+
+  if (found == 1) {
+    /* Never land on the headers before the start of the data */
+    if (offset_at < oggz->offset_data_begin) {
+      offset_at = oggz->offset_data_begin;
+      unit_at = 0;
+    }
+
+    offset_at = oggz_reset (oggz, offset_at, unit_at, SEEK_SET);
+    if (offset_at == -1) return -1;
+
+#ifdef DEBUG
+    printf ("oggz_bounded_seek_set: INDEXED (%lld)\n", unit_at);
+#endif
+
+    return (long)reader->current_unit;
+  }
+
   offset_at = oggz_tell_raw (oggz);
   if (offset_at == -1) return -1;
 
@@ -668,23 +1260,41 @@ oggz_bounded_seek_set (OGGZ * oggz,
 
   og = &oggz->current_page;
 
-  if (unit_end == -1 && oggz_seek_raw (oggz, offset_end, SEEK_SET) >= 0) {
-    ogg_int64_t granulepos;
+  if (unit_end == -1) {
+    oggz_seek_unit_end (oggz, offset_end, &unit_end);
+  }
 
-    if (oggz_get_prev_start_page (oggz, og, &granulepos, &serialno) >= 0) {
-      unit_end = oggz_get_unit (oggz, serialno, granulepos);
-    }
+  /* Headers before the start of the data carry no timing information */
+  if (offset_begin < oggz->offset_data_begin &&
+      oggz->offset_data_begin < offset_end) {
+    offset_begin = oggz->offset_data_begin;
+    skip_headers = 1;
   }
 
-  if (unit_begin == -1 && oggz_seek_raw (oggz, offset_begin, SEEK_SET) >= 0) {
+  /* Start from the landmarks either side of the target, if known */
+  oggz_seek_landmarks_bracket (oggz, unit_target, &offset_begin, &unit_begin,
+                               &offset_end, &unit_end);
+
+  if (unit_begin == -1 && !oggz_seek_landmark_unit (oggz, offset_begin,
+                                                    &unit_begin) &&
+      oggz_seek_raw (oggz, offset_begin, SEEK_SET) >= 0) {
     ogg_int64_t granulepos;
     if (oggz_get_next_start_page (oggz, og) >= 0) {
       serialno = ogg_page_serialno (og);
       granulepos = ogg_page_granulepos (og);
       unit_begin = oggz_get_unit (oggz, serialno, granulepos);
+      oggz_seek_landmark_add (oggz, offset_begin, serialno, granulepos);
     }
   }
 
+  /* A target within the first page of data is reached from its start */
+  if (skip_headers && unit_target < unit_begin &&
+      offset_begin == oggz->offset_data_begin) {
+    offset_at = oggz_reset (oggz, oggz->offset_data_begin, 0, SEEK_SET);
+    if (offset_at == -1) return -1;
+    return 0;
+  }
+
   /* Fail if target isn't in specified range. */
   if (unit_target < unit_begin || unit_target > unit_end)
     return -1;
@@ -702,67 +1312,63 @@ oggz_bounded_seek_set (OGGZ * oggz,
 
   og = &oggz->current_page;
 
-  for ( ; ; ) {
+  /* Narrow the bracket: the first page carrying a granulepos at or after
+   * offset_begin is before the target, and that at or after offset_end
+   * is past it (or offset_end is the end of the range) */
+  if (reader->seek_nr_probes > 1) {
+    while (offset_end - offset_begin > 2 * GUESS_EPSILON &&
+           oggz_seek_probe_sections (oggz, unit_target,
+                                     &offset_begin, &unit_begin,
+                                     &offset_end, &unit_end) > 0);
+  }
 
-    unit_last_iter = unit_at;
-    hit_eof = 0;
+  width_0 = offset_end - offset_begin;
+  probes_max = oggz_seek_max_probes (width_0);
+
+  for (probes = 0; offset_end - offset_begin > 2 * GUESS_EPSILON; probes++) {
 
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: [A] want u%lld: (u%lld - u%lld) [@%" PRI_OGGZ_OFF_T "d - @%" PRI_OGGZ_OFF_T "d]\n",
 	    unit_target, unit_begin, unit_end, offset_begin, offset_end);
 #endif
 
-    offset_guess = oggz_seek_guess (unit_at, unit_target,
-				    unit_begin, unit_end,
-				    offset_at,
-				    offset_begin, offset_end);
-    if (offset_guess == -1) break;
+    offset_guess = oggz_seek_guess (unit_target, unit_begin, unit_end,
+				    offset_begin, offset_end,
+				    width_0, probes_max - probes);
 
-    if (offset_guess == offset_at) {
-      /* Already there, looping */
-      break;
-    }
+    offset_next = oggz_seek_next_start_page_at (oggz, offset_guess,
+                                                &serialno, &granule_at);
+    if (offset_next == -1) break;
 
-    if (offset_guess > offset_end) {
-      offset_guess = offset_end;
-      offset_at = oggz_seek_raw (oggz, offset_guess, SEEK_SET);
-      offset_next = oggz_get_prev_start_page (oggz, og, &granule_at, &serialno);
-    } else {
-      offset_at = oggz_seek_raw (oggz, offset_guess, SEEK_SET);
-      offset_next = oggz_get_next_start_page (oggz, og);
-      serialno = ogg_page_serialno (og);
-      granule_at = ogg_page_granulepos (og);
+    if (offset_next < 0 || offset_next >= offset_end) {
+      /* No page starts between the guess and the end of the bracket */
+      offset_end = offset_guess;
+      continue;
     }
 
     unit_at = oggz_get_unit (oggz, serialno, granule_at);
 
-#ifdef DEBUG
-    printf ("oggz_bounded_seek_set: offset_next %" PRI_OGGZ_OFF_T "d\n", offset_next);
-#endif
-    if (unit_at == unit_last_iter) break;
+    oggz_seek_landmark_add (oggz, offset_next, serialno, granule_at);
 
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: [D] want u%lld, got page u%lld @%" PRI_OGGZ_OFF_T "d g%lld\n",
-	    unit_target, unit_at, offset_at, granule_at);
+	    unit_target, unit_at, offset_next, granule_at);
 #endif
 
-    if (unit_at < unit_target) {
-      offset_begin = offset_at;
+    if (unit_at <= unit_target) {
+      offset_begin = offset_next;
       unit_begin = unit_at;
-      if (unit_end == unit_begin) break;
-    } else if (unit_at > unit_target) {
-      offset_end = offset_at-1;
-      unit_end = unit_at;
-      if (unit_end == unit_begin) break;
     } else {
-      break;
+      offset_end = offset_next;
+      unit_end = unit_at;
     }
   }
 
-  do {
-    offset_at = oggz_get_prev_start_page (oggz, og, &granule_at, &serialno);
-    unit_at = oggz_get_unit (oggz, serialno, granule_at);
-  } while (unit_at > unit_target);
+  /* Find the last page at or before the target, reading back from the
+   * end of the bracket */
+  offset_at = oggz_get_prev_start_page (oggz, offset_end, og, unit_target,
+                                       &granule_at, &serialno);
+  unit_at = oggz_get_unit (oggz, serialno, granule_at);
 
   if (offset_at < 0) {
     oggz_reset (oggz, offset_orig, -1, SEEK_SET);
@@ -782,34 +1388,28 @@ oggz_bounded_seek_set (OGGZ * oggz,
 static ogg_int64_t
 oggz_seek_end (OGGZ * oggz, ogg_int64_t unit_offset)
 {
-  oggz_off_t offset_orig, offset_at, offset_end;
-  ogg_int64_t granulepos;
+  oggz_off_t offset_orig, offset_end;
   ogg_int64_t unit_end;
-  long serialno;
-  ogg_page * og;
-
-  og = &oggz->current_page;
 
-  offset_orig = oggz->offset;
+  if ((offset_end = oggz_offset_end (oggz)) == -1) return -1;
 
-  offset_at = oggz_seek_raw (oggz, 0, SEEK_END);
-  if (offset_at == -1) return -1;
+  if (oggz_index_last_unit (oggz, offset_end, &unit_end)) {
+    return oggz_bounded_seek_set (oggz, unit_end + unit_offset, 0, offset_end);
+  }
 
-  offset_end = oggz_get_prev_start_page (oggz, og, &granulepos, &serialno);
+  offset_orig = oggz->offset;
 
-  if (offset_end < 0) {
+  if (oggz_seek_unit_end (oggz, offset_end, &unit_end) == -1) {
     oggz_reset (oggz, offset_orig, -1, SEEK_SET);
     return -1;
   }
 
-  unit_end = oggz_get_unit (oggz, serialno, granulepos);
-
 #ifdef DEBUG
-  printf ("*** oggz_seek_end: found packet (%lld) at @%" PRI_OGGZ_OFF_T "d [%lld]\n",
-	  unit_end, offset_end, granulepos);
+  printf ("*** oggz_seek_end: found packet (%lld) before @%" PRI_OGGZ_OFF_T "d\n",
+	  unit_end, offset_end);
 #endif
 
-  return oggz_bounded_seek_set (oggz, unit_end + unit_offset, 0, -1);
+  return oggz_bounded_seek_set (oggz, unit_end + unit_offset, 0, offset_end);
 }
 
 off_t
@@ -840,6 +1440,8 @@ ogg_int64_t
 oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence)
 {
   OggzReader * reader;
+  long probes;
+  ogg_int64_t bytes_read;
 
   ogg_int64_t r;
 
@@ -866,6 +1468,9 @@ oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence)
 
   reader = &oggz->x.reader;
 
+  probes = reader->seek_probes;
+  bytes_read = reader->seek_bytes_read;
+
   switch (whence) {
   case SEEK_SET:
     r = oggz_bounded_seek_set (oggz, units, 0, -1);
@@ -884,9 +1489,344 @@ oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence)
   }
 
   reader->current_granulepos = -1;
+
+  reader->seeks++;
+  reader->seek_last_probes = reader->seek_probes - probes;
+  reader->seek_last_bytes_read = reader->seek_bytes_read - bytes_read;
+
   return r;
 }
 
+/*
+ * Keyframe seeking uses the "double seek" method: seek to the target,
+ * then read forward to the next granulepos of each stream which needs
+ * earlier data to decode at the target, and seek again to the earliest
+ * of these.
+ */
+
+/* Scan state of a stream during oggz_seek_keyframe() */
+#define KEYFRAME_IGNORE -3
+#define KEYFRAME_DONE -2
+#define KEYFRAME_PENDING -1
+
+/*
+ * oggz_seek_keyframe_unit (oggz, stream, serialno, granulepos)
+ *
+ * Find the unit of the keyframe on which the frame with the given
+ * granulepos depends.
+ */
+static ogg_int64_t
+oggz_seek_keyframe_unit (OGGZ * oggz, oggz_stream_t * stream, long serialno,
+                         ogg_int64_t granulepos)
+{
+  ogg_int64_t iframe, dist, unit;
+
+  switch (stream->content) {
+  case OGGZ_CONTENT_VP8:
+    /* The frame number is in the top 32 bits, and the distance back to
+     * the keyframe in bits 3-29 */
+    iframe = granulepos >> 32;
+    dist = (granulepos >> 3) & 0x07ffffff;
+    return oggz_get_unit (oggz, serialno, (iframe - dist) << 32);
+  case OGGZ_CONTENT_DIRAC:
+    /* The distance back to the last sync point is split across the two
+     * halves of the granulepos, and counts pictures where the metric
+     * counts fields */
+    iframe = granulepos >> stream->granuleshift;
+    dist = ((iframe & 0xff) << 8) | (granulepos & 0xff);
+    unit = oggz_get_unit (oggz, serialno, granulepos);
+    if (unit < 0) return unit;
+    unit -= 2 * dist * stream->granulerate_d / stream->granulerate_n;
+    return (unit < 0) ? 0 : unit;
+  default:
+    iframe = granulepos >> stream->granuleshift;
+    return oggz_get_unit (oggz, serialno, iframe << stream->granuleshift);
+  }
+}
+
+/*
+ * oggz_seek_keyframe_scan (oggz, unit_target, unit_start)
+ *
+ * Read forward from the current position to the next page with a
+ * granulepos of each stream which has a granuleshift or a preroll,
+ * lowering *unit_start to the unit at which decoding of that stream
+ * must begin in order to present unit_target.
+ * Returns 1 if a stream's next page already starts a keyframe later
+ * than unit_target, so that the scan must begin earlier; 0 if not; or
+ * -1 on error.
+ */
+static int
+oggz_seek_keyframe_scan (OGGZ * oggz, ogg_int64_t unit_target,
+                         ogg_int64_t * unit_start)
+{
+  oggz_stream_t * stream;
+  ogg_page * og;
+  ogg_int64_t * state;
+  ogg_int64_t unit_key, granulepos;
+  long serialno;
+  int i, nr_streams, pending = 0, packets, late = 0;
+
+  nr_streams = oggz_vector_size (oggz->streams);
+  if (nr_streams == 0) return 0;
+
+  state = oggz_malloc (nr_streams * sizeof (ogg_int64_t));
+  if (state == NULL) return -1;
+
+  for (i = 0; i < nr_streams; i++) {
+    stream = (oggz_stream_t *) oggz_vector_nth_p (oggz->streams, i);
+    if (stream->granuleshift > 0 || stream->preroll > 0) {
+      state[i] = KEYFRAME_PENDING;
+      pending++;
+    } else {
+      state[i] = KEYFRAME_IGNORE;
+    }
+  }
+
+  og = &oggz->current_page;
+
+  while (pending > 0 && oggz_get_next_start_page (oggz, og) >= 0) {
+    serialno = ogg_page_serialno (og);
+    granulepos = ogg_page_granulepos (og);
+
+    for (i = 0; i < nr_streams; i++) {
+      stream = (oggz_stream_t *) oggz_vector_nth_p (oggz->streams, i);
+      if (stream->ogg_stream.serialno == serialno) break;
+    }
+    if (i == nr_streams || state[i] == KEYFRAME_IGNORE ||
+        state[i] == KEYFRAME_DONE)
+      continue;
+
+    if (stream->granuleshift > 0) {
+      /* Every frame on this page depends on the same keyframe, unless
+       * that keyframe is itself after the target */
+      unit_key = oggz_seek_keyframe_unit (oggz, stream, serialno, granulepos);
+      if (unit_key > unit_target) late = 1;
+      else if (unit_key >= 0 && unit_key < *unit_start) *unit_start = unit_key;
+      state[i] = KEYFRAME_DONE;
+      pending--;
+    } else if (state[i] == KEYFRAME_PENDING) {
+      /* Remember the unit of the first page, to measure the duration of
+       * the packets on the next one */
+      state[i] = oggz_get_unit (oggz, serialno, granulepos);
+      if (state[i] < 0) {
+        state[i] = KEYFRAME_DONE;
+        pending--;
+      }
+    } else {
+      /* Back off by the preroll, counted in packets of the duration
+       * of those on this page */
+      packets = ogg_page_packets (og);
+      unit_key = oggz_get_unit (oggz, serialno, granulepos);
+      if (packets > 0 && unit_key > state[i]) {
+        unit_key = unit_target -
+          (unit_key - state[i]) * stream->preroll / packets;
+        if (unit_key < *unit_start) *unit_start = unit_key;
+      }
+      state[i] = KEYFRAME_DONE;
+      pending--;
+    }
+  }
+
+  oggz_free (state);
+
+  return late;
+}
+
+ogg_int64_t
+oggz_seek_keyframe (OGGZ * oggz, ogg_int64_t unit_target)
+{
+  OggzReader * reader;
+  ogg_int64_t unit_at, unit_seek, unit_start;
+  oggz_off_t offset_at;
+  int late;
+
+  if (oggz == NULL) return -1;
+
+  if (oggz->flags & OGGZ_WRITE) return -1;
+
+  reader = &oggz->x.reader;
+
+  /* If the first seek lands beyond the last page of a stream before the
+   * target, step back until it does not */
+  unit_seek = unit_target;
+  do {
+    unit_at = oggz_seek_units (oggz, unit_seek, SEEK_SET);
+    if (unit_at < 0) return unit_at;
+
+    offset_at = oggz->offset;
+    unit_start = unit_target;
+
+    late = oggz_seek_keyframe_scan (oggz, unit_target, &unit_start);
+    if (late == -1) return -1;
+
+    unit_seek = unit_at - 1;
+  } while (late && unit_seek >= 0);
+
+  if (unit_start < 0) unit_start = 0;
+
+  if (unit_start >= unit_at) {
+    /* The first seek landed early enough */
+    if (oggz_reset (oggz, offset_at, unit_at, SEEK_SET) == -1) return -1;
+    reader->current_granulepos = -1;
+    return unit_at;
+  }
+
+  /* Seek strictly before unit_start, so as not to land on the page on
+   * which the keyframe finishes if that keyframe began on an earlier page */
+  if (unit_start > 0) unit_start--;
+
+  return oggz_seek_units (oggz, unit_start, SEEK_SET);
+}
+
+void
+oggz_seek_set_presentation_time (OGGZ * oggz, ogg_int64_t numerator,
+                                 ogg_int64_t denominator)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (oggz->flags & OGGZ_WRITE) return;
+
+  if (denominator == 0) return;
+
+  reader->presentation_time = OGGZ_AUTO_MULT * numerator / denominator;
+}
+
+typedef struct {
+  int * seen; /* whether the last page of each stream has been found */
+  int pending;
+  ogg_int64_t unit_end;
+} OggzDuration;
+
+static int
+oggz_duration_page (OGGZ * oggz, oggz_off_t offset, ogg_page * og,
+                    void * user_data)
+{
+  OggzDuration * duration = (OggzDuration *) user_data;
+  oggz_stream_t * stream;
+  ogg_int64_t unit_at;
+  long serialno;
+  int i, nr_streams;
+
+  serialno = ogg_page_serialno (og);
+
+  nr_streams = oggz_vector_size (oggz->streams);
+  for (i = 0; i < nr_streams; i++) {
+    stream = (oggz_stream_t *) oggz_vector_nth_p (oggz->streams, i);
+    if (stream->ogg_stream.serialno == serialno) break;
+  }
+
+  if (i < nr_streams && !duration->seen[i]) {
+    unit_at = oggz_get_unit (oggz, serialno, ogg_page_granulepos (og));
+    if (unit_at > duration->unit_end) duration->unit_end = unit_at;
+    duration->seen[i] = 1;
+    duration->pending--;
+  }
+
+  return (duration->pending == 0 || offset <= oggz->offset_data_begin);
+}
+
+ogg_int64_t
+oggz_get_duration (OGGZ * oggz)
+{
+  OggzReader * reader;
+  oggz_stream_t * stream;
+  OggzDuration duration;
+  oggz_off_t offset_orig, offset_end;
+  ogg_int64_t unit_orig;
+  int i, nr_streams;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (!oggz_has_metrics (oggz)) return OGGZ_ERR_INVALID;
+
+  reader = &oggz->x.reader;
+
+  if ((offset_end = oggz_offset_end (oggz)) == -1) return OGGZ_ERR_NOSEEK;
+
+  nr_streams = oggz_vector_size (oggz->streams);
+  if (nr_streams == 0) return 0;
+
+  duration.seen = oggz_malloc (nr_streams * sizeof (int));
+  if (duration.seen == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  duration.pending = 0;
+  duration.unit_end = 0;
+
+  /* Streams whose metric is always zero, like Skeleton, end within the
+   * headers and need not be looked for */
+  for (i = 0; i < nr_streams; i++) {
+    stream = (oggz_stream_t *) oggz_vector_nth_p (oggz->streams, i);
+    duration.seen[i] = (stream->metric_internal && stream->granulerate_d == 0);
+    if (!duration.seen[i]) duration.pending++;
+  }
+
+  offset_orig = oggz->offset;
+  unit_orig = reader->current_unit;
+
+  /* Read back from the end of the file to the last page of each stream */
+  if (duration.pending > 0 &&
+      oggz_scan_back (oggz, offset_end, oggz_duration_page, &duration) == -1)
+    duration.unit_end = OGGZ_ERR_SYSTEM;
+
+  oggz_free (duration.seen);
+
+  if (oggz_reset (oggz, offset_orig, unit_orig, SEEK_SET) == -1)
+    return OGGZ_ERR_SYSTEM;
+
+  if (duration.unit_end < 0) return duration.unit_end;
+
+  duration.unit_end -= reader->presentation_time;
+
+  return (duration.unit_end < 0) ? 0 : duration.unit_end;
+}
+
+int
+oggz_seek_get_stats (OGGZ * oggz, OggzSeekStats * stats)
+{
+  OggzReader * reader;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  reader = &oggz->x.reader;
+
+  stats->seeks = reader->seeks;
+  stats->probes = reader->seek_probes;
+  stats->bytes_read = reader->seek_bytes_read;
+  stats->last_probes = reader->seek_last_probes;
+  stats->last_bytes_read = reader->seek_last_bytes_read;
+
+  return 0;
+}
+
+int
+oggz_seek_set_probes (OGGZ * oggz, int nr_probes)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (nr_probes < 1 || nr_probes > OGGZ_SEEK_PROBES_MAX) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  oggz->x.reader.seek_nr_probes = nr_probes;
+
+  /* Threads for the reads are started once, not on every seek */
+  oggz_io_pool_open (oggz, nr_probes);
+
+  return 0;
+}
+
 long
 oggz_seek_byorder (OGGZ * oggz, void * target)
 {
@@ -904,6 +1844,8 @@ oggz_seek_packets (OGGZ * oggz, long serialno, long packets, int whence)
 #include <ogg/ogg.h>
 #include "oggz_private.h"
 
+#include "oggz/oggz_seek.h"
+
 off_t
 oggz_seek (OGGZ * oggz, oggz_off_t offset, int whence)
 {
@@ -916,6 +1858,30 @@ oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence)
   return OGGZ_ERR_DISABLED;
 }
 
+ogg_int64_t
+oggz_seek_keyframe (OGGZ * oggz, ogg_int64_t unit_target)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+ogg_int64_t
+oggz_get_duration (OGGZ * oggz)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_seek_get_stats (OGGZ * oggz, OggzSeekStats * stats)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_seek_set_probes (OGGZ * oggz, int nr_probes)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_seek_byorder (OGGZ * oggz, void * target)
 {
@@ -928,4 +1894,10 @@ oggz_seek_packets (OGGZ * oggz, long serialno, long packets, int whence)
   return OGGZ_ERR_DISABLED;
 }
 
+void
+oggz_seek_set_presentation_time (OGGZ * oggz, ogg_int64_t numerator,
+                                 ogg_int64_t denominator)
+{
+}
+
 #endif
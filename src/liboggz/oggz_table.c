@@ -33,16 +33,53 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <ogg/ogg.h>
+
 #include "oggz_macros.h"
-#include "oggz_vector.h"
+
+/*
+ * Entries are stored in insertion order in a dense array, which gives
+ * oggz_table_nth() its ordering. They are indexed by key in an open
+ * addressed (linear probing) hash table of entry numbers, which is kept
+ * at most half full.
+ *
+ * Removal only marks an entry as deleted; deleted entries are squeezed
+ * out of the array, and the index rebuilt, the next time the array
+ * needs to grow or oggz_table_nth() is called.
+ */
 
 typedef struct _OggzTable OggzTable;
 
+typedef struct {
+  long key;
+  void * data;
+  int deleted;
+} OggzTableEntry;
+
 struct _OggzTable {
-  OggzVector * keys;
-  OggzVector * data;
+  OggzTableEntry * entries;
+  int nr_entries; /* entries used, including deleted ones */
+  int max_entries; /* entries allocated */
+  int nr_deleted;
+
+  int * index; /* entry number + 1, or 0 for an empty slot */
+  int index_size; /* always a power of two */
 };
 
+#define OGGZ_TABLE_MIN_ENTRIES 8
+
+#define INDEX_EMPTY 0
+
+static unsigned int
+oggz_table_hash (long key, int size)
+{
+  ogg_uint32_t h = (ogg_uint32_t)key * 0x9e3779b1UL;
+
+  return (unsigned int)(h ^ (h >> 16)) & (size - 1);
+}
+
 OggzTable *
 oggz_table_new (void)
 {
@@ -51,8 +88,13 @@ oggz_table_new (void)
   table = oggz_malloc (sizeof (OggzTable));
   if (table == NULL) return NULL;
 
-  table->keys = oggz_vector_new ();
-  table->data = oggz_vector_new ();
+  table->entries = NULL;
+  table->nr_entries = 0;
+  table->max_entries = 0;
+  table->nr_deleted = 0;
+
+  table->index = NULL;
+  table->index_size = 0;
 
   return table;
 }
@@ -62,73 +104,168 @@ oggz_table_delete (OggzTable * table)
 {
   if (table == NULL) return;
 
-  oggz_vector_delete (table->keys);
-  oggz_vector_delete (table->data);
+  oggz_free (table->entries);
+  oggz_free (table->index);
   oggz_free (table);
 }
 
-void *
-oggz_table_lookup (OggzTable * table, long key)
+/*
+ * Find the index slot for key: either the slot referring to its entry,
+ * or the empty slot at which it would be inserted.
+ */
+static unsigned int
+oggz_table_find_slot (OggzTable * table, long key)
 {
-  int i, size;
+  unsigned int i;
+  int n;
 
-  if (table == NULL) return NULL;
+  i = oggz_table_hash (key, table->index_size);
+  while ((n = table->index[i]) != INDEX_EMPTY) {
+    if (table->entries[n-1].key == key) break;
+    i = (i + 1) & (table->index_size - 1);
+  }
+
+  return i;
+}
+
+/*
+ * Squeeze out deleted entries and rebuild the index, first enlarging
+ * the table if needed to make room for extra more entries.
+ */
+static int
+oggz_table_rebuild (OggzTable * table, int extra)
+{
+  OggzTableEntry * new_entries;
+  int * new_index;
+  int i, j, new_max, ret = 0;
+
+  for (i = 0, j = 0; i < table->nr_entries; i++) {
+    if (!table->entries[i].deleted) {
+      if (i != j) table->entries[j] = table->entries[i];
+      j++;
+    }
+  }
+  table->nr_entries = j;
+  table->nr_deleted = 0;
+
+  if (table->nr_entries + extra > table->max_entries) {
+    new_max = MAX (OGGZ_TABLE_MIN_ENTRIES, table->max_entries);
+    while (new_max < table->nr_entries + extra) new_max *= 2;
+
+    new_entries = oggz_realloc (table->entries,
+                                new_max * sizeof (OggzTableEntry));
+    new_index = NULL;
+    if (new_entries != NULL) {
+      table->entries = new_entries;
+      new_index = oggz_realloc (table->index, 2 * new_max * sizeof (int));
+    }
+
+    if (new_index == NULL) {
+      /* Keep the old index, which still has room for all entries */
+      ret = -1;
+    } else {
+      table->index = new_index;
+      table->index_size = 2 * new_max;
+      table->max_entries = new_max;
+    }
+  }
 
-  size = oggz_vector_size (table->keys);
-  for (i = 0; i < size; i++) {
-    if (oggz_vector_nth_l (table->keys, i) == key) {
-      return oggz_vector_nth_p (table->data, i);
+  if (table->index != NULL) {
+    memset (table->index, 0, table->index_size * sizeof (int));
+
+    for (i = 0; i < table->nr_entries; i++) {
+      j = oggz_table_find_slot (table, table->entries[i].key);
+      table->index[j] = i + 1;
     }
   }
 
-  return NULL;
+  return ret;
+}
+
+void *
+oggz_table_lookup (OggzTable * table, long key)
+{
+  int n;
+
+  if (table == NULL || table->index == NULL) return NULL;
+
+  n = table->index[oggz_table_find_slot (table, key)];
+  if (n == INDEX_EMPTY) return NULL;
+
+  return table->entries[n-1].data;
 }
 
 void *
 oggz_table_insert (OggzTable * table, long key, void * data)
 {
-  void * old_data;
+  OggzTableEntry * entry;
+  unsigned int i;
+  int n;
 
-  if ((old_data = oggz_table_lookup (table, key)) != NULL) {
-    if (oggz_vector_remove_l (table->keys, key) == NULL)
-      return NULL;
+  if (table == NULL) return NULL;
 
-    if (oggz_vector_remove_p (table->data, old_data) == NULL) {
-      /* XXX: This error condition can only happen if the previous
-       * removal succeeded, and this removal failed, ie. there was
-       * an error reallocing table->data->data downwards. */
-      return NULL;
+  if (table->index != NULL) {
+    i = oggz_table_find_slot (table, key);
+    if ((n = table->index[i]) != INDEX_EMPTY) {
+      /* Replace the existing element, keeping its position */
+      table->entries[n-1].data = data;
+      return data;
     }
   }
 
-  if (oggz_vector_insert_l (table->keys, key) == -1)
-    return NULL;
-  
-  if (oggz_vector_insert_p (table->data, data) == NULL) {
-    oggz_vector_remove_l (table->keys, key);
-    return NULL;
+  if (table->nr_entries == table->max_entries) {
+    if (oggz_table_rebuild (table, 1) == -1 &&
+        table->nr_entries == table->max_entries)
+      return NULL;
   }
 
+  i = oggz_table_find_slot (table, key);
+
+  entry = &table->entries[table->nr_entries];
+  entry->key = key;
+  entry->data = data;
+  entry->deleted = 0;
+
+  table->nr_entries++;
+  table->index[i] = table->nr_entries;
+
   return data;
 }
 
 int
 oggz_table_remove (OggzTable * table, long key)
 {
-  void * old_data;
+  unsigned int i, j, k;
+  int n;
 
-  if ((old_data = oggz_table_lookup (table, key)) != NULL) {
-    if (oggz_vector_remove_l (table->keys, key) == NULL)
-      return -1;
+  if (table == NULL || table->index == NULL) return -1;
 
-    if (oggz_vector_remove_p (table->data, old_data) == NULL) {
-      /* XXX: This error condition can only happen if the previous
-       * removal succeeded, and this removal failed, ie. there was
-       * an error reallocing table->data->data downwards. */
-      return -1;
-    }
+  i = oggz_table_find_slot (table, key);
+  if ((n = table->index[i]) == INDEX_EMPTY) return -1;
+
+  table->entries[n-1].deleted = 1;
+  table->nr_deleted++;
+
+  /* Remove the index slot, moving back any following slots which
+   * would otherwise become unreachable */
+  table->index[i] = INDEX_EMPTY;
+  j = i;
+  for (;;) {
+    j = (j + 1) & (table->index_size - 1);
+    if ((n = table->index[j]) == INDEX_EMPTY) break;
+
+    k = oggz_table_hash (table->entries[n-1].key, table->index_size);
+
+    /* Move the slot at j to the gap at i unless its home slot k lies
+     * cyclically in (i, j] */
+    if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+
+    table->index[i] = n;
+    table->index[j] = INDEX_EMPTY;
+    i = j;
   }
-  
+
   return 0;
 }
 
@@ -136,13 +273,21 @@ int
 oggz_table_size (OggzTable * table)
 {
   if (table == NULL) return 0;
-  return oggz_vector_size (table->data);
+  return table->nr_entries - table->nr_deleted;
 }
 
 void *
 oggz_table_nth (OggzTable * table, int n, long * key)
 {
   if (table == NULL) return NULL;
-  if (key) *key = oggz_vector_nth_l (table->keys, n);
-  return oggz_vector_nth_p (table->data, n);
+
+  if (table->nr_deleted > 0) {
+    if (oggz_table_rebuild (table, 0) == -1)
+      return NULL;
+  }
+
+  if (n < 0 || n >= table->nr_entries) return NULL;
+
+  if (key) *key = table->entries[n].key;
+  return table->entries[n].data;
 }
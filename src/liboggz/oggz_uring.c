@@ -0,0 +1,617 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_uring.c
+ *
+ * Linux io_uring backend for OGGZ handles opened on regular files. All
+ * reads are positional, against an offset tracked here, so seeking and
+ * telling need no system calls at all. A read straight after a seek (as
+ * made by each probe of the seek engine) is submitted on its own, into
+ * the caller's buffer. Once reading continues sequentially, up to
+ * queue-depth reads are kept in flight ahead of the reader.
+ *
+ * The ring is driven with the raw system calls, so no liburing is
+ * needed.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#if OGGZ_CONFIG_READ && defined(HAVE_LINUX_IO_URING_H) && \
+    defined(HAVE_SYS_MMAN_H) && defined(__NR_io_uring_setup)
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "oggz_compat.h"
+#include "oggz_private.h"
+
+/*#define DEBUG*/
+
+#define OGGZ_URING_BUFSIZE 65536
+
+/* user_data of a read submitted directly into the caller's buffer */
+#define OGGZ_URING_DIRECT (~(__u64)0)
+
+/* user_data flag of a read made by oggz_uring_read_multi(), whose low
+ * bits index its probe */
+#define OGGZ_URING_PROBE ((__u64)1 << 62)
+
+typedef struct {
+  unsigned char * data;
+  struct iovec iov;
+  oggz_off_t offset; /* file offset of data */
+  long len; /* bytes read, or negative errno */
+  int done; /* read has completed */
+} OggzUringBuffer;
+
+struct _OggzUring {
+  int ring_fd;
+  int fd;
+
+  /* Submission queue */
+  void * sq_ptr;
+  size_t sq_len;
+  unsigned * sq_head, * sq_tail, * sq_mask, * sq_array;
+  struct io_uring_sqe * sqes;
+  size_t sqes_len;
+  unsigned to_submit;
+
+  /* Completion queue */
+  void * cq_ptr;
+  size_t cq_len;
+  unsigned * cq_head, * cq_tail, * cq_mask;
+  struct io_uring_cqe * cqes;
+
+  OggzUringBuffer * buffers;
+  int depth;
+  int head; /* oldest buffer in flight or completed */
+  int count; /* number of buffers in flight or completed */
+  long consumed; /* bytes of buffers[head] already returned */
+  int inflight; /* reads submitted but not yet reaped */
+
+  struct iovec direct_iov;
+  long direct_res;
+  int direct_done;
+
+  OggzIOProbe * probes; /* reads of oggz_uring_read_multi() in flight */
+  struct iovec * probe_iovs;
+  int probes_pending;
+
+  oggz_off_t offset; /* offset of the next byte to be returned */
+  oggz_off_t next; /* offset of the next read-ahead to submit */
+  int sequential; /* last operation was a read, not a seek */
+};
+
+static int
+oggz_uring_sys_enter (OggzUring * ur, unsigned min_complete)
+{
+  int ret;
+
+  do {
+    ret = (int) syscall (__NR_io_uring_enter, ur->ring_fd, ur->to_submit,
+                         min_complete,
+                         min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                         NULL, 0);
+  } while (ret == -1 && errno == EINTR);
+
+  if (ret < 0) return -1;
+
+  ur->to_submit -= MIN ((unsigned)ret, ur->to_submit);
+
+  return 0;
+}
+
+static void
+oggz_uring_queue_read (OggzUring * ur, struct iovec * iov, oggz_off_t offset,
+                       __u64 user_data)
+{
+  struct io_uring_sqe * sqe;
+  unsigned tail, index;
+
+  tail = *ur->sq_tail;
+  index = tail & *ur->sq_mask;
+
+  sqe = &ur->sqes[index];
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = ur->fd;
+  sqe->addr = (unsigned long) iov;
+  sqe->len = 1;
+  sqe->off = (__u64) offset;
+  sqe->user_data = user_data;
+
+  ur->sq_array[index] = index;
+  __atomic_store_n (ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  ur->to_submit++;
+  ur->inflight++;
+}
+
+static void
+oggz_uring_reap (OggzUring * ur)
+{
+  struct io_uring_cqe * cqe;
+  OggzUringBuffer * buffer;
+  unsigned head, tail;
+
+  head = *ur->cq_head;
+  tail = __atomic_load_n (ur->cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    cqe = &ur->cqes[head & *ur->cq_mask];
+
+    if (cqe->user_data == OGGZ_URING_DIRECT) {
+      ur->direct_res = cqe->res;
+      ur->direct_done = 1;
+    } else if (cqe->user_data & OGGZ_URING_PROBE) {
+      ur->probes[cqe->user_data & ~OGGZ_URING_PROBE].len =
+        (cqe->res < 0) ? -1 : cqe->res;
+      ur->probes_pending--;
+    } else {
+      buffer = &ur->buffers[cqe->user_data];
+      buffer->len = cqe->res;
+      buffer->done = 1;
+    }
+
+    ur->inflight--;
+    head++;
+  }
+
+  __atomic_store_n (ur->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Submit anything queued and wait for at least one completion, unless
+ * done already holds.
+ */
+static int
+oggz_uring_wait (OggzUring * ur, int * done)
+{
+  while (!*done) {
+    if (oggz_uring_sys_enter (ur, 1) == -1) return -1;
+    oggz_uring_reap (ur);
+  }
+
+  return 0;
+}
+
+/* Wait for every outstanding read, and forget all read-ahead */
+static int
+oggz_uring_drain (OggzUring * ur)
+{
+  while (ur->inflight > 0) {
+    if (oggz_uring_sys_enter (ur, ur->inflight) == -1) return -1;
+    oggz_uring_reap (ur);
+  }
+
+  ur->head = 0;
+  ur->count = 0;
+  ur->consumed = 0;
+  ur->next = ur->offset;
+
+  return 0;
+}
+
+static void
+oggz_uring_unmap (OggzUring * ur)
+{
+  if (ur->sqes != NULL && ur->sqes != MAP_FAILED)
+    munmap (ur->sqes, ur->sqes_len);
+  if (ur->cq_ptr != NULL && ur->cq_ptr != MAP_FAILED && ur->cq_ptr != ur->sq_ptr)
+    munmap (ur->cq_ptr, ur->cq_len);
+  if (ur->sq_ptr != NULL && ur->sq_ptr != MAP_FAILED)
+    munmap (ur->sq_ptr, ur->sq_len);
+}
+
+static int
+oggz_uring_setup (OggzUring * ur, unsigned entries)
+{
+  struct io_uring_params p;
+  unsigned char * sq, * cq;
+
+  memset (&p, 0, sizeof (p));
+
+  ur->ring_fd = (int) syscall (__NR_io_uring_setup, entries, &p);
+  if (ur->ring_fd < 0) return -1;
+
+  ur->sq_len = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+  ur->cq_len = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ur->sq_len = ur->cq_len = MAX (ur->sq_len, ur->cq_len);
+  }
+
+  ur->sq_ptr = mmap (NULL, ur->sq_len, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, ur->ring_fd, IORING_OFF_SQ_RING);
+  if (ur->sq_ptr == MAP_FAILED) return -1;
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ur->cq_ptr = ur->sq_ptr;
+  } else {
+    ur->cq_ptr = mmap (NULL, ur->cq_len, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_POPULATE, ur->ring_fd,
+                       IORING_OFF_CQ_RING);
+    if (ur->cq_ptr == MAP_FAILED) return -1;
+  }
+
+  ur->sqes_len = p.sq_entries * sizeof (struct io_uring_sqe);
+  ur->sqes = mmap (NULL, ur->sqes_len, PROT_READ|PROT_WRITE,
+                   MAP_SHARED|MAP_POPULATE, ur->ring_fd, IORING_OFF_SQES);
+  if (ur->sqes == MAP_FAILED) return -1;
+
+  sq = (unsigned char *) ur->sq_ptr;
+  ur->sq_head = (unsigned *) (sq + p.sq_off.head);
+  ur->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+  ur->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+  ur->sq_array = (unsigned *) (sq + p.sq_off.array);
+
+  cq = (unsigned char *) ur->cq_ptr;
+  ur->cq_head = (unsigned *) (cq + p.cq_off.head);
+  ur->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+  ur->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+  ur->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+  return 0;
+}
+
+int
+oggz_uring_init (OGGZ * oggz, int depth)
+{
+  OggzUring * ur;
+  struct stat statbuf;
+  long offset;
+  int fd, i;
+
+  if (oggz->file == NULL) return OGGZ_ERR_INVALID;
+
+  if ((fd = fileno (oggz->file)) == -1) return OGGZ_ERR_INVALID;
+  if (fstat (fd, &statbuf) == -1) return OGGZ_ERR_SYSTEM;
+
+  /* Positional reads need a regular file */
+  if (!oggz_stat_regular (statbuf.st_mode)) return OGGZ_ERR_INVALID;
+
+  if ((offset = ftell (oggz->file)) == -1) return OGGZ_ERR_SYSTEM;
+
+  ur = (OggzUring *) oggz_malloc (sizeof (OggzUring));
+  if (ur == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  memset (ur, 0, sizeof (OggzUring));
+  ur->ring_fd = -1;
+
+  ur->buffers = (OggzUringBuffer *)
+    oggz_malloc (depth * sizeof (OggzUringBuffer));
+  if (ur->buffers == NULL) goto err_oom;
+
+  for (i = 0; i < depth; i++) {
+    ur->buffers[i].data = oggz_malloc (OGGZ_URING_BUFSIZE);
+    if (ur->buffers[i].data == NULL) {
+      while (--i >= 0) oggz_free (ur->buffers[i].data);
+      oggz_free (ur->buffers);
+      goto err_oom;
+    }
+  }
+
+  /* One more entry than the read-ahead depth, for a direct read */
+  if (oggz_uring_setup (ur, (unsigned)depth + 1) == -1) {
+    int ret = (errno == ENOSYS) ? OGGZ_ERR_DISABLED : OGGZ_ERR_SYSTEM;
+
+    oggz_uring_unmap (ur);
+    if (ur->ring_fd >= 0) close (ur->ring_fd);
+    for (i = 0; i < depth; i++) oggz_free (ur->buffers[i].data);
+    oggz_free (ur->buffers);
+    oggz_free (ur);
+    return ret;
+  }
+
+  ur->fd = fd;
+  ur->depth = depth;
+  ur->offset = ur->next = offset;
+
+  oggz->uring = ur;
+
+#ifdef DEBUG
+  printf ("oggz_uring_init: depth %d at offset %ld\n", depth, offset);
+#endif
+
+  return 0;
+
+ err_oom:
+  oggz_free (ur);
+  return OGGZ_ERR_OUT_OF_MEMORY;
+}
+
+int
+oggz_uring_close (OGGZ * oggz)
+{
+  OggzUring * ur = oggz->uring;
+  int i;
+
+  if (ur == NULL) return 0;
+
+  oggz_uring_drain (ur);
+
+  /* Leave the stdio stream at the position read up to */
+  if (oggz->file != NULL)
+    fseek (oggz->file, (long)ur->offset, SEEK_SET);
+
+  oggz_uring_unmap (ur);
+  close (ur->ring_fd);
+
+  for (i = 0; i < ur->depth; i++)
+    oggz_free (ur->buffers[i].data);
+  oggz_free (ur->buffers);
+  oggz_free (ur);
+
+  oggz->uring = NULL;
+
+  return 0;
+}
+
+/* Keep the read-ahead queue full */
+static void
+oggz_uring_fill (OggzUring * ur)
+{
+  OggzUringBuffer * buffer;
+  int slot;
+
+  while (ur->count < ur->depth) {
+    slot = (ur->head + ur->count) % ur->depth;
+    buffer = &ur->buffers[slot];
+
+    buffer->iov.iov_base = buffer->data;
+    buffer->iov.iov_len = OGGZ_URING_BUFSIZE;
+    buffer->offset = ur->next;
+    buffer->len = 0;
+    buffer->done = 0;
+
+    oggz_uring_queue_read (ur, &buffer->iov, ur->next, (__u64)slot);
+
+    ur->next += OGGZ_URING_BUFSIZE;
+    ur->count++;
+  }
+}
+
+size_t
+oggz_uring_read (OGGZ * oggz, void * buf, size_t n)
+{
+  OggzUring * ur = oggz->uring;
+  OggzUringBuffer * buffer;
+  long bytes;
+
+  if (n == 0) return 0;
+
+  if (!ur->sequential) {
+    /* The first read after a seek, such as a seek probe, goes straight
+     * into the caller's buffer */
+    ur->direct_iov.iov_base = buf;
+    ur->direct_iov.iov_len = n;
+    ur->direct_done = 0;
+
+    oggz_uring_queue_read (ur, &ur->direct_iov, ur->offset, OGGZ_URING_DIRECT);
+    if (oggz_uring_wait (ur, &ur->direct_done) == -1)
+      return (size_t) OGGZ_ERR_SYSTEM;
+
+    if (ur->direct_res < 0) {
+      errno = (int) -ur->direct_res;
+      return (size_t) OGGZ_ERR_SYSTEM;
+    }
+
+    ur->offset += ur->direct_res;
+    ur->next = ur->offset;
+    ur->sequential = 1;
+
+    return (size_t) ur->direct_res;
+  }
+
+  oggz_uring_fill (ur);
+
+  buffer = &ur->buffers[ur->head];
+  if (oggz_uring_wait (ur, &buffer->done) == -1)
+    return (size_t) OGGZ_ERR_SYSTEM;
+
+  /* Submit the refills queued above without waiting */
+  if (ur->to_submit > 0) oggz_uring_sys_enter (ur, 0);
+
+  if (buffer->len <= 0) {
+    /* End of file or an error. Discard the read-ahead so that the next
+     * read tries again from here. */
+    bytes = buffer->len;
+    if (oggz_uring_drain (ur) == -1) return (size_t) OGGZ_ERR_SYSTEM;
+    if (bytes < 0) {
+      errno = (int) -bytes;
+      return (size_t) OGGZ_ERR_SYSTEM;
+    }
+    return 0;
+  }
+
+  bytes = MIN ((long)n, buffer->len - ur->consumed);
+  memcpy (buf, buffer->data + ur->consumed, bytes);
+
+  ur->consumed += bytes;
+  ur->offset += bytes;
+
+  if (ur->consumed == buffer->len) {
+    ur->head = (ur->head + 1) % ur->depth;
+    ur->count--;
+    ur->consumed = 0;
+
+    /* After a short read, later reads were made at the wrong offsets */
+    if (buffer->len < OGGZ_URING_BUFSIZE) {
+      if (oggz_uring_drain (ur) == -1) return (size_t) OGGZ_ERR_SYSTEM;
+    }
+  }
+
+  return (size_t) bytes;
+}
+
+int
+oggz_uring_seek (OGGZ * oggz, long offset, int whence)
+{
+  OggzUring * ur = oggz->uring;
+  struct stat statbuf;
+  oggz_off_t pos;
+
+  switch (whence) {
+  case SEEK_SET: pos = offset; break;
+  case SEEK_CUR: pos = ur->offset + offset; break;
+  case SEEK_END:
+    if (fstat (ur->fd, &statbuf) == -1) return -1;
+    pos = statbuf.st_size + offset;
+    break;
+  default: return -1;
+  }
+
+  if (pos < 0) return -1;
+
+  ur->offset = pos;
+  ur->sequential = 0;
+
+  /* Read-ahead beyond the new position may still be usable, but seeks
+   * are usually probes to elsewhere in the file; start afresh */
+  if (oggz_uring_drain (ur) == -1) return -1;
+
+  return 0;
+}
+
+long
+oggz_uring_tell (OGGZ * oggz)
+{
+  return (long) oggz->uring->offset;
+}
+
+/*
+ * Make a set of positional reads at once, as many at a time as the ring
+ * has entries. The read-ahead is discarded first, leaving the ring free.
+ */
+int
+oggz_uring_read_multi (OGGZ * oggz, OggzIOProbe * probes, int n)
+{
+  OggzUring * ur = oggz->uring;
+  int i, batch, start;
+
+  if (oggz_uring_drain (ur) == -1) return OGGZ_ERR_SYSTEM;
+  ur->sequential = 0;
+
+  ur->probe_iovs = oggz_malloc (n * sizeof (struct iovec));
+  if (ur->probe_iovs == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  ur->probes = probes;
+
+  /* One entry more than the read-ahead depth was set up */
+  batch = ur->depth + 1;
+
+  for (start = 0; start < n; start += batch) {
+    ur->probes_pending = 0;
+
+    for (i = start; i < n && i < start + batch; i++) {
+      probes[i].len = -1;
+      ur->probe_iovs[i].iov_base = probes[i].buf;
+      ur->probe_iovs[i].iov_len = probes[i].n;
+      oggz_uring_queue_read (ur, &ur->probe_iovs[i], probes[i].offset,
+                             OGGZ_URING_PROBE | (__u64)i);
+      ur->probes_pending++;
+    }
+
+    while (ur->probes_pending > 0) {
+      if (oggz_uring_sys_enter (ur, ur->probes_pending) == -1) {
+        oggz_uring_drain (ur);
+        oggz_free (ur->probe_iovs);
+        ur->probe_iovs = NULL;
+        ur->probes = NULL;
+        return OGGZ_ERR_SYSTEM;
+      }
+      oggz_uring_reap (ur);
+    }
+  }
+
+  oggz_free (ur->probe_iovs);
+  ur->probe_iovs = NULL;
+  ur->probes = NULL;
+
+  return 0;
+}
+
+#else
+
+#include "oggz_private.h"
+
+int
+oggz_uring_init (OGGZ * oggz, int depth)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_uring_close (OGGZ * oggz)
+{
+  return 0;
+}
+
+size_t
+oggz_uring_read (OGGZ * oggz, void * buf, size_t n)
+{
+  return (size_t) OGGZ_ERR_INVALID;
+}
+
+int
+oggz_uring_seek (OGGZ * oggz, long offset, int whence)
+{
+  return -1;
+}
+
+long
+oggz_uring_tell (OGGZ * oggz)
+{
+  return -1;
+}
+
+int
+oggz_uring_read_multi (OGGZ * oggz, OggzIOProbe * probes, int n)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+#endif
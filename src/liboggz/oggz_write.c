@@ -52,7 +52,7 @@
 #include <ogg/ogg.h>
 
 #include "oggz_private.h"
-#include "oggz_vector.h"
+#include "oggz_ring.h"
 
 /* #define DEBUG */
 
@@ -61,27 +61,11 @@
 
 #define OGGZ_WRITE_EMPTY (-707)
 
-/* #define ZPACKET_CMP */
+/* The amount of output queued before a vectored write */
+#define OGGZ_WRITE_BATCH_BYTES (64 * 1024)
 
-#ifdef ZPACKET_CMP
-static int
-oggz_zpacket_cmp (oggz_writer_packet_t * a, oggz_writer_packet_t * b,
-		  void * user_data)
-{
-  OGGZ * oggz = (OGGZ *)user_data;
-  long serialno_a, serialno_b;
-  ogg_int64_t unit_a, unit_b;
-
-  serialno_a = a->stream->ogg_stream.serialno;
-  serialno_b = b->stream->ogg_stream.serialno;
-
-  unit_a = oggz_get_unit (oggz, serialno_a, a->op.granulepos);
-  unit_b = oggz_get_unit (oggz, serialno_b, b->op.granulepos);
-
-  if (unit_a < unit_b) return -1;
-  else return (unit_a > unit_b);
-}
-#endif
+/* Default span of packets held back by OGGZ_SORT, in units */
+#define OGGZ_SORT_MAX_DELAY 1000
 
 OGGZ *
 oggz_write_init (OGGZ * oggz)
@@ -90,14 +74,17 @@ oggz_write_init (OGGZ * oggz)
 
   writer->next_zpacket = NULL;
 
-  writer->packet_queue = oggz_vector_new ();
+  writer->packet_queue = oggz_ring_new (sizeof (oggz_writer_packet_t *));
   if (writer->packet_queue == NULL) return NULL;
 
-#ifdef ZPACKET_CMP
-  /* XXX: comparison function should only kick in when a metric is set */
-  oggz_vector_set_cmp (writer->packet_queue,
-		       (OggzCmpFunc)oggz_zpacket_cmp, oggz);
-#endif
+  writer->sort_heap = NULL;
+  writer->sort_heap_len = 0;
+  writer->sort_heap_size = 0;
+  writer->sort_queued = 0;
+  writer->sort_seq = 0;
+  writer->sort_unit_max = 0;
+  writer->sort_max_delay = OGGZ_SORT_MAX_DELAY;
+  writer->sort_release = 0;
 
   writer->hungry = NULL;
   writer->hungry_user_data = NULL;
@@ -121,6 +108,16 @@ oggz_write_init (OGGZ * oggz)
 
   writer->current_stream = NULL;
 
+  writer->batch_iov = NULL;
+  writer->batch_offsets = NULL;
+  writer->batch_streams = NULL;
+  writer->batch_data = NULL;
+  writer->batch_data_len = 0;
+  writer->batch_data_size = 0;
+  writer->batch_bytes = 0;
+  writer->batch_iovcnt = 0;
+  writer->batch_error = 0;
+
   return oggz;
 }
 
@@ -132,6 +129,9 @@ oggz_writer_packet_free (oggz_writer_packet_t * zpacket)
   if (zpacket->guard) {
     /* managed by user; flag guard */
     *zpacket->guard = 1;
+  } else if (zpacket->release) {
+    /* referenced from user; release if not yet done */
+    zpacket->release (zpacket->op.packet, zpacket->release_user_data);
   } else {
     /* managed by oggz; free copied data */
     oggz_free (zpacket->op.packet);
@@ -141,6 +141,209 @@ oggz_writer_packet_free (oggz_writer_packet_t * zpacket)
   return 0;
 }
 
+/*
+ * Remove and return the packet at the head of ring, or NULL if it is
+ * empty.
+ */
+static oggz_writer_packet_t *
+oggz_writer_ring_pop (OggzRing * ring)
+{
+  oggz_writer_packet_t ** head, * zpacket;
+
+  if (ring == NULL) return NULL;
+
+  head = (oggz_writer_packet_t **)oggz_ring_nth (ring, 0);
+  if (head == NULL) return NULL;
+
+  zpacket = *head;
+  oggz_ring_remove_head (ring);
+
+  return zpacket;
+}
+
+/******** Time ordering (OGGZ_SORT) ********/
+
+static oggz_writer_packet_t *
+oggz_sort_head (oggz_stream_t * stream)
+{
+  oggz_writer_packet_t ** head;
+
+  if (stream->sort_queue == NULL) return NULL;
+
+  head = (oggz_writer_packet_t **)oggz_ring_nth (stream->sort_queue, 0);
+
+  return (head == NULL) ? NULL : *head;
+}
+
+/*
+ * Whether the next packet of stream a is due before that of stream b
+ */
+static int
+oggz_sort_before (oggz_stream_t * a, oggz_stream_t * b)
+{
+  oggz_writer_packet_t * za = oggz_sort_head (a), * zb = oggz_sort_head (b);
+
+  if (za->unit != zb->unit) return (za->unit < zb->unit);
+
+  return (za->seq < zb->seq);
+}
+
+static void
+oggz_sort_sift_up (OggzWriter * writer, int i)
+{
+  oggz_stream_t ** heap = writer->sort_heap, * stream = heap[i];
+  int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (!oggz_sort_before (stream, heap[parent])) break;
+    heap[i] = heap[parent];
+    i = parent;
+  }
+
+  heap[i] = stream;
+}
+
+static void
+oggz_sort_sift_down (OggzWriter * writer, int i)
+{
+  oggz_stream_t ** heap = writer->sort_heap, * stream = heap[i];
+  int n = writer->sort_heap_len, child;
+
+  while ((child = 2 * i + 1) < n) {
+    if (child + 1 < n && oggz_sort_before (heap[child + 1], heap[child]))
+      child++;
+    if (!oggz_sort_before (heap[child], stream)) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+
+  heap[i] = stream;
+}
+
+/*
+ * oggz_sort_enqueue (oggz, zpacket)
+ *
+ * Queue a packet on its stream, adding the stream to the heap if it
+ * had no packets queued. Returns 0 on success, -1 if out of memory.
+ */
+static int
+oggz_sort_enqueue (OGGZ * oggz, oggz_writer_packet_t * zpacket)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  oggz_stream_t * stream = zpacket->stream, ** new_heap;
+  oggz_writer_packet_t ** slot;
+  int new_size;
+
+  if (stream->sort_queue == NULL) {
+    stream->sort_queue = oggz_ring_new (sizeof (oggz_writer_packet_t *));
+    if (stream->sort_queue == NULL) return -1;
+  }
+
+  if (writer->sort_heap_len == writer->sort_heap_size) {
+    new_size = writer->sort_heap_size ? writer->sort_heap_size * 2 : 4;
+    new_heap = oggz_realloc (writer->sort_heap,
+                             (size_t)new_size * sizeof (oggz_stream_t *));
+    if (new_heap == NULL) return -1;
+    writer->sort_heap = new_heap;
+    writer->sort_heap_size = new_size;
+  }
+
+  if ((slot = oggz_ring_append (stream->sort_queue)) == NULL) return -1;
+  *slot = zpacket;
+
+  if (oggz_ring_size (stream->sort_queue) == 1) {
+    writer->sort_heap[writer->sort_heap_len++] = stream;
+    oggz_sort_sift_up (writer, writer->sort_heap_len - 1);
+  }
+
+  writer->sort_queued++;
+
+  return 0;
+}
+
+/*
+ * Whether the earliest packet queued, at unit, may be written: either
+ * every stream which has not ended has a packet queued, so none can
+ * still feed an earlier one, or the queue spans the maximum delay.
+ */
+static int
+oggz_sort_ready (OGGZ * oggz, ogg_int64_t unit)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  oggz_stream_t * stream;
+  int i, size;
+
+  if (writer->sort_release) return 1;
+
+  if (writer->sort_unit_max - unit >= writer->sort_max_delay) return 1;
+
+  size = oggz_vector_size (oggz->streams);
+  for (i = 0; i < size; i++) {
+    stream = (oggz_stream_t *)oggz_vector_nth_p (oggz->streams, i);
+    if (!stream->e_o_s && oggz_sort_head (stream) == NULL) return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * oggz_sort_dequeue (oggz)
+ *
+ * Remove and return the earliest packet queued, or NULL if there is
+ * none or it must wait for other streams.
+ */
+static oggz_writer_packet_t *
+oggz_sort_dequeue (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  oggz_stream_t * stream;
+  oggz_writer_packet_t * zpacket;
+
+  if (writer->sort_heap_len == 0) return NULL;
+
+  stream = writer->sort_heap[0];
+  zpacket = oggz_sort_head (stream);
+
+  if (!oggz_sort_ready (oggz, zpacket->unit)) return NULL;
+
+  oggz_writer_ring_pop (stream->sort_queue);
+  if (--writer->sort_queued == 0) writer->sort_release = 0;
+
+  /* Reposition the stream by its next packet, or drop it from the heap */
+  if (oggz_ring_is_empty (stream->sort_queue))
+    writer->sort_heap[0] = writer->sort_heap[--writer->sort_heap_len];
+
+  if (writer->sort_heap_len > 0)
+    oggz_sort_sift_down (writer, 0);
+
+  return zpacket;
+}
+
+/*
+ * Remove and return the next packet to write, or NULL if there is none.
+ */
+static oggz_writer_packet_t *
+oggz_writer_queue_pop (OGGZ * oggz)
+{
+  if (oggz->flags & OGGZ_SORT) return oggz_sort_dequeue (oggz);
+
+  return oggz_writer_ring_pop (oggz->x.writer.packet_queue);
+}
+
+/*
+ * The number of packets queued, including any held back for ordering.
+ */
+static int
+oggz_writer_queue_size (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+
+  if (oggz->flags & OGGZ_SORT) return writer->sort_queued;
+
+  return oggz_ring_size (writer->packet_queue);
+}
+
 int
 oggz_write_flush (OGGZ * oggz)
 {
@@ -158,23 +361,254 @@ oggz_write_flush (OGGZ * oggz)
   return ret;
 }
 
+/*
+ * Write out the packets held back for OGGZ_SORT, where the handle has
+ * somewhere to write them. A stream which never ended would otherwise
+ * hold back the tails of all the others.
+ */
+static void
+oggz_write_close_sorted (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+
+  if (writer->sort_queued == 0 || writer->writing) return;
+
+  if (oggz->file == NULL && !oggz_io_can_writev (oggz) &&
+      (oggz->io == NULL || oggz->io->write == NULL))
+    return;
+
+  writer->sort_release = 1;
+  writer->hungry = NULL;
+  writer->no_more_packets = 0;
+  oggz->cb_next = 0;
+
+  while (oggz_write (oggz, OGGZ_WRITE_BATCH_BYTES) > 0);
+}
+
 OGGZ *
 oggz_write_close (OGGZ * oggz)
 {
   OggzWriter * writer = &oggz->x.writer;
+  oggz_writer_packet_t * zpacket;
+  oggz_stream_t * stream;
+  int i, size;
+
+  oggz_write_close_sorted (oggz);
 
   oggz_write_flush (oggz);
 
   oggz_writer_packet_free (writer->current_zpacket);
   oggz_writer_packet_free (writer->next_zpacket);
 
-  oggz_vector_foreach (writer->packet_queue,
-		       (OggzFunc)oggz_writer_packet_free);
-  oggz_vector_delete (writer->packet_queue);
+  while ((zpacket = oggz_writer_ring_pop (writer->packet_queue)) != NULL)
+    oggz_writer_packet_free (zpacket);
+  oggz_ring_delete (writer->packet_queue);
+
+  /* Packets held back for OGGZ_SORT; the streams free their queues */
+  size = oggz_vector_size (oggz->streams);
+  for (i = 0; i < size; i++) {
+    stream = (oggz_stream_t *)oggz_vector_nth_p (oggz->streams, i);
+    while ((zpacket = oggz_writer_ring_pop (stream->sort_queue)) != NULL)
+      oggz_writer_packet_free (zpacket);
+  }
+  oggz_free (writer->sort_heap);
+
+  oggz_free (writer->batch_iov);
+  oggz_free (writer->batch_offsets);
+  oggz_free (writer->batch_streams);
+  oggz_free (writer->batch_data);
 
   return oggz;
 }
 
+/******** Vectored output ********/
+
+/*
+ * oggz_write_batch_flush (oggz)
+ *
+ * Write out the pages queued by oggz_page_writeout_batch().
+ * Returns 0 on success, or OGGZ_ERR_SYSTEM.
+ */
+static int
+oggz_write_batch_flush (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  long n;
+  int i;
+
+  if (writer->batch_iovcnt == 0) return 0;
+
+  /* Point copied regions into batch_data, which may have moved */
+  for (i = 0; i < writer->batch_iovcnt; i++) {
+    if (writer->batch_offsets[i] != -1)
+      writer->batch_iov[i].base = writer->batch_data + writer->batch_offsets[i];
+  }
+
+  n = oggz_io_writev (oggz, writer->batch_iov, writer->batch_iovcnt);
+
+#ifdef DEBUG
+  printf ("oggz_write_batch_flush: wrote %ld bytes in %d regions\n",
+          n, writer->batch_iovcnt);
+#endif
+
+  writer->batch_iovcnt = 0;
+  writer->batch_data_len = 0;
+  writer->batch_bytes = 0;
+
+  if (n < 0) {
+    writer->batch_error = OGGZ_ERR_SYSTEM;
+    return OGGZ_ERR_SYSTEM;
+  }
+
+  return 0;
+}
+
+/*
+ * Copy len bytes of buf into batch_data. Returns their offset there,
+ * or -1 if out of memory.
+ */
+static long
+oggz_write_batch_copy (OGGZ * oggz, const unsigned char * buf, long len)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  unsigned char * new_data;
+  long offset, new_size;
+
+  if (writer->batch_data_len + len > writer->batch_data_size) {
+    new_size = MAX (writer->batch_data_size * 2, writer->batch_data_len + len);
+    new_size = MAX (new_size, OGGZ_WRITE_BATCH_BYTES);
+    new_data = oggz_realloc (writer->batch_data, new_size);
+    if (new_data == NULL) return -1;
+    writer->batch_data = new_data;
+    writer->batch_data_size = new_size;
+  }
+
+  offset = writer->batch_data_len;
+  memcpy (writer->batch_data + offset, buf, len);
+  writer->batch_data_len += len;
+
+  return offset;
+}
+
+/*
+ * oggz_write_batch_release (oggz, os)
+ *
+ * Copy out any queued page bodies still held by os, which is about to
+ * take another packet and so may move its body data.
+ */
+static int
+oggz_write_batch_release (OGGZ * oggz, ogg_stream_state * os)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  long offset;
+  int i;
+
+  for (i = 0; i < writer->batch_iovcnt; i++) {
+    if (writer->batch_streams[i] != os) continue;
+
+    offset = oggz_write_batch_copy (oggz, writer->batch_iov[i].base,
+                                    (long)writer->batch_iov[i].len);
+    if (offset == -1) return oggz_write_batch_flush (oggz);
+
+    writer->batch_offsets[i] = offset;
+    writer->batch_streams[i] = NULL;
+  }
+
+  return 0;
+}
+
+/*
+ * Make room to queue another region. Returns its index, or -1 on error.
+ */
+static int
+oggz_write_batch_slot (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+
+  if (writer->batch_iov == NULL) {
+    writer->batch_iov = oggz_malloc (OGGZ_IOV_MAX * sizeof (OggzIOVec));
+    writer->batch_offsets = oggz_malloc (OGGZ_IOV_MAX * sizeof (long));
+    writer->batch_streams =
+      oggz_malloc (OGGZ_IOV_MAX * sizeof (ogg_stream_state *));
+
+    if (writer->batch_iov == NULL || writer->batch_offsets == NULL ||
+        writer->batch_streams == NULL) {
+      oggz_free (writer->batch_iov);
+      oggz_free (writer->batch_offsets);
+      oggz_free (writer->batch_streams);
+      writer->batch_iov = NULL;
+      writer->batch_offsets = NULL;
+      writer->batch_streams = NULL;
+      return -1;
+    }
+  }
+
+  if (writer->batch_iovcnt == OGGZ_IOV_MAX &&
+      oggz_write_batch_flush (oggz) != 0)
+    return -1;
+
+  return writer->batch_iovcnt++;
+}
+
+/*
+ * oggz_page_writeout_batch (oggz, n)
+ *
+ * As oggz_page_writeout(), but queueing up to n bytes of the current
+ * page for vectored output: the header is copied, and the body is
+ * referenced in place until its stream next takes a packet.
+ */
+static long
+oggz_page_writeout_batch (OGGZ * oggz, long n)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  ogg_page * og = &oggz->current_page;
+  long h, b, offset;
+  int i;
+
+  h = MIN (n, og->header_len - writer->page_offset);
+  if (h > 0) {
+    if ((i = oggz_write_batch_slot (oggz)) == -1) return -1;
+
+    offset = oggz_write_batch_copy (oggz, og->header + writer->page_offset, h);
+    if (offset == -1) {
+      writer->batch_iovcnt--;
+      return -1;
+    }
+
+    writer->batch_iov[i].len = h;
+    writer->batch_offsets[i] = offset;
+    writer->batch_streams[i] = NULL;
+
+    writer->page_offset += h;
+    n -= h;
+  } else {
+    h = 0;
+  }
+
+  b = MIN (n, og->header_len + og->body_len - writer->page_offset);
+  if (b > 0) {
+    if ((i = oggz_write_batch_slot (oggz)) == -1) return -1;
+
+    writer->batch_iov[i].base =
+      og->body + (writer->page_offset - og->header_len);
+    writer->batch_iov[i].len = b;
+    writer->batch_offsets[i] = -1;
+    writer->batch_streams[i] = writer->current_stream;
+
+    writer->page_offset += b;
+    n -= b;
+  } else {
+    b = 0;
+  }
+
+  writer->batch_bytes += h + b;
+  if (writer->batch_bytes >= OGGZ_WRITE_BATCH_BYTES &&
+      oggz_write_batch_flush (oggz) != 0)
+    return -1;
+
+  return h + b;
+}
+
 /******** Packet queueing ********/
 
 int
@@ -199,27 +633,56 @@ oggz_write_set_hungry_callback (OGGZ * oggz, OggzWriteHungry hungry,
 }
 
 int
-oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
-		 int * guard)
+oggz_write_set_max_delay (OGGZ * oggz, ogg_int64_t units)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE) || !(oggz->flags & OGGZ_SORT) ||
+      units < 0) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  oggz->x.writer.sort_max_delay = units;
+
+  return 0;
+}
+
+int
+oggz_write_sort_flush (OGGZ * oggz)
+{
+  OggzWriter * writer;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE) || !(oggz->flags & OGGZ_SORT)) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  writer = &oggz->x.writer;
+
+  if (writer->sort_queued > 0) writer->sort_release = 1;
+
+  return writer->sort_queued;
+}
+
+static int
+oggz_write_feed_packet (OGGZ * oggz, ogg_packet * op, long serialno,
+			int flush, int * guard, OggzWriteRelease release,
+			void * release_user_data)
 {
   OggzWriter * writer;
   oggz_stream_t * stream;
-  oggz_writer_packet_t * packet;
+  oggz_writer_packet_t * packet, ** slot;
   ogg_packet * new_op;
   unsigned char * new_buf = NULL;
-  int b_o_s, e_o_s, bos_auto;
+  ogg_int64_t unit;
+  int b_o_s, e_o_s, bos_auto, queued;
   int strict, prefix, suffix;
 
 #ifdef DEBUG
   printf ("oggz_write_feed: IN\n");
 #endif
 
-  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
-
-  if (!(oggz->flags & OGGZ_WRITE)) {
-    return OGGZ_ERR_INVALID;
-  }
-
   writer = &oggz->x.writer;
 
   if (guard && *guard != 0) return OGGZ_ERR_BAD_GUARD;
@@ -307,7 +770,7 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
   stream->packetno = (op->packetno != -1) ? op->packetno : stream->packetno+1;
 
   /* Now set up the packet and add it to the queue */
-  if (guard == NULL) {
+  if (guard == NULL && release == NULL) {
     new_buf = oggz_malloc ((size_t)op->bytes);
     if (new_buf == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
 
@@ -318,7 +781,8 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 
   packet = oggz_malloc (sizeof (oggz_writer_packet_t));
   if (packet == NULL) {
-    if (guard == NULL && new_buf != NULL) oggz_free (new_buf);
+    if (guard == NULL && release == NULL && new_buf != NULL)
+      oggz_free (new_buf);
     return OGGZ_ERR_OUT_OF_MEMORY;
   }
 
@@ -333,15 +797,40 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
   packet->stream = stream;
   packet->flush = flush;
   packet->guard = guard;
+  packet->release = release;
+  packet->release_user_data = release_user_data;
+
+  if (oggz->flags & OGGZ_SORT) {
+    /* Order packets without a granulepos along with the one before */
+    unit = oggz_get_unit (oggz, serialno, op->granulepos);
+    if (unit == -1) unit = stream->sort_unit;
+    stream->sort_unit = unit;
+
+    packet->unit = unit;
+    packet->seq = writer->sort_seq++;
+    if (unit > writer->sort_unit_max) writer->sort_unit_max = unit;
+  } else {
+    packet->unit = -1;
+    packet->seq = 0;
+  }
 
 #ifdef DEBUG
   printf ("oggz_write_feed: made packet bos %ld eos %ld (%ld bytes) FLUSH: %d\n",
 	  new_op->b_o_s, new_op->e_o_s, new_op->bytes, packet->flush);
 #endif
 
-  if (oggz_vector_insert_p (writer->packet_queue, packet) == NULL) {
+  if (oggz->flags & OGGZ_SORT) {
+    queued = oggz_sort_enqueue (oggz, packet);
+  } else if ((slot = oggz_ring_append (writer->packet_queue)) != NULL) {
+    *slot = packet;
+    queued = 0;
+  } else {
+    queued = -1;
+  }
+
+  if (queued == -1) {
     oggz_free (packet);
-    if (!guard) oggz_free (new_buf);
+    if (!guard && !release) oggz_free (new_buf);
     return -1;
   }
 
@@ -349,12 +838,39 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 
 #ifdef DEBUG
   printf ("oggz_write_feed: enqueued packet, queue size %d\n",
-	  oggz_vector_size (writer->packet_queue));
+	  oggz_writer_queue_size (oggz));
 #endif
 
   return 0;
 }
 
+int
+oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
+		 int * guard)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE)) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  return oggz_write_feed_packet (oggz, op, serialno, flush, guard, NULL, NULL);
+}
+
+int
+oggz_write_feed_release (OGGZ * oggz, ogg_packet * op, long serialno,
+			 int flush, OggzWriteRelease release, void * user_data)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE) || release == NULL) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  return oggz_write_feed_packet (oggz, op, serialno, flush, NULL,
+				 release, user_data);
+}
+
 /******** Page creation ********/
 
 /*
@@ -445,8 +961,19 @@ oggz_packet_init (OGGZ * oggz, oggz_writer_packet_t * next_zpacket)
   if (!op->b_o_s) stream->delivered_non_b_o_s = 1;
 
   os = &stream->ogg_stream;
+
+  /* Queued output may refer to body data which packetin can move */
+  oggz_write_batch_release (oggz, os);
+
   ogg_stream_packetin (os, op);
 
+  /* libogg has its own copy of the data now */
+  if (next_zpacket->release) {
+    next_zpacket->release (op->packet, next_zpacket->release_user_data);
+    next_zpacket->release = NULL;
+    op->packet = NULL;
+  }
+
   writer->flushing = (next_zpacket->flush & OGGZ_FLUSH_AFTER);
 #ifdef DEBUG
   printf ("oggz_packet_init: set flush to %d\n", writer->flushing);
@@ -573,7 +1100,7 @@ static int
 oggz_dequeue_packet (OGGZ * oggz, oggz_writer_packet_t ** next_zpacket)
 {
   OggzWriter * writer = &oggz->x.writer;
-  int ret = 0;
+  int ret = 0, queued;
 
   if (writer->next_zpacket != NULL) {
 #ifdef DEBUG
@@ -582,27 +1109,32 @@ oggz_dequeue_packet (OGGZ * oggz, oggz_writer_packet_t ** next_zpacket)
     *next_zpacket = writer->next_zpacket;
     writer->next_zpacket = NULL;
   } else {
-    *next_zpacket = oggz_vector_pop (writer->packet_queue);
+    *next_zpacket = oggz_writer_queue_pop (oggz);
 
     if (*next_zpacket == NULL) {
       if (writer->hungry) {
-        ret = writer->hungry (oggz, 1, writer->hungry_user_data);
-        *next_zpacket = oggz_vector_pop (writer->packet_queue);
+        /* Keep asking while what is fed is held back for OGGZ_SORT */
+        do {
+          queued = oggz_writer_queue_size (oggz);
+          ret = writer->hungry (oggz, 1, writer->hungry_user_data);
+          *next_zpacket = oggz_writer_queue_pop (oggz);
+        } while (*next_zpacket == NULL && ret == 0 &&
+                 oggz_writer_queue_size (oggz) > queued);
 #ifdef DEBUG
         printf ("oggz_dequeue_packet: called hungry and popped, new queue size %d\n",
-  	        oggz_vector_size (writer->packet_queue));
+  	        oggz_writer_queue_size (oggz));
 #endif
 
 #ifdef DEBUG
       } else {
         printf ("oggz_dequeue_packet: no packet, no hungry, queue size %d\n",
-                oggz_vector_size (writer->packet_queue));
+                oggz_writer_queue_size (oggz));
 #endif
       }
 #ifdef DEBUG
     } else {
     printf ("oggz_dequeue_packet: dequeued packet, queue size %d\n",
-            oggz_vector_size (writer->packet_queue));
+            oggz_writer_queue_size (oggz));
 #endif
     }
 
@@ -634,7 +1166,7 @@ oggz_writer_make_packet (OGGZ * oggz)
    * it to them, marking emptiness appropriately
    */
   if (writer->hungry && !writer->hungry_only_when_empty) {
-    int empty = (oggz_vector_size (writer->packet_queue) == 0);
+    int empty = (oggz_writer_queue_size (oggz) == 0);
     cb_ret = writer->hungry (oggz, empty, writer->hungry_user_data);
   }
 
@@ -781,12 +1313,116 @@ oggz_write_output (OGGZ * oggz, unsigned char * buf, long n)
   return nwritten;
 }
 
+/*
+ * Point og at the part of the current page not yet output.
+ */
+static long
+oggz_page_handout (OGGZ * oggz, ogg_page * og)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  ogg_page * current = &oggz->current_page;
+  long h, offset;
+
+  offset = writer->page_offset;
+  h = MIN (offset, current->header_len);
+
+  og->header = current->header + h;
+  og->header_len = current->header_len - h;
+  og->body = current->body + (offset - h);
+  og->body_len = current->body_len - (offset - h);
+
+  writer->page_offset = current->header_len + current->body_len;
+
+  return og->header_len + og->body_len;
+}
+
+long
+oggz_write_output_page (OGGZ * oggz, ogg_page * og)
+{
+  OggzWriter * writer;
+  long nwritten = 0;
+  int active = 1, cb_ret = 0;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  writer = &oggz->x.writer;
+
+  if (!(oggz->flags & OGGZ_WRITE) || og == NULL) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (writer->writing) return OGGZ_ERR_RECURSIVE_WRITE;
+  writer->writing = 1;
+
+#ifdef DEBUG
+  printf ("oggz_write_output_page: IN\n");
+#endif
+
+  if ((cb_ret = oggz->cb_next) != OGGZ_CONTINUE) {
+    oggz->cb_next = 0;
+    writer->writing = 0;
+    writer->no_more_packets = 0;
+    if (cb_ret == OGGZ_WRITE_EMPTY) cb_ret = 0;
+    return oggz_map_return_value_to_error (cb_ret);
+  }
+
+  while (active && nwritten == 0) {
+    while (writer->state == OGGZ_MAKING_PACKETS) {
+      if ((cb_ret = oggz_writer_make_packet (oggz)) != OGGZ_CONTINUE) {
+#ifdef DEBUG
+        printf ("oggz_write_output_page: no packets (cb_ret is %d)\n",
+                cb_ret);
+#endif
+        if (cb_ret == OGGZ_WRITE_EMPTY) {
+          writer->flushing = 1;
+          writer->no_more_packets = 1;
+        }
+        /* As in oggz_write_output(), stop here unconditionally */
+        active = 0;
+        break;
+      }
+      if (oggz_page_init (oggz)) {
+        writer->state = OGGZ_WRITING_PAGES;
+      } else if (writer->no_more_packets) {
+        active = 0;
+        break;
+      }
+    }
+
+    if (writer->state == OGGZ_WRITING_PAGES) {
+      if (writer->page_offset < oggz->current_page.header_len +
+                                oggz->current_page.body_len) {
+        nwritten = oggz_page_handout (oggz, og);
+      } else if (writer->no_more_packets) {
+        active = 0;
+      } else if (!oggz_page_init (oggz)) {
+        writer->state = OGGZ_MAKING_PACKETS;
+      }
+    }
+  }
+
+#ifdef DEBUG
+  printf ("oggz_write_output_page: OUT %ld\n", nwritten);
+#endif
+
+  writer->writing = 0;
+
+  if (nwritten == 0) {
+    if (cb_ret == OGGZ_WRITE_EMPTY) cb_ret = 0;
+    return oggz_map_return_value_to_error (cb_ret);
+  } else {
+    oggz->cb_next = cb_ret;
+  }
+
+  return nwritten;
+}
+
 long
 oggz_write (OGGZ * oggz, long n)
 {
   OggzWriter * writer;
   long bytes, bytes_written = 1, remaining = n, nwritten = 0;
-  int active = 1, cb_ret = 0;
+  int active = 1, cb_ret = 0, vectored;
 
   if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
 
@@ -811,8 +1447,13 @@ oggz_write (OGGZ * oggz, long n)
     return oggz_map_return_value_to_error (cb_ret);
   }
 
+  /* Pages are queued whole and written out together where the output
+   * takes several regions at once; otherwise they go out in slices */
+  vectored = oggz_io_can_writev (oggz);
+  writer->batch_error = 0;
+
   while (active && remaining > 0) {
-    bytes = MIN (remaining, 1024);
+    bytes = vectored ? remaining : MIN (remaining, 1024);
 
 #ifdef DEBUG
     printf ("oggz_write: write loop (%ld , %ld remain) ...\n", bytes,
@@ -864,13 +1505,20 @@ oggz_write (OGGZ * oggz, long n)
     }
 
     if (writer->state == OGGZ_WRITING_PAGES) {
-      bytes_written = oggz_page_writeout (oggz, bytes);
+      if (vectored)
+        bytes_written = oggz_page_writeout_batch (oggz, bytes);
+      else
+        bytes_written = oggz_page_writeout (oggz, bytes);
 #ifdef DEBUG
       printf ("oggz_write: MAKING PAGES; wrote %ld bytes\n", bytes_written);
 #endif
 
       if (bytes_written == -1) {
         active = 0;
+        writer->batch_iovcnt = 0;
+        writer->batch_data_len = 0;
+        writer->batch_bytes = 0;
+        writer->writing = 0;
         return OGGZ_ERR_SYSTEM; /* XXX: catch next */
       } else if (bytes_written == 0) {
         /*
@@ -899,8 +1547,12 @@ oggz_write (OGGZ * oggz, long n)
   printf ("oggz_write: OUT %ld\n", nwritten);
 #endif
 
+  oggz_write_batch_flush (oggz);
+
   writer->writing = 0;
 
+  if (writer->batch_error != 0) return writer->batch_error;
+
   if (nwritten == 0) {
     if (cb_ret == OGGZ_WRITE_EMPTY) cb_ret = 0;
     return oggz_map_return_value_to_error (cb_ret);
@@ -960,6 +1612,18 @@ oggz_write_set_hungry_callback (OGGZ * oggz, OggzWriteHungry hungry,
   return OGGZ_ERR_DISABLED;
 }
 
+int
+oggz_write_set_max_delay (OGGZ * oggz, ogg_int64_t units)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_write_sort_flush (OGGZ * oggz)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 int
 oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 		 int * guard)
@@ -967,12 +1631,25 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
   return OGGZ_ERR_DISABLED;
 }
 
+int
+oggz_write_feed_release (OGGZ * oggz, ogg_packet * op, long serialno,
+			 int flush, OggzWriteRelease release, void * user_data)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_write_output (OGGZ * oggz, unsigned char * buf, long n)
 {
   return OGGZ_ERR_DISABLED;
 }
 
+long
+oggz_write_output_page (OGGZ * oggz, ogg_page * og)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_write (OGGZ * oggz, long n)
 {
@@ -0,0 +1,198 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 4000
+#define DATA_BUF_LEN (NR_PACKETS * 600)
+
+#define NR_TARGETS 40
+
+static long serialno;
+
+static long
+packet_len (int iter)
+{
+  return 20 + (iter % 11) * 50;
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[600];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, packet_len (iter));
+
+  op.packet = buf;
+  op.bytes = packet_len (iter);
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_int64_t * granulepos = (ogg_int64_t *)user_data;
+
+  /* Only the last packet of each page carries its granulepos */
+  if (*granulepos != -1 || zp->op.granulepos == -1) return OGGZ_CONTINUE;
+
+  if (zp->op.packet[0] != (zp->op.granulepos & 0xff))
+    FAIL ("Packet contains incorrect data");
+
+  *granulepos = zp->op.granulepos;
+
+  return OGGZ_CONTINUE;
+}
+
+/*
+ * Seek to each target, reading on one packet from each position
+ * reached. Returns the number of callbacks made.
+ */
+static long
+seek_targets (int use_read_at, ogg_int64_t * results)
+{
+  OGGZ * reader;
+  test_file f;
+  ogg_int64_t units, result, granulepos;
+  int i;
+
+  reader = test_open_reader (&f, OGGZ_READ, read_packet, &granulepos);
+
+  if (use_read_at) {
+    if (oggz_io_set_read_at (reader, test_io_read_at, &f) != 0)
+      FAIL("Could not set read_at callback");
+
+    if (oggz_io_get_read_at_user_handle (reader) != &f)
+      FAIL("read_at user handle not retained");
+  }
+
+  /* Read the header page */
+  granulepos = 0;
+  oggz_read (reader, 1024);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  for (i = 0; i < NR_TARGETS; i++) {
+    units = (i * 2999) % (NR_PACKETS - 20) + 10;
+
+    if ((result = oggz_seek_units (reader, units, SEEK_SET)) < 0)
+      FAIL("Seek failed");
+
+    if (result > units || result < units - 255)
+      FAIL("Seek returned incorrect units");
+
+    if (use_read_at && result != results[i])
+      FAIL("Seek with read_at returned a different result");
+    results[i] = result;
+
+    /* Sequential reading carries on from the page reached */
+    granulepos = -1;
+    while (granulepos == -1 && oggz_read (reader, 1024) > 0);
+    if (granulepos != result)
+      FAIL("Read after seek returned incorrect packet");
+    granulepos = 0;
+  }
+
+  oggz_close (reader);
+
+  if (!use_read_at && f.reads_at != 0)
+    FAIL("read_at callback called when not set");
+
+  if (use_read_at && f.reads_at == 0)
+    FAIL("read_at callback not used");
+
+#ifdef DEBUG
+  printf ("read_at %d: %ld reads, %ld seeks, %ld tells, %ld reads at\n",
+          use_read_at, f.reads, f.seeks, f.tells, f.reads_at);
+#endif
+
+  return f.reads + f.seeks + f.tells + f.reads_at;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  ogg_int64_t results[NR_TARGETS];
+  long calls, calls_at;
+
+  INFO ("Testing positional reads with OggzIOReadAt");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  test_generate (writer, hungry, DATA_BUF_LEN);
+
+  if (oggz_io_set_read_at (writer, test_io_read_at, NULL) != OGGZ_ERR_INVALID)
+    FAIL("Setting read_at on an OGGZ writer succeeded");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  INFO ("+ Seeking with read, seek and tell callbacks");
+  calls = seek_targets (0, results);
+
+  INFO ("+ Seeking with a read_at callback");
+  calls_at = seek_targets (1, results);
+
+  if (calls_at >= calls)
+    FAIL("Seeking with read_at made no fewer callbacks");
+
+  exit (0);
+}
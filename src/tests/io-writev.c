@@ -0,0 +1,225 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 2000
+#define DATA_BUF_LEN (NR_PACKETS * 600)
+
+#define WRITEV_TEST_FILE "io-writev-test.ogg"
+
+#define SERIALNO 7
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static long data_len = 0;
+
+static unsigned char writev_buf[DATA_BUF_LEN];
+static long writev_len = 0;
+static long writev_calls = 0;
+static long writev_regions = 0;
+
+static long
+packet_len (int iter)
+{
+  return 20 + (iter % 11) * 50;
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[600];
+  ogg_packet op;
+  int * iter = (int *)user_data;
+
+  if (*iter >= NR_PACKETS) return 1;
+
+  memset (buf, *iter & 0xff, packet_len (*iter));
+
+  op.packet = buf;
+  op.bytes = packet_len (*iter);
+  op.b_o_s = (*iter == 0);
+  op.e_o_s = (*iter == NR_PACKETS - 1);
+  op.granulepos = *iter;
+  op.packetno = *iter;
+
+  /* Flush now and then, so that pages are of differing lengths */
+  if (oggz_write_feed (oggz, &op, SERIALNO,
+                       (*iter % 37 == 0) ? OGGZ_FLUSH_AFTER : 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  (*iter)++;
+
+  return 0;
+}
+
+static long
+my_io_writev (void * user_handle, const OggzIOVec * iov, int iovcnt)
+{
+  long total = 0;
+  int i;
+
+  writev_calls++;
+  writev_regions += iovcnt;
+
+  for (i = 0; i < iovcnt; i++) {
+    if (writev_len + (long)iov[i].len > DATA_BUF_LEN)
+      FAIL ("Vectored output overflows buffer");
+    memcpy (writev_buf + writev_len, iov[i].base, iov[i].len);
+    writev_len += iov[i].len;
+    total += iov[i].len;
+  }
+
+  return total;
+}
+
+static OGGZ *
+new_writer (OGGZ * writer, int * iter)
+{
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  *iter = 0;
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, iter) == -1)
+    FAIL("Could not set hungry callback");
+
+  return writer;
+}
+
+static long
+compare_file (const char * filename)
+{
+  FILE * file;
+  static unsigned char buf[DATA_BUF_LEN];
+  long n;
+
+  if ((file = fopen (filename, "rb")) == NULL)
+    FAIL ("Could not open written file");
+
+  n = (long)fread (buf, 1, DATA_BUF_LEN, file);
+  fclose (file);
+
+  if (n != data_len || memcmp (buf, data_buf, data_len) != 0)
+    FAIL ("File written with writev differs");
+
+  return n;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * reader;
+  int iter;
+  long n;
+
+  INFO ("Testing vectored output with OggzIOWritev");
+
+  /* Reference output, copied out of Oggz a buffer at a time */
+  writer = new_writer (oggz_new (OGGZ_WRITE), &iter);
+
+  while ((n = oggz_write_output (writer, data_buf + data_len,
+                                 DATA_BUF_LEN - data_len)) > 0) {
+    data_len += n;
+  }
+
+  oggz_close (writer);
+
+  INFO ("+ Writing through a writev callback");
+  writer = new_writer (oggz_new (OGGZ_WRITE), &iter);
+
+  if (oggz_io_set_writev (writer, my_io_writev, writev_buf) != 0)
+    FAIL("Could not set writev callback");
+
+  if (oggz_io_get_writev_user_handle (writer) != writev_buf)
+    FAIL("writev user handle not retained");
+
+  while ((n = oggz_write (writer, 64 * 1024)) > 0);
+  if (n < 0 && n != OGGZ_ERR_STOP_OK)
+    FAIL("Vectored oggz_write failed");
+
+  oggz_close (writer);
+
+#ifdef DEBUG
+  printf ("%ld bytes in %ld writev calls of %ld regions\n",
+          writev_len, writev_calls, writev_regions);
+#endif
+
+  if (writev_len != data_len || memcmp (writev_buf, data_buf, data_len) != 0)
+    FAIL("Vectored output differs");
+
+  /* Each page is a header and a body region */
+  if (writev_calls * 16 > writev_regions / 2)
+    FAIL("Too few pages written per writev call");
+
+  INFO ("+ Writing to a file with writev()");
+  writer = new_writer (oggz_open (WRITEV_TEST_FILE, OGGZ_WRITE), &iter);
+
+  if (oggz_io_set_writev (writer, my_io_writev, NULL) != OGGZ_ERR_INVALID)
+    FAIL("Setting writev on a file succeeded");
+
+  while ((n = oggz_write (writer, 64 * 1024)) > 0);
+  if (n < 0 && n != OGGZ_ERR_STOP_OK)
+    FAIL("oggz_write to file failed");
+
+  oggz_close (writer);
+
+  compare_file (WRITEV_TEST_FILE);
+
+  INFO ("+ Writing to a file in small steps");
+  writer = new_writer (oggz_open (WRITEV_TEST_FILE, OGGZ_WRITE), &iter);
+
+  while ((n = oggz_write (writer, 100)) > 0);
+  if (n < 0 && n != OGGZ_ERR_STOP_OK)
+    FAIL("oggz_write to file failed");
+
+  oggz_close (writer);
+
+  compare_file (WRITEV_TEST_FILE);
+
+  remove (WRITEV_TEST_FILE);
+
+  reader = oggz_new (OGGZ_READ);
+  if (oggz_io_set_writev (reader, my_io_writev, NULL) != OGGZ_ERR_INVALID)
+    FAIL("Setting writev on an OGGZ reader succeeded");
+  oggz_close (reader);
+
+  exit (0);
+}
@@ -0,0 +1,157 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include <oggz/oggz.h>
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+unsigned char * data_buf = NULL;
+long data_len = 0;
+
+static long data_size = 0;
+
+void
+test_generate (OGGZ * writer, OggzWriteHungry hungry, long size)
+{
+  long n;
+
+  if (data_buf == NULL) {
+    if ((data_buf = malloc (size)) == NULL)
+      FAIL("Could not allocate data buffer");
+    data_size = size;
+  }
+
+  if (hungry != NULL &&
+      oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data_buf + data_len,
+                                 data_size - data_len)) > 0) {
+    data_len += n;
+  }
+}
+
+size_t
+test_io_read (void * user_handle, void * buf, size_t n)
+{
+  test_file * f = (test_file *)user_handle;
+  long len;
+
+  f->reads++;
+
+  len = MIN ((long)n, data_len - f->offset);
+  if (len < 0) len = 0;
+  memcpy (buf, &data_buf[f->offset], len);
+
+  f->offset += len;
+  f->bytes_read += len;
+
+  return len;
+}
+
+size_t
+test_io_read_at (void * user_handle, void * buf, size_t n,
+                 oggz_off_t offset)
+{
+  test_file * f = (test_file *)user_handle;
+  long len;
+
+  f->reads_at++;
+
+  len = MIN ((long)n, data_len - (long)offset);
+  if (len < 0) len = 0;
+  memcpy (buf, &data_buf[offset], len);
+
+  f->bytes_read += len;
+
+  return len;
+}
+
+int
+test_io_seek (void * user_handle, long offset, int whence)
+{
+  test_file * f = (test_file *)user_handle;
+
+  f->seeks++;
+
+  switch (whence) {
+  case SEEK_SET:
+    f->offset = offset;
+    break;
+  case SEEK_CUR:
+    f->offset += offset;
+    break;
+  case SEEK_END:
+    f->offset = data_len + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+long
+test_io_tell (void * user_handle)
+{
+  test_file * f = (test_file *)user_handle;
+
+  f->tells++;
+
+  return f->offset;
+}
+
+OGGZ *
+test_open_reader (test_file * f, int flags, OggzReadPacket read_packet,
+                  void * user_data)
+{
+  OGGZ * reader;
+
+  reader = oggz_new (flags);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  memset (f, 0, sizeof (*f));
+
+  oggz_io_set_read (reader, test_io_read, f);
+  oggz_io_set_seek (reader, test_io_seek, f);
+  oggz_io_set_tell (reader, test_io_tell, f);
+
+  oggz_set_read_callback (reader, -1, read_packet, user_data);
+
+  return reader;
+}
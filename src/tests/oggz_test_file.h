@@ -0,0 +1,75 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_TEST_FILE_H__
+#define __OGGZ_TEST_FILE_H__
+
+/*
+ * An Ogg file generated in memory by a test, and read back through I/O
+ * callbacks as if from a seekable file.
+ */
+
+#include <oggz/oggz.h>
+
+/* The generated data; tests may shorten data_len to truncate the file */
+extern unsigned char * data_buf;
+extern long data_len;
+
+/* The position of one reader in data_buf, and the callbacks it made */
+typedef struct {
+  long offset;
+  long reads, seeks, tells, reads_at;
+  long bytes_read;
+} test_file;
+
+/*
+ * Append all output available from writer to data_buf, which is
+ * allocated to hold size bytes on first use. If hungry is not NULL it
+ * is first set as the writer's hungry callback, so that the whole
+ * stream is generated in one call.
+ */
+void test_generate (OGGZ * writer, OggzWriteHungry hungry, long size);
+
+size_t test_io_read (void * user_handle, void * buf, size_t n);
+size_t test_io_read_at (void * user_handle, void * buf, size_t n,
+                        oggz_off_t offset);
+int test_io_seek (void * user_handle, long offset, int whence);
+long test_io_tell (void * user_handle);
+
+/*
+ * Open a reader with the given flags on data_buf through f, which is
+ * reset to the start, calling read_packet for all streams.
+ */
+OGGZ * test_open_reader (test_file * f, int flags,
+                         OggzReadPacket read_packet, void * user_data);
+
+#endif /* __OGGZ_TEST_FILE_H__ */
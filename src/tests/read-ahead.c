@@ -0,0 +1,217 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 4000
+#define PACKET_LEN 200
+#define DATA_BUF_LEN (NR_PACKETS * (PACKET_LEN + 8))
+
+static long serialno;
+static int read_iter = 0;
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static long data_len = 0;
+static long my_offset = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, PACKET_LEN);
+
+  op.packet = buf;
+  op.bytes = PACKET_LEN;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+
+  if (op->packetno != read_iter)
+    FAIL ("Packet has incorrect packetno");
+
+  if (op->bytes != PACKET_LEN || op->packet[PACKET_LEN-1] != (read_iter & 0xff))
+    FAIL ("Packet contains incorrect data");
+
+  read_iter++;
+
+  return 0;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  long len;
+
+  len = MIN ((long)n, data_len - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = data_len + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  long n;
+  int ret;
+
+  INFO ("Testing read-ahead");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data_buf + data_len,
+                                 DATA_BUF_LEN - data_len)) > 0) {
+    data_len += n;
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, NULL);
+  oggz_io_set_seek (reader, my_io_seek, NULL);
+  oggz_io_set_tell (reader, my_io_tell, NULL);
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  ret = oggz_set_read_ahead (reader, 2);
+  if (ret == OGGZ_ERR_DISABLED) {
+    INFO ("Read-ahead not supported; skipping");
+    oggz_close (reader);
+    exit (0);
+  } else if (ret != 0) {
+    FAIL("Could not enable read-ahead");
+  }
+
+  /* Read part of the data, then continue without read-ahead */
+  while (read_iter < NR_PACKETS / 3) {
+    if ((n = oggz_read (reader, 4096)) <= 0)
+      FAIL("Read failed");
+  }
+
+  if (oggz_set_read_ahead (reader, 0) != 0)
+    FAIL("Could not disable read-ahead");
+
+  while ((n = oggz_read (reader, 4096)) > 0);
+
+  if (read_iter != NR_PACKETS)
+    FAIL("Data was lost when disabling read-ahead");
+
+  /* Read everything again after seeking back to the start */
+  if (oggz_set_read_ahead (reader, 3) != 0)
+    FAIL("Could not enable read-ahead");
+
+  if (oggz_seek (reader, 0, SEEK_SET) != 0)
+    FAIL("Could not seek to start");
+
+  read_iter = 0;
+
+  while ((n = oggz_read (reader, 4096)) > 0);
+
+  if (n != 0)
+    FAIL("Read failed");
+
+  if (read_iter != NR_PACKETS)
+    FAIL("Incorrect number of packets read with read-ahead");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
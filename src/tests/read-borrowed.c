@@ -0,0 +1,216 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 200
+#define STOP_PACKET 150
+#define DATA_BUF_LEN (NR_PACKETS * 600)
+
+static long serialno;
+static int read_iter = 0;
+static int pages_in_place = 0;
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static unsigned char * lent_buf = NULL;
+static long lent_len = 0;
+
+static long
+packet_size (int iter)
+{
+  return 1 + (iter * 37) % 500;
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[500];
+  ogg_packet op;
+  static int iter = 0;
+  long bytes;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  bytes = packet_size (iter);
+  memset (buf, 'a' + iter % 26, bytes);
+
+  op.packet = buf;
+  op.bytes = bytes;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  /* Flush every few packets so that pages straddle the input chunks */
+  if (oggz_write_feed (oggz, &op, serialno,
+                       (iter % 3 == 2) ? OGGZ_FLUSH_AFTER : 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  if (lent_buf != NULL && og->header >= lent_buf &&
+      og->body + og->body_len <= lent_buf + lent_len)
+    pages_in_place++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  long i;
+
+#ifdef DEBUG
+  printf ("%08" PRI_OGGZ_OFF_T "x: serialno %010lu, "
+	  "granulepos %" PRId64 ", packetno %" PRId64 "\n",
+	  oggz_tell (oggz), serialno, op->granulepos, op->packetno);
+#endif
+
+  if (op->bytes != packet_size (read_iter))
+    FAIL ("Packet has incorrect length");
+
+  for (i = 0; i < op->bytes; i++) {
+    if (op->packet[i] != 'a' + read_iter % 26)
+      FAIL ("Packet contains incorrect data");
+  }
+
+  if ((op->b_o_s == 0) != (read_iter != 0))
+    FAIL ("Packet has incorrect b_o_s");
+
+  if ((op->e_o_s == 0) != (read_iter != NR_PACKETS - 1))
+    FAIL ("Packet has incorrect e_o_s");
+
+  if (op->packetno != read_iter)
+    FAIL ("Packet has incorrect packetno");
+
+  read_iter++;
+
+  if (read_iter == STOP_PACKET) return OGGZ_STOP_OK;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  long n, len = 0, offset = 0, chunk, ret;
+  int i = 0, stopped = 0;
+  static const long chunks[] = {1, 26, 4000, 7, 300, 65536, 2, 1500};
+
+  INFO ("Testing borrowed buffer input");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data_buf + len,
+                                 DATA_BUF_LEN - len)) > 0) {
+    len += n;
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+  oggz_set_read_page (reader, -1, read_page, NULL);
+
+  while (offset < len) {
+    chunk = MIN (chunks[i++ % 8], len - offset);
+
+    /* Lend a private copy, then scribble over it after the call */
+    lent_buf = malloc (chunk);
+    if (lent_buf == NULL)
+      FAIL("Out of memory");
+    memcpy (lent_buf, data_buf + offset, chunk);
+    lent_len = chunk;
+
+    ret = oggz_read_input_borrowed (reader, lent_buf, chunk);
+
+    memset (lent_buf, 0, chunk);
+    free (lent_buf);
+    lent_buf = NULL;
+
+    if (ret == OGGZ_ERR_STOP_OK) {
+      stopped++;
+      continue;
+    }
+
+    if (ret <= 0)
+      FAIL("Borrowed input failed");
+
+    if (ret < chunk) {
+      if (read_iter != STOP_PACKET)
+        FAIL("Input partially consumed without a stop");
+      stopped++;
+    }
+
+    offset += ret;
+  }
+
+  if (read_iter != NR_PACKETS)
+    FAIL("Not all packets were read");
+
+  if (stopped == 0)
+    FAIL("Callback stop was not reported");
+
+  if (pages_in_place == 0)
+    FAIL("No pages were parsed in place");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
@@ -0,0 +1,160 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN 65536
+
+#define NR_STREAMS 40
+#define NR_PACKETS 4
+
+static long serialnos[NR_STREAMS];
+static int packets_read[NR_STREAMS];
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[1];
+  ogg_packet op;
+  static int iter = 0;
+  int i, packetno;
+
+  if (iter >= NR_STREAMS * NR_PACKETS) return 1;
+
+  /* Interleave the streams, one packet from each in turn */
+  i = iter % NR_STREAMS;
+  packetno = iter / NR_STREAMS;
+
+  buf[0] = (unsigned char)i;
+
+  op.packet = buf;
+  op.bytes = 1;
+  op.b_o_s = (packetno == 0);
+  op.e_o_s = (packetno == NR_PACKETS - 1);
+  op.granulepos = packetno;
+  op.packetno = packetno;
+
+  if (oggz_write_feed (oggz, &op, serialnos[i], OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  int i = (int)(long)user_data;
+
+  if (serialno != serialnos[i])
+    FAIL ("Packet delivered to callback for wrong stream");
+
+  if (op->bytes != 1 || op->packet[0] != (unsigned char)i)
+    FAIL ("Packet contains incorrect data");
+
+  if (op->packetno != packets_read[i])
+    FAIL ("Packet has incorrect packetno");
+
+  packets_read[i]++;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  unsigned char data_buf[DATA_BUF_LEN];
+  long n;
+  int i;
+
+  INFO ("Testing reading of many multiplexed streams");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  for (i = 0; i < NR_STREAMS; i++) {
+    serialnos[i] = oggz_serialno_new (writer);
+  }
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  n = oggz_write_output (writer, data_buf, DATA_BUF_LEN);
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  /* Register callbacks in reverse order, creating the streams in a
+   * different order to that in which they appear in the data */
+  for (i = NR_STREAMS - 1; i >= 0; i--) {
+    if (oggz_set_read_callback (reader, serialnos[i], read_packet,
+                                (void *)(long)i) != 0)
+      FAIL("Could not set read callback");
+  }
+
+  if (oggz_read_input (reader, data_buf, n) != n)
+    FAIL("Could not read generated data");
+
+  if (oggz_get_numtracks (reader) != NR_STREAMS)
+    FAIL("Incorrect number of tracks");
+
+  for (i = 0; i < NR_STREAMS; i++) {
+    if (packets_read[i] != NR_PACKETS)
+      FAIL("Incorrect number of packets read");
+  }
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
@@ -0,0 +1,173 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN 1024
+
+/* Some garbage to skip before the first page */
+#define JUNK "OggOggOg"
+
+static long serialno;
+static int read_iter = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[1];
+  ogg_packet op;
+  static int iter = 0;
+  static long b_o_s = 1;
+  static long e_o_s = 0;
+
+  if (iter > 10) return 1;
+
+  buf[0] = 'a' + iter;
+
+  op.packet = buf;
+  op.bytes = 1;
+  op.b_o_s = b_o_s;
+  op.e_o_s = e_o_s;
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+  b_o_s = 0;
+  if (iter == 10) e_o_s = 1;
+  
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+
+  if (op->bytes != 1)
+    FAIL ("Packet too long");
+
+  if (op->packet[0] != 'a' + read_iter)
+    FAIL ("Packet contains incorrect data");
+
+  if ((op->b_o_s == 0) != (read_iter != 0))
+    FAIL ("Packet has incorrect b_o_s");
+
+  if ((op->e_o_s == 0) != (read_iter != 10))
+    FAIL ("Packet has incorrect e_o_s");
+
+  if (op->granulepos != -1 && op->granulepos != read_iter)
+    FAIL ("Packet has incorrect granulepos");
+
+  if (op->packetno != read_iter)
+    FAIL ("Packet has incorrect packetno");
+
+  read_iter++;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  unsigned char data_buf[DATA_BUF_LEN];
+  FILE * file;
+  long n;
+
+  INFO ("Testing reading via OGGZ_MMAP");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  n = oggz_write_output (writer, data_buf, DATA_BUF_LEN);
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  if ((file = tmpfile ()) == NULL)
+    FAIL("Could not create temporary file");
+
+  if (fwrite (JUNK, 1, strlen (JUNK), file) != strlen (JUNK) ||
+      fwrite (data_buf, 1, n, file) != (size_t)n)
+    FAIL("Could not write temporary file");
+
+  fflush (file);
+  rewind (file);
+
+  reader = oggz_open_stdio (file, OGGZ_READ | OGGZ_MMAP);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  while (oggz_read (reader, 64) > 0);
+
+  if (read_iter != 11)
+    FAIL("Incorrect number of packets read");
+
+  if (oggz_seek (reader, 0, SEEK_SET) != 0)
+    FAIL("Seek failure");
+
+  read_iter = 0;
+
+  while (oggz_read (reader, 64) > 0);
+
+  if (read_iter != 11)
+    FAIL("Incorrect number of packets read after seeking");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
@@ -0,0 +1,230 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN 16384
+
+#define NR_PACKETS 100
+#define PACKET_LEN 32
+
+/* A single 20ms CELT-only Opus frame is 960 samples at 48kHz */
+#define OPUS_TOC 0xf8
+#define OPUS_FRAME 960
+
+static long serialno;
+static long data_len = 0;
+static int read_pages = 0;
+
+static unsigned char opus_head[19] = {
+  'O', 'p', 'u', 's', 'H', 'e', 'a', 'd',
+  1, 1, 0, 0, 0x80, 0xbb, 0, 0, 0, 0, 0
+};
+
+static unsigned char opus_tags[16] = {
+  'O', 'p', 'u', 's', 'T', 'a', 'g', 's',
+  0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+  int flush = 0;
+
+  if (iter >= NR_PACKETS + 2) return 1;
+
+  memset (&op, 0, sizeof (op));
+
+  if (iter == 0) {
+    op.packet = opus_head;
+    op.bytes = sizeof (opus_head);
+    op.b_o_s = 1;
+    op.granulepos = 0;
+    flush = OGGZ_FLUSH_AFTER;
+  } else if (iter == 1) {
+    op.packet = opus_tags;
+    op.bytes = sizeof (opus_tags);
+    op.granulepos = 0;
+    flush = OGGZ_FLUSH_AFTER;
+  } else {
+    memset (buf, iter, PACKET_LEN);
+    buf[0] = OPUS_TOC;
+    op.packet = buf;
+    op.bytes = PACKET_LEN;
+    op.granulepos = (iter - 1) * OPUS_FRAME;
+    op.e_o_s = (iter == NR_PACKETS + 1);
+    /* Several pages, so that reverse buffered and directly delivered
+     * packets are interleaved */
+    if (iter % 10 == 0) flush = OGGZ_FLUSH_AFTER;
+  }
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  unsigned char * data_buf = (unsigned char *)user_handle;
+  static long offset = 0;
+  long len;
+
+  /* Hand out data in small pieces */
+  len = MIN ((long)n, MIN (100, data_len - offset));
+  memcpy (buf, &data_buf[offset], len);
+
+  offset += len;
+
+  return len;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  read_pages++;
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  FAIL ("Packet callback called while pulling packets");
+  return OGGZ_STOP_ERR;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  unsigned char data_buf[DATA_BUF_LEN];
+  oggz_packet zp;
+  const ogg_page * og;
+  long read_serialno;
+  int ret, iter = 0, nr_pages = 0;
+
+  INFO ("Testing pulling packets with oggz_read_next_packet");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  data_len = oggz_write_output (writer, data_buf, DATA_BUF_LEN);
+
+  if (data_len >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ | OGGZ_AUTO);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+  oggz_set_read_page (reader, -1, read_page, NULL);
+
+  while ((ret = oggz_read_next_packet (reader, &zp, &read_serialno, &og)) > 0) {
+    ogg_packet * op = &zp.op;
+
+#ifdef DEBUG
+    printf ("packetno %" PRId64 ": calc_granulepos %" PRId64 " page %p\n",
+            op->packetno, zp.pos.calc_granulepos, (void *)og);
+#endif
+
+    if (read_serialno != serialno)
+      FAIL ("Packet has incorrect serialno");
+
+    if (op->packetno != iter)
+      FAIL ("Packet delivered out of order");
+
+    if (iter >= 2) {
+      if (op->bytes != PACKET_LEN || op->packet[0] != OPUS_TOC ||
+          op->packet[PACKET_LEN-1] != (unsigned char)iter)
+        FAIL ("Packet contains incorrect data");
+
+      if (zp.pos.calc_granulepos != (iter - 1) * OPUS_FRAME)
+        FAIL ("Packet has incorrect calculated granulepos");
+    }
+
+    if (og != NULL) {
+      if (ogg_page_serialno ((ogg_page *)og) != serialno)
+        FAIL ("Page has incorrect serialno");
+      nr_pages++;
+    }
+
+    iter++;
+  }
+
+  if (ret != 0)
+    FAIL("Error pulling packets");
+
+  if (iter != NR_PACKETS + 2)
+    FAIL("Incorrect number of packets read");
+
+  if (nr_pages == 0)
+    FAIL("No packets were returned with their page");
+
+  if (read_pages == 0)
+    FAIL("Page callback was not called");
+
+  if (oggz_get_reverse_buffered_bytes (reader) <= 0)
+    FAIL("No packets were reverse buffered");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
@@ -0,0 +1,368 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN 16384
+
+#define NR_PACKETS 100
+#define PACKET_LEN 32
+
+/* A single 20ms CELT-only Opus frame is 960 samples at 48kHz */
+#define OPUS_TOC 0xf8
+#define OPUS_FRAME 960
+
+static long serialno;
+static int read_iter = 0;
+static int held_batches = 0;
+static int page_batches = 0;
+
+/* Sequence number of the last data packet delivered from either stream
+ * of the interleaved test */
+static int last_seq = -1;
+
+static unsigned char opus_head[19] = {
+  'O', 'p', 'u', 's', 'H', 'e', 'a', 'd',
+  1, 1, 0, 0, 0x80, 0xbb, 0, 0, 0, 0, 0
+};
+
+static unsigned char opus_tags[16] = {
+  'O', 'p', 'u', 's', 'T', 'a', 'g', 's',
+  0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+  int flush = 0;
+
+  if (iter >= NR_PACKETS + 2) return 1;
+
+  memset (&op, 0, sizeof (op));
+
+  if (iter == 0) {
+    op.packet = opus_head;
+    op.bytes = sizeof (opus_head);
+    op.b_o_s = 1;
+    op.granulepos = 0;
+    flush = OGGZ_FLUSH_AFTER;
+  } else if (iter == 1) {
+    op.packet = opus_tags;
+    op.bytes = sizeof (opus_tags);
+    op.granulepos = 0;
+    flush = OGGZ_FLUSH_AFTER;
+  } else {
+    memset (buf, iter, PACKET_LEN);
+    buf[0] = OPUS_TOC;
+    op.packet = buf;
+    op.bytes = PACKET_LEN;
+    op.granulepos = (iter - 1) * OPUS_FRAME;
+    op.e_o_s = (iter == NR_PACKETS + 1);
+    /* Several pages, so that reverse buffered and directly delivered
+     * packets are interleaved */
+    if (iter % 10 == 0) flush = OGGZ_FLUSH_AFTER;
+  }
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packets (OGGZ * oggz, const ogg_page * og, oggz_packet * packets, int n,
+              long serialno, void * user_data)
+{
+  ogg_packet * op;
+  int i;
+
+#ifdef DEBUG
+  printf ("batch of %d packets, page %p\n", n, (void *)og);
+#endif
+
+  if (n <= 0)
+    FAIL ("Empty batch delivered");
+
+  if (og == NULL) {
+    held_batches++;
+  } else {
+    /* Packets of a page which were held back are delivered separately */
+    if (ogg_page_packets ((ogg_page *)og) < n)
+      FAIL ("Batch contains more packets than its page");
+    if (ogg_page_packets ((ogg_page *)og) == n)
+      page_batches++;
+  }
+
+  for (i = 0; i < n; i++) {
+    op = &packets[i].op;
+
+    if (op->packetno != read_iter)
+      FAIL ("Packet delivered out of order");
+
+    if (read_iter >= 2) {
+      if (op->bytes != PACKET_LEN || op->packet[0] != OPUS_TOC ||
+          op->packet[PACKET_LEN-1] != (unsigned char)read_iter)
+        FAIL ("Packet contains incorrect data");
+
+      if (packets[i].pos.calc_granulepos != (read_iter - 1) * OPUS_FRAME)
+        FAIL ("Packet has incorrect calculated granulepos");
+    }
+
+    read_iter++;
+  }
+
+  return 0;
+}
+
+static void
+feed (OGGZ * oggz, long s, ogg_packet * op, int flush)
+{
+  if (oggz_write_feed (oggz, op, s, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+}
+
+static void
+feed_header (OGGZ * oggz, long s, int packetno)
+{
+  ogg_packet op;
+
+  memset (&op, 0, sizeof (op));
+  if (packetno == 0) {
+    op.packet = opus_head;
+    op.bytes = sizeof (opus_head);
+    op.b_o_s = 1;
+  } else {
+    op.packet = opus_tags;
+    op.bytes = sizeof (opus_tags);
+  }
+  op.packetno = packetno;
+  feed (oggz, s, &op, OGGZ_FLUSH_AFTER);
+}
+
+/*
+ * Feed one page of data packets numbered [from, to) on stream s, tagging
+ * each with the next sequence number. If known is zero the packets carry
+ * no granulepos, so the reader must hold them until a later page.
+ */
+static void
+feed_page (OGGZ * oggz, long s, int from, int to, int known, int * seq)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  int i;
+
+  for (i = from; i < to; i++) {
+    memset (&op, 0, sizeof (op));
+    memset (buf, 0, PACKET_LEN);
+    buf[0] = OPUS_TOC;
+    buf[1] = (unsigned char)(*seq)++;
+    op.packet = buf;
+    op.bytes = PACKET_LEN;
+    op.granulepos = known ? (i - 1) * OPUS_FRAME : -1;
+    op.packetno = i;
+    feed (oggz, s, &op, (i == to - 1) ? OGGZ_FLUSH_AFTER : 0);
+  }
+}
+
+static void
+check_seq (ogg_packet * op)
+{
+  if (op->bytes != PACKET_LEN || op->packet[0] != OPUS_TOC) return;
+
+  if (op->packet[1] != last_seq + 1)
+    FAIL ("Packets of batched and unbatched streams delivered out of order");
+
+  last_seq = op->packet[1];
+}
+
+static int
+interleaved_packets (OGGZ * oggz, const ogg_page * og, oggz_packet * packets,
+                     int n, long serialno, void * user_data)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    check_seq (&packets[i].op);
+
+  return 0;
+}
+
+static int
+interleaved_packet (OGGZ * oggz, oggz_packet * zp, long serialno,
+                    void * user_data)
+{
+  check_seq (&zp->op);
+
+  return 0;
+}
+
+/* Attach the packet callback once the stream has been identified */
+static int
+interleaved_page (OGGZ * oggz, const ogg_page * og, long serialno,
+                  void * user_data)
+{
+  long * unbatched = (long *)user_data;
+
+  if (serialno == *unbatched && ogg_page_bos ((ogg_page *)og)) {
+    if (oggz_set_read_callback (oggz, serialno, interleaved_packet,
+                                NULL) != 0)
+      FAIL("Could not set packet callback");
+  }
+
+  return 0;
+}
+
+static void
+test_interleaved (void)
+{
+  OGGZ * reader, * writer;
+  unsigned char data_buf[DATA_BUF_LEN];
+  long batched, unbatched, n;
+  int seq = 0;
+
+  INFO ("+ Interleaving batched and unbatched streams");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  batched = oggz_serialno_new (writer);
+  unbatched = oggz_serialno_new (writer);
+
+  feed_header (writer, batched, 0);
+  feed_header (writer, unbatched, 0);
+  feed_header (writer, batched, 1);
+  feed_header (writer, unbatched, 1);
+
+  /* The first data page of the batched stream is held back until its
+   * second page, so the unbatched page between them is held too */
+  feed_page (writer, batched, 2, 6, 0, &seq);
+  feed_page (writer, unbatched, 2, 6, 1, &seq);
+  feed_page (writer, batched, 6, 10, 1, &seq);
+  feed_page (writer, unbatched, 6, 10, 1, &seq);
+
+  n = oggz_write_output (writer, data_buf, DATA_BUF_LEN);
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ | OGGZ_AUTO);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  if (oggz_set_read_packets (reader, -1, interleaved_packets, NULL) != 0)
+    FAIL("Could not set batch callback");
+
+  if (oggz_set_read_page (reader, -1, interleaved_page, &unbatched) != 0)
+    FAIL("Could not set page callback");
+
+  if (oggz_read_input (reader, data_buf, n) != n)
+    FAIL("Could not read generated data");
+
+  if (last_seq != seq - 1)
+    FAIL("Incorrect number of packets read");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  unsigned char data_buf[DATA_BUF_LEN];
+  long n;
+
+  INFO ("Testing delivery of packets in batches per page");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  n = oggz_write_output (writer, data_buf, DATA_BUF_LEN);
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ | OGGZ_AUTO);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  if (oggz_set_read_packets (reader, -1, read_packets, NULL) != 0)
+    FAIL("Could not set batch callback");
+
+  if (oggz_read_input (reader, data_buf, n) != n)
+    FAIL("Could not read generated data");
+
+  if (read_iter != NR_PACKETS + 2)
+    FAIL("Incorrect number of packets read");
+
+  if (held_batches == 0)
+    FAIL("Reverse buffered packets were not delivered as a batch");
+
+  if (page_batches == 0)
+    FAIL("No page was delivered as a single batch");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  test_interleaved ();
+
+  exit (0);
+}
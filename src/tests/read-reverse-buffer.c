@@ -0,0 +1,180 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN 16384
+
+#define NR_PACKETS 100
+#define PACKET_LEN 32
+
+/* A single 20ms CELT-only Opus frame is 960 samples at 48kHz */
+#define OPUS_TOC 0xf8
+#define OPUS_FRAME 960
+
+static long serialno;
+static int read_iter = 0;
+
+static unsigned char opus_head[19] = {
+  'O', 'p', 'u', 's', 'H', 'e', 'a', 'd',
+  1, 1, 0, 0, 0x80, 0xbb, 0, 0, 0, 0, 0
+};
+
+static unsigned char opus_tags[16] = {
+  'O', 'p', 'u', 's', 'T', 'a', 'g', 's',
+  0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+  int flush = 0;
+
+  if (iter >= NR_PACKETS + 2) return 1;
+
+  memset (&op, 0, sizeof (op));
+
+  if (iter == 0) {
+    op.packet = opus_head;
+    op.bytes = sizeof (opus_head);
+    op.b_o_s = 1;
+    op.granulepos = 0;
+    flush = OGGZ_FLUSH_AFTER;
+  } else if (iter == 1) {
+    op.packet = opus_tags;
+    op.bytes = sizeof (opus_tags);
+    op.granulepos = 0;
+    flush = OGGZ_FLUSH_AFTER;
+  } else {
+    memset (buf, iter, PACKET_LEN);
+    buf[0] = OPUS_TOC;
+    op.packet = buf;
+    op.bytes = PACKET_LEN;
+    op.granulepos = (iter - 1) * OPUS_FRAME;
+    op.e_o_s = (iter == NR_PACKETS + 1);
+  }
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+
+#ifdef DEBUG
+  printf ("packetno %" PRId64 ": calc_granulepos %" PRId64 "\n",
+          op->packetno, zp->pos.calc_granulepos);
+#endif
+
+  if (op->packetno != read_iter)
+    FAIL ("Packet delivered out of order");
+
+  if (read_iter >= 2) {
+    if (op->bytes != PACKET_LEN || op->packet[0] != OPUS_TOC ||
+        op->packet[PACKET_LEN-1] != (unsigned char)read_iter)
+      FAIL ("Packet contains incorrect data");
+
+    if (zp->pos.calc_granulepos != (read_iter - 1) * OPUS_FRAME)
+      FAIL ("Packet has incorrect calculated granulepos");
+  }
+
+  read_iter++;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  unsigned char data_buf[DATA_BUF_LEN];
+  long n;
+
+  INFO ("Testing reverse buffering of packets without granulepos");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  n = oggz_write_output (writer, data_buf, DATA_BUF_LEN);
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ | OGGZ_AUTO);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  if (oggz_read_input (reader, data_buf, n) != n)
+    FAIL("Could not read generated data");
+
+  if (read_iter != NR_PACKETS + 2)
+    FAIL("Incorrect number of packets read");
+
+  if (oggz_get_reverse_buffered_bytes (reader) <= 0)
+    FAIL("No packets were reverse buffered");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
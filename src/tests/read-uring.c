@@ -0,0 +1,186 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 4000
+#define PACKET_LEN 200
+#define DATA_BUF_LEN (NR_PACKETS * (PACKET_LEN + 8))
+
+static long serialno;
+static int read_iter = 0;
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static long data_len = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, PACKET_LEN);
+
+  op.packet = buf;
+  op.bytes = PACKET_LEN;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+
+  if (op->packetno != read_iter)
+    FAIL ("Packet has incorrect packetno");
+
+  if (op->bytes != PACKET_LEN || op->packet[PACKET_LEN-1] != (read_iter & 0xff))
+    FAIL ("Packet contains incorrect data");
+
+  read_iter++;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  FILE * file;
+  long n;
+  int ret;
+
+  INFO ("Testing reading via io_uring");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data_buf + data_len,
+                                 DATA_BUF_LEN - data_len)) > 0) {
+    data_len += n;
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  if ((file = tmpfile ()) == NULL)
+    FAIL("Could not create temporary file");
+
+  if (fwrite (data_buf, 1, data_len, file) != (size_t)data_len)
+    FAIL("Could not write temporary file");
+
+  fflush (file);
+  rewind (file);
+
+  reader = oggz_open_stdio (file, OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  ret = oggz_io_set_uring (reader, 4);
+  if (ret == OGGZ_ERR_DISABLED || ret == OGGZ_ERR_SYSTEM) {
+    INFO ("io_uring not available; skipping");
+    oggz_close (reader);
+    exit (0);
+  } else if (ret != 0) {
+    FAIL("Could not enable io_uring");
+  }
+
+  /* Read part of the data, then continue with ordinary reads */
+  while (read_iter < NR_PACKETS / 3) {
+    if ((n = oggz_read (reader, 4096)) <= 0)
+      FAIL("Read failed");
+  }
+
+  if (oggz_io_set_uring (reader, 0) != 0)
+    FAIL("Could not disable io_uring");
+
+  while ((n = oggz_read (reader, 4096)) > 0);
+
+  if (read_iter != NR_PACKETS)
+    FAIL("Data was lost when disabling io_uring");
+
+  /* Seek within the file, then read everything again from the start */
+  if (oggz_io_set_uring (reader, 2) != 0)
+    FAIL("Could not enable io_uring");
+
+  if (oggz_seek (reader, data_len / 2, SEEK_SET) < 0)
+    FAIL("Could not seek to middle");
+
+  if (oggz_seek (reader, 0, SEEK_SET) != 0)
+    FAIL("Could not seek to start");
+
+  read_iter = 0;
+
+  while ((n = oggz_read (reader, 4096)) > 0);
+
+  if (n != 0)
+    FAIL("Read failed");
+
+  if (read_iter != NR_PACKETS)
+    FAIL("Incorrect number of packets read via io_uring");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
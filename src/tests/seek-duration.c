@@ -0,0 +1,211 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+/* An audio track of 40ms packets and a sparse text track, both in
+ * milliseconds, after a Skeleton track with a presentation time */
+#define NR_PACKETS 4000
+#define PACKET_MS 40
+#define PACKET_LEN 200
+#define TEXT_INTERVAL 25
+#define PRESENTATION_TIME 2000
+
+#define DATA_BUF_LEN (NR_PACKETS * (PACKET_LEN + 64) + 8192)
+
+#define FISHEAD_LEN 64
+
+static long skeleton_serialno, audio_serialno, text_serialno;
+
+static long audio_packets = 0;
+
+static void
+put_le_64 (unsigned char * c, ogg_int64_t v)
+{
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    c[i] = (v >> (i * 8)) & 0xff;
+  }
+}
+
+static void
+feed (OGGZ * writer, unsigned char * buf, long bytes, long serial,
+      int b_o_s, int e_o_s, ogg_int64_t granulepos, ogg_int64_t packetno,
+      int flush)
+{
+  ogg_packet op;
+
+  op.packet = buf;
+  op.bytes = bytes;
+  op.b_o_s = b_o_s;
+  op.e_o_s = e_o_s;
+  op.granulepos = granulepos;
+  op.packetno = packetno;
+
+  if (oggz_write_feed (writer, &op, serial, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  test_generate (writer, NULL, DATA_BUF_LEN);
+}
+
+static void
+generate (void)
+{
+  OGGZ * writer;
+  unsigned char fishead[FISHEAD_LEN], buf[PACKET_LEN];
+  long i, text_packets = 0;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  skeleton_serialno = oggz_serialno_new (writer);
+  audio_serialno = oggz_serialno_new (writer);
+  text_serialno = oggz_serialno_new (writer);
+
+  memset (fishead, 0, FISHEAD_LEN);
+  memcpy (fishead, "fishead\0", 8);
+  fishead[8] = 3; /* version 3.0 */
+  put_le_64 (&fishead[12], PRESENTATION_TIME);
+  put_le_64 (&fishead[20], 1000); /* presentation time denominator */
+  put_le_64 (&fishead[36], 1000); /* basetime denominator */
+
+  memset (buf, 0, PACKET_LEN);
+
+  feed (writer, fishead, FISHEAD_LEN, skeleton_serialno, 1, 0, 0, 0,
+        OGGZ_FLUSH_AFTER);
+  feed (writer, buf, 10, audio_serialno, 1, 0, 0, 0, OGGZ_FLUSH_AFTER);
+  feed (writer, buf, 10, text_serialno, 1, 0, 0, 0, OGGZ_FLUSH_AFTER);
+  feed (writer, buf, 0, skeleton_serialno, 0, 1, 0, 1, OGGZ_FLUSH_AFTER);
+
+  /* The text track's last packet is well before the end of the file */
+  for (i = 1; i <= NR_PACKETS; i++) {
+    feed (writer, buf, PACKET_LEN, audio_serialno, 0, (i == NR_PACKETS),
+          i * PACKET_MS, i, OGGZ_FLUSH_AFTER);
+    if (i % TEXT_INTERVAL == 0 && i < NR_PACKETS - 4 * TEXT_INTERVAL) {
+      text_packets++;
+      feed (writer, buf, 20, text_serialno, 0,
+            (i + TEXT_INTERVAL >= NR_PACKETS - 4 * TEXT_INTERVAL),
+            i * PACKET_MS, text_packets, OGGZ_FLUSH_AFTER);
+    }
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  if (serialno == audio_serialno && zp->op.bytes == PACKET_LEN)
+    audio_packets++;
+
+  return 0;
+}
+
+static int
+read_headers (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return (serialno == audio_serialno && zp->op.bytes == PACKET_LEN) ?
+    OGGZ_STOP_OK : OGGZ_CONTINUE;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  test_file f;
+  ogg_int64_t duration;
+  long header_bytes;
+
+  INFO ("Testing oggz_get_duration()");
+
+  generate ();
+
+  /* Read up to the first data packet, then describe the tracks which
+   * Oggz does not recognise */
+  reader = test_open_reader (&f, OGGZ_READ | OGGZ_AUTO, read_headers, NULL);
+  while (oggz_read (reader, 1024) > 0);
+
+  if (oggz_set_granulerate (reader, audio_serialno, 1, 1) != 0 ||
+      oggz_set_granulerate (reader, text_serialno, 1, 1) != 0)
+    FAIL("Could not set stream metrics");
+
+  INFO ("+ Reading the duration from the end of the file");
+
+  header_bytes = f.bytes_read;
+
+  duration = oggz_get_duration (reader);
+
+#ifdef DEBUG
+  printf ("duration %lld, %ld bytes read\n", duration,
+          f.bytes_read - header_bytes);
+#endif
+
+  if (duration != NR_PACKETS * PACKET_MS - PRESENTATION_TIME)
+    FAIL("Incorrect duration");
+
+  /* Only the tail back to the text track's last page need be read */
+  if (f.bytes_read - header_bytes > data_len / 8)
+    FAIL("Read too much data to find the duration");
+
+  INFO ("+ Reading on after finding the duration");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+  while (oggz_read (reader, 1024) > 0);
+
+  if (audio_packets < NR_PACKETS - 1)
+    FAIL("Did not read on from the position before the call");
+
+  oggz_close (reader);
+
+  INFO ("+ Finding the duration with a writer");
+
+  reader = oggz_new (OGGZ_WRITE);
+  if (oggz_get_duration (reader) != OGGZ_ERR_INVALID)
+    FAIL("Finding the duration of a writer did not fail");
+  oggz_close (reader);
+
+  exit (0);
+}
@@ -0,0 +1,329 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 2000
+#define PACKET_LEN 300
+#define DATA_BUF_LEN (NR_PACKETS * (PACKET_LEN + 8))
+
+#define INDEX_TEST_FILE "seek-index-test.ogg"
+#define INDEX_TEST_INDEX_FILE INDEX_TEST_FILE OGGZ_SEEK_INDEX_SUFFIX
+
+static long serialno;
+
+static long first_packetno = -1;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, PACKET_LEN);
+
+  op.packet = buf;
+  op.bytes = PACKET_LEN;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return 0;
+}
+
+static int
+read_first_packet (OGGZ * oggz, oggz_packet * zp, long serialno,
+                   void * user_data)
+{
+  first_packetno = zp->op.packetno;
+
+  return OGGZ_STOP_OK;
+}
+
+static void
+write_file (const char * filename, const char * mode,
+            const unsigned char * buf, long n)
+{
+  FILE * file;
+
+  if ((file = fopen (filename, mode)) == NULL)
+    FAIL("Could not open test file");
+
+  if (fwrite (buf, 1, n, file) != (size_t)n)
+    FAIL("Could not write test file");
+
+  fclose (file);
+}
+
+/* Seek to units and return the packetno of the first packet then read;
+ * *seek_reads is set to the number of reads made while seeking */
+static long
+seek_and_read (OGGZ * reader, ogg_int64_t units, ogg_int64_t * result,
+               int * seek_reads)
+{
+  test_file * f = (test_file *)oggz_io_get_read_user_handle (reader);
+  int i;
+
+  oggz_set_read_callback (reader, -1, read_first_packet, NULL);
+
+  /* Clear the OGGZ_STOP_OK held over from the previous read */
+  oggz_read (reader, 0);
+
+  *seek_reads = f->reads;
+
+  if ((*result = oggz_seek_units (reader, units, SEEK_SET)) < 0)
+    FAIL("Seek failed");
+
+  *seek_reads = f->reads - *seek_reads;
+
+  first_packetno = -1;
+  for (i = 0; first_packetno == -1 && i < 16; i++)
+    oggz_read (reader, 1024);
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  return first_packetno;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * indexed, * bisected, * imported;
+  test_file f_indexed, f_bisected, f_imported;
+  unsigned char * index_buf, * empty_buf, saved[8];
+  ogg_int64_t units, r_indexed, r_bisected, r_imported;
+  long index_len, empty_len;
+  long p_indexed, p_bisected, p_imported;
+  int i, seek_reads;
+
+  INFO ("Testing seeking with a seek index");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  test_generate (writer, hungry, DATA_BUF_LEN);
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  /* A reader which has read all the data, and so indexed it */
+  indexed = test_open_reader (&f_indexed, OGGZ_READ, read_packet, NULL);
+  if (oggz_seek_index_enable (indexed) != 0)
+    FAIL("Could not enable seek index");
+  while (oggz_read (indexed, 4096) > 0);
+  oggz_set_granulerate (indexed, serialno, 1, 1);
+
+  index_len = oggz_seek_index_export (indexed, NULL, 0);
+  if (index_len <= 0)
+    FAIL("Could not query index size");
+
+  index_buf = malloc (index_len);
+  if (oggz_seek_index_export (indexed, index_buf, index_len) != index_len)
+    FAIL("Could not export index");
+
+  /* A reader which has read only the headers, and must bisect */
+  bisected = test_open_reader (&f_bisected, OGGZ_READ, read_packet, NULL);
+  oggz_read (bisected, 1024);
+  oggz_set_granulerate (bisected, serialno, 1, 1);
+
+  empty_len = oggz_seek_index_export (writer = oggz_new (OGGZ_READ), NULL, 0);
+  empty_buf = malloc (empty_len);
+  oggz_seek_index_export (writer, empty_buf, empty_len);
+  oggz_close (writer);
+
+  /* Without oggz_seek_index_enable(), reading records nothing */
+  writer = test_open_reader (&f_imported, OGGZ_READ, read_packet, NULL);
+  while (oggz_read (writer, 4096) > 0);
+  if (oggz_seek_index_export (writer, NULL, 0) != empty_len)
+    FAIL("Seek index recorded without being enabled");
+  oggz_close (writer);
+
+  if (oggz_seek_index_import (bisected, empty_buf, empty_len) != 0)
+    FAIL("Could not import empty index");
+
+  /* A reader which has read only the headers, and imported the index */
+  imported = test_open_reader (&f_imported, OGGZ_READ, read_packet, NULL);
+  oggz_read (imported, 1024);
+  oggz_set_granulerate (imported, serialno, 1, 1);
+
+  if (oggz_seek_index_import (imported, index_buf, index_len / 2) == 0)
+    FAIL("Truncated index was accepted");
+
+  if (oggz_seek_index_import (imported, index_buf, index_len) != 0)
+    FAIL("Could not import index");
+
+  INFO ("+ Comparing seeks with and without the index");
+
+  for (i = 0; i < 40; i++) {
+    units = (i * 997) % (NR_PACKETS - 50) + 1;
+
+    p_bisected = seek_and_read (bisected, units, &r_bisected, &seek_reads);
+    if (seek_reads == 0)
+      FAIL("Seek without an index made no reads");
+
+    p_indexed = seek_and_read (indexed, units, &r_indexed, &seek_reads);
+    if (seek_reads != 0)
+      FAIL("Seek using index made probe reads");
+
+    p_imported = seek_and_read (imported, units, &r_imported, &seek_reads);
+    if (seek_reads != 0)
+      FAIL("Seek using imported index made probe reads");
+
+    if (p_bisected == -1)
+      FAIL("No packet read after seeking");
+
+    if (r_indexed > units || r_imported != r_indexed)
+      FAIL("Indexed seek returned incorrect units");
+
+    if (p_indexed != p_bisected || p_imported != p_bisected)
+      FAIL("Indexed seek went to incorrect position");
+  }
+
+  INFO ("+ Using a seek index file");
+
+  write_file (INDEX_TEST_FILE, "wb", data_buf, data_len);
+
+  /* An index exported through I/O callbacks records no file size, and
+   * is not trusted as a seek index file */
+  write_file (INDEX_TEST_INDEX_FILE, "wb", index_buf, index_len);
+
+  if ((writer = oggz_open (INDEX_TEST_FILE, OGGZ_READ)) == NULL)
+    FAIL("Could not open test file");
+
+  if (oggz_seek_index_export (writer, NULL, 0) != empty_len)
+    FAIL("Seek index file without file size was used");
+
+  oggz_close (writer);
+
+  if ((writer = oggz_open (INDEX_TEST_FILE, OGGZ_READ)) == NULL)
+    FAIL("Could not open test file");
+
+  oggz_seek_index_enable (writer);
+  while (oggz_read (writer, 4096) > 0);
+
+  free (index_buf);
+  index_len = oggz_seek_index_export (writer, NULL, 0);
+  index_buf = malloc (index_len);
+  if (oggz_seek_index_export (writer, index_buf, index_len) != index_len)
+    FAIL("Could not export index");
+
+  oggz_close (writer);
+
+  write_file (INDEX_TEST_INDEX_FILE, "wb", index_buf, index_len);
+
+  if ((writer = oggz_open (INDEX_TEST_FILE, OGGZ_READ)) == NULL)
+    FAIL("Could not open test file");
+
+  if (oggz_seek_index_export (writer, NULL, 0) != index_len)
+    FAIL("Seek index file was not used");
+
+  oggz_read (writer, 1024);
+  oggz_set_granulerate (writer, serialno, 1, 1);
+
+  for (i = 0; i < 10; i++) {
+    units = (i * 997) % (NR_PACKETS - 50) + 1;
+
+    r_indexed = oggz_seek_units (indexed, units, SEEK_SET);
+    if (oggz_seek_units (writer, units, SEEK_SET) != r_indexed)
+      FAIL("Seek using index file returned incorrect units");
+  }
+
+  oggz_close (writer);
+
+  /* A seek index file with an invalid entry is not used */
+  memcpy (saved, index_buf + index_len - 8, 8);
+  memset (index_buf + index_len - 8, 0xff, 8);
+  write_file (INDEX_TEST_INDEX_FILE, "wb", index_buf, index_len);
+
+  if ((writer = oggz_open (INDEX_TEST_FILE, OGGZ_READ)) == NULL)
+    FAIL("Could not open test file");
+
+  if (oggz_seek_index_export (writer, NULL, 0) != empty_len)
+    FAIL("Invalid seek index file was used");
+
+  oggz_close (writer);
+
+  memcpy (index_buf + index_len - 8, saved, 8);
+  write_file (INDEX_TEST_INDEX_FILE, "wb", index_buf, index_len);
+
+  /* Appending to the file invalidates its seek index file */
+  write_file (INDEX_TEST_FILE, "ab", data_buf, 1);
+
+  if ((writer = oggz_open (INDEX_TEST_FILE, OGGZ_READ)) == NULL)
+    FAIL("Could not open test file");
+
+  if (oggz_seek_index_export (writer, NULL, 0) == index_len)
+    FAIL("Stale seek index file was used");
+
+  oggz_close (writer);
+
+  remove (INDEX_TEST_INDEX_FILE);
+  remove (INDEX_TEST_FILE);
+
+  free (index_buf);
+  free (empty_buf);
+
+  if (oggz_close (indexed) != 0 || oggz_close (bisected) != 0 ||
+      oggz_close (imported) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
@@ -0,0 +1,204 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 6000
+#define HEADER_LEN 300000
+#define DATA_BUF_LEN (HEADER_LEN + NR_PACKETS * 1100)
+
+#define NR_TARGETS 100
+
+static long serialno;
+
+/* Packets are small and large in turn for every 1000, as in variable
+ * bitrate video, following a large header */
+static long
+packet_len (int iter)
+{
+  if (iter == 0) return HEADER_LEN;
+
+  return ((iter / 1000) % 2) ? 1000 + (iter % 7) * 10 : 20 + (iter % 5);
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[HEADER_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, packet_len (iter));
+
+  op.packet = buf;
+  op.bytes = packet_len (iter);
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return 0;
+}
+
+static int
+read_first_data_packet (OGGZ * oggz, oggz_packet * zp, long serialno,
+                        void * user_data)
+{
+  return (zp->op.packetno > 0) ? OGGZ_STOP_OK : OGGZ_CONTINUE;
+}
+
+static OGGZ *
+open_reader (test_file * f)
+{
+  OGGZ * reader;
+
+  reader = test_open_reader (f, OGGZ_READ, read_packet, NULL);
+
+  /* Read the header page */
+  oggz_read (reader, HEADER_LEN + 1024);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  return reader;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * reader;
+  OggzSeekStats stats;
+  test_file f;
+  ogg_int64_t units, result;
+  oggz_off_t data_start;
+  long probes = 0;
+  ogg_int64_t bytes_read = 0;
+  int i;
+
+  INFO ("Testing interpolation search");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  test_generate (writer, hungry, DATA_BUF_LEN);
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  INFO ("+ Seeking in variable bitrate data");
+
+  for (i = 0; i < NR_TARGETS; i++) {
+    units = (i * 3989) % (NR_PACKETS - 20) + 10;
+
+    reader = open_reader (&f);
+
+    if ((result = oggz_seek_units (reader, units, SEEK_SET)) < 0)
+      FAIL("Seek failed");
+
+    /* Pages of small packets hold up to 255 of them */
+    if (result > units || result < units - 255)
+      FAIL("Seek returned incorrect units");
+
+    if (oggz_seek_get_stats (reader, &stats) != 0)
+      FAIL("Could not get seek stats");
+
+    if (stats.seeks != 1 || stats.last_probes == 0 ||
+        stats.last_probes > stats.probes ||
+        stats.last_bytes_read == 0 ||
+        stats.last_bytes_read > stats.bytes_read)
+      FAIL("Inconsistent seek stats");
+
+    probes += stats.last_probes;
+    bytes_read += stats.last_bytes_read;
+
+    oggz_close (reader);
+  }
+
+#ifdef DEBUG
+  printf ("per seek: %ld probes, %lld bytes read\n",
+          probes / NR_TARGETS, bytes_read / NR_TARGETS);
+#endif
+
+  if (probes / NR_TARGETS > 40)
+    FAIL("Seeks made too many probes");
+
+  /* Scanning would read half of the data on average */
+  if (bytes_read / NR_TARGETS > data_len / 8)
+    FAIL("Seeks read too much data");
+
+  INFO ("+ Skipping headers before the data start");
+
+  /* Read up to the first data packet */
+  reader = test_open_reader (&f, OGGZ_READ, read_first_data_packet, NULL);
+  while (oggz_read (reader, 1024) > 0);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  data_start = oggz_tell (reader);
+  oggz_set_data_start (reader, data_start);
+
+  for (units = 1; units < 400; units += 7) {
+    if ((result = oggz_seek_units (reader, units, SEEK_SET)) < 0)
+      FAIL("Seek after the data start failed");
+
+    if (result > units || oggz_tell (reader) < data_start)
+      FAIL("Seek after the data start returned incorrect position");
+  }
+
+  oggz_close (reader);
+
+  exit (0);
+}
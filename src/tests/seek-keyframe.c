@@ -0,0 +1,203 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+/* A video stream at 25 frames per second with a keyframe every GOP_LEN
+ * frames, interleaved with an audio stream of 40ms packets needing a
+ * preroll of AUDIO_PREROLL packets. Units are milliseconds. */
+#define NR_FRAMES 3000
+#define GOP_LEN 30
+#define GRANULESHIFT 6
+#define FRAME_MS 40
+#define AUDIO_PREROLL 2
+
+#define DATA_BUF_LEN (NR_FRAMES * 2000)
+
+static long video_serialno, audio_serialno;
+
+typedef struct {
+  long first_frame;
+  long first_audio;
+} first_packets;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[4000];
+  ogg_packet op;
+  static int iter = 0;
+  long serialno, n, keyframe;
+  int flush;
+
+  if (iter >= NR_FRAMES * 2) return 1;
+
+  n = iter / 2;
+  memset (buf, 0, sizeof (buf));
+  buf[0] = (n >> 8) & 0xff;
+  buf[1] = n & 0xff;
+
+  op.packet = buf;
+  op.b_o_s = (n == 0);
+  op.e_o_s = (n == NR_FRAMES - 1);
+  op.packetno = n;
+
+  if (iter % 2 == 0) {
+    serialno = video_serialno;
+    keyframe = n - (n % GOP_LEN);
+    op.bytes = (n == keyframe) ? 3000 : 200 + (n % 11) * 50;
+    op.granulepos = (keyframe << GRANULESHIFT) | (n - keyframe);
+    flush = OGGZ_FLUSH_AFTER;
+  } else {
+    serialno = audio_serialno;
+    op.bytes = 160;
+    op.granulepos = n * FRAME_MS;
+    flush = (n == 0 || n % 3 == 2) ? OGGZ_FLUSH_AFTER : 0;
+  }
+
+  if (oggz_write_feed (oggz, &op, serialno, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  first_packets * first = (first_packets *)user_data;
+  long n;
+
+  if (first == NULL) return OGGZ_CONTINUE;
+
+  n = (zp->op.packet[0] << 8) | zp->op.packet[1];
+
+  if (serialno == video_serialno && first->first_frame == -1)
+    first->first_frame = n;
+  else if (serialno == audio_serialno && first->first_audio == -1)
+    first->first_audio = n;
+
+  if (first->first_frame != -1 && first->first_audio != -1)
+    return OGGZ_STOP_OK;
+
+  return OGGZ_CONTINUE;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * reader;
+  test_file f;
+  first_packets first;
+  ogg_int64_t units, result;
+  long frame, keyframe;
+
+  INFO ("Testing keyframe seeking");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  video_serialno = oggz_serialno_new (writer);
+  audio_serialno = oggz_serialno_new (writer);
+
+  test_generate (writer, hungry, DATA_BUF_LEN);
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = test_open_reader (&f, OGGZ_READ, read_packet, NULL);
+
+  /* Read the b_o_s pages, then describe both streams */
+  oggz_read (reader, 8192);
+
+  if (oggz_set_granulerate (reader, video_serialno, 1, FRAME_MS) != 0 ||
+      oggz_set_granuleshift (reader, video_serialno, GRANULESHIFT) != 0 ||
+      oggz_set_granulerate (reader, audio_serialno, 1, 1) != 0 ||
+      oggz_set_preroll (reader, audio_serialno, AUDIO_PREROLL) != 0)
+    FAIL("Could not set stream metrics");
+
+  INFO ("+ Seeking to the keyframe and preroll before a target");
+
+  oggz_set_read_callback (reader, -1, read_packet, &first);
+
+  for (units = 500; units < (NR_FRAMES - GOP_LEN) * FRAME_MS;
+       units += 3989) {
+    frame = units / FRAME_MS;
+    keyframe = frame - (frame % GOP_LEN);
+
+    if ((result = oggz_seek_keyframe (reader, units)) < 0)
+      FAIL("Keyframe seek failed");
+
+    if (result > units)
+      FAIL("Keyframe seek returned a unit after the target");
+
+    first.first_frame = -1;
+    first.first_audio = -1;
+
+    while (oggz_read (reader, 1024) > 0);
+
+#ifdef DEBUG
+    printf ("target %lld (frame %ld, keyframe %ld): %lld, "
+            "first frame %ld, first audio %ld\n",
+            units, frame, keyframe, result,
+            first.first_frame, first.first_audio);
+#endif
+
+    if (first.first_frame == -1 || first.first_frame > keyframe)
+      FAIL("Keyframe seek did not reach the keyframe");
+
+    /* Landing on a page or two early is fine, a whole GOP is not */
+    if (first.first_frame <= keyframe - GOP_LEN)
+      FAIL("Keyframe seek went back too far");
+
+    if (first.first_audio == -1 ||
+        first.first_audio > frame - AUDIO_PREROLL)
+      FAIL("Keyframe seek did not include the audio preroll");
+  }
+
+  oggz_close (reader);
+
+  exit (0);
+}
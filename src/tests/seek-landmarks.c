@@ -0,0 +1,205 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 4000
+#define PACKET_LEN 300
+#define DATA_BUF_LEN (NR_PACKETS * (PACKET_LEN + 8))
+
+#define NR_TARGETS 20
+
+static long serialno;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, PACKET_LEN);
+
+  op.packet = buf;
+  op.bytes = PACKET_LEN;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return 0;
+}
+
+/* Open a reader which has read only the headers, and so must bisect */
+static OGGZ *
+open_reader (test_file * f)
+{
+  OGGZ * reader;
+
+  reader = test_open_reader (f, OGGZ_READ, read_packet, NULL);
+
+  oggz_read (reader, 1024);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  return reader;
+}
+
+/* Seek to units, checking the result; returns the number of reads made */
+static int
+seek_units (OGGZ * reader, ogg_int64_t units, int whence,
+            ogg_int64_t * result)
+{
+  test_file * f = (test_file *)oggz_io_get_read_user_handle (reader);
+  int seek_reads = f->reads;
+
+  *result = oggz_seek_units (reader, units, whence);
+  if (*result < 0)
+    FAIL("Seek failed");
+
+  if (whence == SEEK_SET && *result > units)
+    FAIL("Seek went past target");
+
+  return f->reads - seek_reads;
+}
+
+static ogg_int64_t
+target (int i)
+{
+  return (i * 1597) % (NR_PACKETS - 100) + 50;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * cached, * fresh;
+  test_file f_cached, f_fresh;
+  ogg_int64_t units, r_cached, r_fresh;
+  int i, reads_again = 0, reads_fresh = 0;
+  int reads_end;
+
+  INFO ("Testing seeking with seek landmarks");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  test_generate (writer, hungry, DATA_BUF_LEN);
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  cached = open_reader (&f_cached);
+
+  INFO ("+ Revisiting earlier seek targets");
+
+  for (i = 0; i < NR_TARGETS; i++) {
+    seek_units (cached, target (i), SEEK_SET, &r_cached);
+  }
+
+  for (i = 0; i < NR_TARGETS; i++) {
+    units = target (i) + 7;
+
+    reads_again += seek_units (cached, units, SEEK_SET, &r_cached);
+
+    fresh = open_reader (&f_fresh);
+    reads_fresh += seek_units (fresh, units, SEEK_SET, &r_fresh);
+    oggz_close (fresh);
+
+    if (r_cached < units - 100)
+      FAIL("Seek using landmarks stopped short of target");
+  }
+
+#ifdef DEBUG
+  printf ("reads: cached %d, fresh %d\n", reads_again, reads_fresh);
+#endif
+
+  if (reads_again >= reads_fresh)
+    FAIL("Seeks near earlier targets made as many reads");
+
+  INFO ("+ Seeking from the end");
+
+  seek_units (cached, 0, SEEK_SET, &r_cached);
+  reads_end = seek_units (cached, -10, SEEK_END, &r_cached);
+
+  fresh = open_reader (&f_fresh);
+  if (seek_units (fresh, -10, SEEK_END, &r_fresh) <= reads_end)
+    FAIL("Seek from the end probed the last page again");
+  oggz_close (fresh);
+
+  units = NR_PACKETS - 1 - 10;
+  if (r_cached > units || r_cached < units - 100)
+    FAIL("Seek from the end returned incorrect units");
+
+  INFO ("+ Discarding landmarks when the file changes size");
+
+  data_len /= 2;
+
+  seek_units (cached, -10, SEEK_END, &r_cached);
+
+  fresh = open_reader (&f_fresh);
+  seek_units (fresh, -10, SEEK_END, &r_fresh);
+  oggz_close (fresh);
+
+  if (r_cached > NR_PACKETS / 2 || r_cached < r_fresh - 100)
+    FAIL("Landmarks of a truncated file were used");
+
+  if (oggz_close (cached) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
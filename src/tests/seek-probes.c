@@ -0,0 +1,238 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 6000
+#define DATA_BUF_LEN (NR_PACKETS * 1100)
+
+#define NR_TARGETS 50
+
+#define PROBES_TEST_FILE "seek-probes-test.ogg"
+
+static long serialno;
+
+/* Packets are small and large in turn for every 1000, as in variable
+ * bitrate video */
+static long
+packet_len (int iter)
+{
+  return ((iter / 1000) % 2) ? 1000 + (iter % 7) * 10 : 20 + (iter % 5);
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[1100];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, iter & 0xff, packet_len (iter));
+
+  op.packet = buf;
+  op.bytes = packet_len (iter);
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return 0;
+}
+
+static void
+write_file (const char * filename, const unsigned char * buf, long n)
+{
+  FILE * file;
+
+  if ((file = fopen (filename, "wb")) == NULL)
+    FAIL("Could not open test file");
+
+  if (fwrite (buf, 1, n, file) != (size_t)n)
+    FAIL("Could not write test file");
+
+  fclose (file);
+}
+
+/* Open a reader through I/O callbacks if f is given, else on the file */
+static OGGZ *
+open_reader (test_file * f, int nr_probes)
+{
+  OGGZ * reader;
+
+  if (f != NULL) {
+    reader = test_open_reader (f, OGGZ_READ, read_packet, NULL);
+  } else {
+    reader = oggz_open (PROBES_TEST_FILE, OGGZ_READ);
+    if (reader == NULL)
+      FAIL("Could not open test file");
+
+    oggz_set_read_callback (reader, -1, read_packet, NULL);
+  }
+
+  /* Read the header page */
+  oggz_read (reader, 1024);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  if (oggz_seek_set_probes (reader, nr_probes) != 0)
+    FAIL("Could not set number of probes");
+
+  return reader;
+}
+
+/*
+ * Seek to each target with nr_probes probes at a time, checking the
+ * results against those of single probes given in results (or filling
+ * them in if nr_probes is 1). Returns the total number of probes.
+ */
+static long
+seek_targets (test_file * f, int nr_probes, ogg_int64_t * results)
+{
+  OGGZ * reader;
+  OggzSeekStats stats;
+  ogg_int64_t units, result;
+  long probes = 0;
+  int i;
+
+  for (i = 0; i < NR_TARGETS; i++) {
+    units = (i * 3989) % (NR_PACKETS - 20) + 10;
+
+    reader = open_reader (f, nr_probes);
+
+    if ((result = oggz_seek_units (reader, units, SEEK_SET)) < 0)
+      FAIL("Seek failed");
+
+    /* Pages of small packets hold up to 255 of them */
+    if (result > units || result < units - 255)
+      FAIL("Seek returned incorrect units");
+
+    if (nr_probes == 1) {
+      results[i] = result;
+    } else if (result != results[i]) {
+      FAIL("Seek with several probes returned a different result");
+    }
+
+    if (oggz_seek_get_stats (reader, &stats) != 0)
+      FAIL("Could not get seek stats");
+
+    probes += stats.last_probes;
+
+    oggz_close (reader);
+  }
+
+#ifdef DEBUG
+  printf ("%d probes at once: %ld probes per seek\n",
+          nr_probes, probes / NR_TARGETS);
+#endif
+
+  return probes;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  test_file f;
+  ogg_int64_t results[NR_TARGETS];
+  long probes_1, probes_n;
+
+  INFO ("Testing concurrent seek probes");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  test_generate (writer, hungry, DATA_BUF_LEN);
+
+  INFO ("+ Rejecting invalid numbers of probes");
+
+  if (oggz_seek_set_probes (NULL, 4) != OGGZ_ERR_BAD_OGGZ)
+    FAIL("Setting probes on a NULL OGGZ succeeded");
+
+  if (oggz_seek_set_probes (writer, 4) != OGGZ_ERR_INVALID)
+    FAIL("Setting probes on an OGGZ writer succeeded");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  writer = oggz_new (OGGZ_READ);
+  if (oggz_seek_set_probes (writer, 0) != OGGZ_ERR_INVALID ||
+      oggz_seek_set_probes (writer, OGGZ_SEEK_PROBES_MAX + 1) !=
+      OGGZ_ERR_INVALID)
+    FAIL("Setting an invalid number of probes succeeded");
+  oggz_close (writer);
+
+  INFO ("+ Seeking through I/O callbacks");
+
+  probes_1 = seek_targets (&f, 1, results);
+  seek_targets (&f, 4, results);
+
+  INFO ("+ Seeking in a file with positional reads");
+
+  write_file (PROBES_TEST_FILE, data_buf, data_len);
+
+  probes_1 = seek_targets (NULL, 1, results);
+  probes_n = seek_targets (NULL, 7, results);
+
+  /* Each round of 7 probes divides the bracket in 8 */
+  if (probes_n >= probes_1)
+    FAIL("Seeks with several probes at once made no fewer round trips");
+
+  remove (PROBES_TEST_FILE);
+
+  exit (0);
+}
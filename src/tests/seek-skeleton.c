@@ -0,0 +1,264 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+#include "oggz_test_file.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 2000
+#define PACKET_LEN 300
+#define DATA_BUF_LEN (NR_PACKETS * (PACKET_LEN + 64) + 4096)
+
+#define KEYPOINT_INTERVAL 100
+#define NR_KEYPOINTS (NR_PACKETS / KEYPOINT_INTERVAL)
+
+#define FISHEAD_LEN 80
+/* Index packets are padded to a fixed length, so that the layout of the
+ * file does not depend on the keypoints */
+#define INDEX_LEN (42 + NR_KEYPOINTS * 20)
+
+static long skeleton_serialno, serialno;
+
+/* Offset of the page of each data packet */
+static long page_offsets[NR_PACKETS];
+
+static ogg_int64_t first_granulepos = -1;
+
+static void
+put_le_64 (unsigned char * c, ogg_int64_t v)
+{
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    c[i] = (v >> (i * 8)) & 0xff;
+  }
+}
+
+static unsigned char *
+put_vint (unsigned char * c, ogg_uint64_t v)
+{
+  do {
+    *c = v & 0x7f;
+    v >>= 7;
+    if (v == 0) *c |= 0x80;
+    c++;
+  } while (v != 0);
+
+  return c;
+}
+
+static void
+feed (OGGZ * writer, unsigned char * buf, long bytes, long serial,
+      int b_o_s, int e_o_s, ogg_int64_t granulepos, ogg_int64_t packetno)
+{
+  ogg_packet op;
+
+  op.packet = buf;
+  op.bytes = bytes;
+  op.b_o_s = b_o_s;
+  op.e_o_s = e_o_s;
+  op.granulepos = granulepos;
+  op.packetno = packetno;
+
+  if (oggz_write_feed (writer, &op, serial, OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  test_generate (writer, NULL, DATA_BUF_LEN);
+}
+
+/* Write a Skeleton 4.0 track indexing a data track. The keypoints refer
+ * to the page offsets and file length of the previous call */
+static void
+generate (void)
+{
+  OGGZ * writer;
+  unsigned char fishead[FISHEAD_LEN], index[INDEX_LEN], buf[PACKET_LEN];
+  unsigned char * c;
+  ogg_int64_t prev_offset = 0, prev_time = 0;
+  long segment_length = data_len;
+  int i;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  data_len = 0;
+
+  memset (fishead, 0, FISHEAD_LEN);
+  memcpy (fishead, "fishead\0", 8);
+  fishead[8] = 4; /* version 4.0 */
+  put_le_64 (&fishead[20], 1000); /* presentation time denominator */
+  put_le_64 (&fishead[36], 1000); /* basetime denominator */
+  put_le_64 (&fishead[64], segment_length);
+
+  feed (writer, fishead, FISHEAD_LEN, skeleton_serialno, 1, 0, 0, 0);
+
+  memset (buf, 0, PACKET_LEN);
+  page_offsets[0] = data_len;
+  feed (writer, buf, PACKET_LEN, serialno, 1, 0, 0, 0);
+
+  memset (index, 0, INDEX_LEN);
+  memcpy (index, "index\0", 6);
+  index[6] = serialno & 0xff;
+  index[7] = (serialno >> 8) & 0xff;
+  index[8] = (serialno >> 16) & 0xff;
+  index[9] = (serialno >> 24) & 0xff;
+  put_le_64 (&index[10], NR_KEYPOINTS);
+  put_le_64 (&index[18], 1000); /* timestamp denominator */
+  put_le_64 (&index[34], NR_PACKETS);
+
+  c = &index[42];
+  for (i = 0; i < NR_KEYPOINTS; i++) {
+    c = put_vint (c, page_offsets[i * KEYPOINT_INTERVAL] - prev_offset);
+    c = put_vint (c, i * KEYPOINT_INTERVAL - prev_time);
+    prev_offset = page_offsets[i * KEYPOINT_INTERVAL];
+    prev_time = i * KEYPOINT_INTERVAL;
+  }
+
+  feed (writer, index, INDEX_LEN, skeleton_serialno, 0, 0, 0, 1);
+  feed (writer, buf, 0, skeleton_serialno, 0, 1, 0, 2);
+
+  for (i = 1; i < NR_PACKETS; i++) {
+    memset (buf, i & 0xff, PACKET_LEN);
+    page_offsets[i] = data_len;
+    feed (writer, buf, PACKET_LEN, serialno, 0, (i == NR_PACKETS - 1), i, i);
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return 0;
+}
+
+static int
+read_first_packet (OGGZ * oggz, oggz_packet * zp, long serial,
+                   void * user_data)
+{
+  if (serial != serialno) return 0;
+
+  first_granulepos = zp->op.granulepos;
+
+  return OGGZ_STOP_OK;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  test_file f;
+  ogg_int64_t units, result;
+  long prev_len;
+  int i, seek_reads;
+
+  INFO ("Testing seeking with a Skeleton 4.0 index");
+
+  skeleton_serialno = 0x5ce1e700;
+  serialno = 0x0da7a000;
+
+  /* The second pass fills in the keypoints found by the first */
+  generate ();
+  prev_len = data_len;
+  generate ();
+
+  if (data_len != prev_len)
+    FAIL("Generated file changed length");
+
+  reader = test_open_reader (&f, OGGZ_READ | OGGZ_AUTO, read_packet, NULL);
+
+  /* Read the headers, including the index */
+  oggz_read (reader, 4096);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  INFO ("+ Seeking to keypoints");
+
+  for (i = 0; i < 40; i++) {
+    units = (i * 997) % (NR_PACKETS - KEYPOINT_INTERVAL) + KEYPOINT_INTERVAL;
+
+    oggz_set_read_callback (reader, -1, read_first_packet, NULL);
+
+    /* Clear the OGGZ_STOP_OK held over from the previous read */
+    oggz_read (reader, 0);
+
+    seek_reads = f.reads;
+    result = oggz_seek_units (reader, units, SEEK_SET);
+    if (f.reads != seek_reads)
+      FAIL("Seek using Skeleton index made probe reads");
+
+    if (result != (units / KEYPOINT_INTERVAL) * KEYPOINT_INTERVAL)
+      FAIL("Seek using Skeleton index returned incorrect units");
+
+    first_granulepos = -1;
+    oggz_read (reader, 1024);
+
+    if (first_granulepos != result)
+      FAIL("Seek using Skeleton index went to incorrect position");
+  }
+
+  INFO ("+ Ignoring the index of a modified file");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  /* Truncate the file, so that its length differs from the fishead */
+  data_len = page_offsets[NR_PACKETS - 10];
+
+  reader = test_open_reader (&f, OGGZ_READ | OGGZ_AUTO, read_packet, NULL);
+
+  oggz_read (reader, 4096);
+  oggz_set_granulerate (reader, serialno, 1, 1);
+
+  oggz_set_read_callback (reader, -1, read_first_packet, NULL);
+  oggz_read (reader, 0);
+
+  seek_reads = f.reads;
+  result = oggz_seek_units (reader, 1234, SEEK_SET);
+  if (f.reads == seek_reads)
+    FAIL("Seek using a stale Skeleton index made no reads");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  exit (0);
+}
@@ -71,6 +71,7 @@ read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 static ogg_int64_t
 try_seek_units (OGGZ * oggz, ogg_int64_t units)
 {
+  OggzSeekStats stats;
   ogg_int64_t result, diff;
 
   if (verbose)
@@ -79,10 +80,15 @@ try_seek_units (OGGZ * oggz, ogg_int64_t units)
   result = oggz_seek_units (oggz, units, SEEK_SET);
   diff = result - units;
 
-  if (verbose)
+  if (verbose) {
     printf ("\t%0" PRId64 "x: %" PRId64 " ms (%+" PRId64 " ms)\n",
 	    oggz_tell (oggz), oggz_tell_units (oggz), diff);
 
+    if (oggz_seek_get_stats (oggz, &stats) == 0)
+      printf ("\t%ld probes, %" PRId64 " bytes read\n",
+              stats.last_probes, stats.last_bytes_read);
+  }
+
   if (result < 0) {
     FAIL ("Seek failure\n");
   }
@@ -103,21 +109,24 @@ int
 main (int argc, char * argv[])
 {
   OGGZ * oggz;
+  OggzSeekStats stats;
   ogg_int64_t max_units;
   char * filename = NULL;
-  int i;
+  int i, nr_probes = 1;
   long n;
 
   for (i = 1; i < argc; i++) {
     if (!strcmp (argv[i], "--verbose")) {
       verbose = 1;
+    } else if (!strcmp (argv[i], "--probes") && i+1 < argc) {
+      nr_probes = atoi (argv[++i]);
     } else {
       filename = argv[i];
     }
   }
 
   if (filename == NULL) {
-    printf ("usage: %s [--verbose] filename\n", argv[0]);
+    printf ("usage: %s [--verbose] [--probes n] filename\n", argv[0]);
     exit(1);
   }
 
@@ -128,6 +137,9 @@ main (int argc, char * argv[])
 
   printf ("Testing %s ...\n", filename);
 
+  if (nr_probes > 1 && oggz_seek_set_probes (oggz, nr_probes) != 0)
+    FAIL ("Could not set number of probes");
+
   oggz_set_read_callback (oggz, -1, read_packet, NULL);
 
   while ((n = oggz_read (oggz, 1024)) > 0);
@@ -146,6 +158,10 @@ main (int argc, char * argv[])
   try_seek_units (oggz, 999 * max_units / 1000);
   try_seek_units (oggz, max_units / 100);
 
+  if (verbose && oggz_seek_get_stats (oggz, &stats) == 0)
+    printf ("\tTotal: %ld seeks, %ld probes, %" PRId64 " bytes read\n",
+            stats.seeks, stats.probes, stats.bytes_read);
+
   oggz_close (oggz);
 
   exit (0);
@@ -0,0 +1,142 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+#define NR_KEYS 1000
+
+/* Keys spread widely, including negative values */
+#define KEY(i) ((long)(i) * 7919L - 100000L)
+
+static int values[NR_KEYS];
+
+int
+main (int argc, char * argv[])
+{
+  OggzTable * table;
+  long key;
+  int i, size;
+
+  INFO ("Creating table");
+  table = oggz_table_new ();
+  if (table == NULL)
+    FAIL ("Could not create table");
+
+  INFO ("+ Inserting elements");
+  for (i = 0; i < NR_KEYS; i++) {
+    values[i] = i;
+    if (oggz_table_insert (table, KEY(i), &values[i]) != &values[i])
+      FAIL ("Insert failed");
+  }
+
+  if (oggz_table_size (table) != NR_KEYS)
+    FAIL ("Incorrect table size");
+
+  INFO ("+ Looking up elements");
+  for (i = 0; i < NR_KEYS; i++) {
+    if (oggz_table_lookup (table, KEY(i)) != &values[i])
+      FAIL ("Lookup returned incorrect element");
+  }
+
+  if (oggz_table_lookup (table, KEY(NR_KEYS)) != NULL)
+    FAIL ("Lookup of absent key returned an element");
+
+  INFO ("+ Replacing an element");
+  if (oggz_table_insert (table, KEY(0), &values[1]) != &values[1])
+    FAIL ("Replacing insert failed");
+
+  if (oggz_table_size (table) != NR_KEYS)
+    FAIL ("Replacing an element changed the table size");
+
+  if (oggz_table_nth (table, 0, &key) != &values[1] || key != KEY(0))
+    FAIL ("Replaced element did not keep its position");
+
+  INFO ("+ Removing every other element");
+  for (i = 0; i < NR_KEYS; i += 2) {
+    if (oggz_table_remove (table, KEY(i)) != 0)
+      FAIL ("Remove failed");
+  }
+
+  if (oggz_table_remove (table, KEY(0)) != -1)
+    FAIL ("Removing an absent key did not fail");
+
+  if (oggz_table_size (table) != NR_KEYS/2)
+    FAIL ("Incorrect table size after removal");
+
+  for (i = 0; i < NR_KEYS; i++) {
+    void * expected = (i % 2) ? &values[i] : NULL;
+    if (oggz_table_lookup (table, KEY(i)) != expected)
+      FAIL ("Lookup after removal returned incorrect element");
+  }
+
+  INFO ("+ Checking order of remaining elements");
+  for (i = 0; i < NR_KEYS/2; i++) {
+    if (oggz_table_nth (table, i, &key) != &values[2*i+1] ||
+        key != KEY(2*i+1))
+      FAIL ("nth element out of order");
+  }
+
+  if (oggz_table_nth (table, NR_KEYS/2, NULL) != NULL)
+    FAIL ("nth element beyond end of table");
+
+  INFO ("+ Inserting NULL elements");
+  for (i = 0; i < NR_KEYS; i += 2) {
+    size = oggz_table_size (table);
+    oggz_table_insert (table, KEY(i), NULL);
+    if (oggz_table_size (table) != size + 1)
+      FAIL ("Could not insert NULL element");
+  }
+
+  if (oggz_table_size (table) != NR_KEYS)
+    FAIL ("NULL elements not counted in table size");
+
+  if (oggz_table_nth (table, NR_KEYS/2, &key) != NULL || key != KEY(0))
+    FAIL ("Reinserted element not at end of table");
+
+  if (oggz_table_remove (table, KEY(2)) != 0)
+    FAIL ("Could not remove NULL element");
+
+  if (oggz_table_size (table) != NR_KEYS - 1)
+    FAIL ("Incorrect table size after removing NULL element");
+
+  oggz_table_delete (table);
+
+  exit (0);
+}
@@ -0,0 +1,195 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 1000
+#define DATA_BUF_LEN (NR_PACKETS * 600)
+
+#define SERIALNO 7
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static long data_len = 0;
+
+static unsigned char page_buf[DATA_BUF_LEN];
+static long page_len = 0;
+
+static long
+packet_len (int iter)
+{
+  return 20 + (iter % 11) * 50;
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[600];
+  ogg_packet op;
+  int * iter = (int *)user_data;
+
+  if (*iter >= NR_PACKETS) return 1;
+
+  memset (buf, *iter & 0xff, packet_len (*iter));
+
+  op.packet = buf;
+  op.bytes = packet_len (*iter);
+  op.b_o_s = (*iter == 0);
+  op.e_o_s = (*iter == NR_PACKETS - 1);
+  op.granulepos = *iter;
+  op.packetno = *iter;
+
+  if (oggz_write_feed (oggz, &op, SERIALNO,
+                       (*iter % 37 == 0) ? OGGZ_FLUSH_AFTER : 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  (*iter)++;
+
+  return 0;
+}
+
+static void
+append_page (ogg_page * og, long n)
+{
+  if (og->header_len + og->body_len != n)
+    FAIL ("Page length does not match return value");
+
+  if (page_len + n > DATA_BUF_LEN)
+    FAIL ("Page output overflows buffer");
+
+  memcpy (page_buf + page_len, og->header, og->header_len);
+  page_len += og->header_len;
+  memcpy (page_buf + page_len, og->body, og->body_len);
+  page_len += og->body_len;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  ogg_page og;
+  unsigned char buf[7];
+  long n, nr_pages = 0;
+  int iter;
+
+  INFO ("Testing page output without copying");
+
+  /* Reference output, copied out of Oggz a buffer at a time */
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  iter = 0;
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, &iter) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data_buf + data_len,
+                                 DATA_BUF_LEN - data_len)) > 0) {
+    data_len += n;
+  }
+
+  oggz_close (writer);
+
+  INFO ("+ Writing whole pages");
+  writer = oggz_new (OGGZ_WRITE);
+
+  iter = 0;
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, &iter) == -1)
+    FAIL("Could not set hungry callback");
+
+  if (oggz_write_output_page (writer, NULL) != OGGZ_ERR_INVALID)
+    FAIL("Page output with NULL page succeeded");
+
+  while ((n = oggz_write_output_page (writer, &og)) > 0) {
+    if (og.header_len < 27 || memcmp (og.header, "OggS", 4) != 0)
+      FAIL("Page output does not begin with a page header");
+
+    if (ogg_page_serialno (&og) != SERIALNO)
+      FAIL("Page output has incorrect serialno");
+
+    append_page (&og, n);
+    nr_pages++;
+  }
+
+  oggz_close (writer);
+
+#ifdef DEBUG
+  printf ("%ld bytes in %ld pages\n", page_len, nr_pages);
+#endif
+
+  if (page_len != data_len || memcmp (page_buf, data_buf, data_len) != 0)
+    FAIL("Page output differs");
+
+  INFO ("+ Writing pages after partial output");
+  writer = oggz_new (OGGZ_WRITE);
+
+  iter = 0;
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, &iter) == -1)
+    FAIL("Could not set hungry callback");
+
+  page_len = 0;
+  while (1) {
+    /* Alternate a few bytes copied out with the rest of the page */
+    if ((n = oggz_write_output (writer, buf, sizeof (buf))) <= 0) break;
+
+    memcpy (page_buf + page_len, buf, n);
+    page_len += n;
+
+    if ((n = oggz_write_output_page (writer, &og)) <= 0) break;
+
+    if (og.header_len == 0)
+      FAIL("Partial page output has no header remainder");
+
+    append_page (&og, n);
+  }
+
+  oggz_close (writer);
+
+  if (page_len != data_len || memcmp (page_buf, data_buf, data_len) != 0)
+    FAIL("Mixed page output differs");
+
+  writer = oggz_new (OGGZ_READ);
+  if (oggz_write_output_page (writer, &og) != OGGZ_ERR_INVALID)
+    FAIL("Page output from an OGGZ reader succeeded");
+  oggz_close (writer);
+
+  exit (0);
+}
@@ -0,0 +1,218 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 200
+#define DATA_BUF_LEN (NR_PACKETS * 3000)
+
+#define SERIALNO 7
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static long data_len = 0;
+
+static unsigned char release_buf[DATA_BUF_LEN];
+static long release_len = 0;
+
+typedef struct {
+  unsigned char * data;
+  int refcount;
+} my_buffer;
+
+static my_buffer buffers[NR_PACKETS];
+static int nr_released = 0;
+
+static long
+packet_len (int i)
+{
+  return 20 + (i % 7) * 400;
+}
+
+static void
+my_release (unsigned char * packet, void * user_data)
+{
+  my_buffer * b = (my_buffer *)user_data;
+
+  if (packet != b->data)
+    FAIL ("Released packet data does not match buffer");
+
+  if (--b->refcount < 0)
+    FAIL ("Buffer released more than once");
+
+  if (b->refcount == 0) {
+    /* Scribble over the data, which Oggz should no longer need */
+    memset (b->data, 0xff, packet_len (b - buffers));
+    free (b->data);
+    b->data = NULL;
+    nr_released++;
+  }
+}
+
+static void
+make_packet (ogg_packet * op, unsigned char * data, int i)
+{
+  memset (data, i & 0xff, packet_len (i));
+
+  op->packet = data;
+  op->bytes = packet_len (i);
+  op->b_o_s = (i == 0);
+  op->e_o_s = (i == NR_PACKETS - 1);
+  op->granulepos = i;
+  op->packetno = i;
+}
+
+static long
+drain (OGGZ * writer, unsigned char * buf)
+{
+  long n, len = 0;
+
+  while ((n = oggz_write_output (writer, buf + len, DATA_BUF_LEN - len)) > 0)
+    len += n;
+
+  return len;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  ogg_packet op;
+  unsigned char copied[3000];
+  int i;
+
+  INFO ("Testing packets fed with a release callback");
+
+  /* Reference output, with packets copied by Oggz */
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    make_packet (&op, copied, i);
+    if (oggz_write_feed (writer, &op, SERIALNO, 0, NULL) != 0)
+      FAIL ("Oggz write failed");
+  }
+  data_len = drain (writer, data_buf);
+  oggz_close (writer);
+
+  INFO ("+ Feeding reference counted buffers");
+  writer = oggz_new (OGGZ_WRITE);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    buffers[i].data = malloc (packet_len (i));
+    buffers[i].refcount = 2;
+    make_packet (&op, buffers[i].data, i);
+
+    if (oggz_write_feed_release (writer, &op, SERIALNO, 0, my_release,
+                                 &buffers[i]) != 0)
+      FAIL ("Oggz write failed");
+
+    /* Drop our own reference; Oggz holds the other */
+    my_release (buffers[i].data, &buffers[i]);
+  }
+
+  if (nr_released != 0)
+    FAIL ("Buffers released before writing");
+
+  release_len = drain (writer, release_buf);
+
+  if (nr_released != NR_PACKETS)
+    FAIL ("Buffers not released after writing");
+
+  oggz_close (writer);
+
+  if (release_len != data_len || memcmp (release_buf, data_buf, data_len))
+    FAIL ("Output with released buffers differs");
+
+  INFO ("+ Closing with buffers still queued");
+  writer = oggz_new (OGGZ_WRITE);
+  nr_released = 0;
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    buffers[i].data = malloc (packet_len (i));
+    buffers[i].refcount = 1;
+    make_packet (&op, buffers[i].data, i);
+
+    if (oggz_write_feed_release (writer, &op, SERIALNO, 0, my_release,
+                                 &buffers[i]) != 0)
+      FAIL ("Oggz write failed");
+
+    /* Write out some pages part way through */
+    if (i == NR_PACKETS / 2) drain (writer, release_buf);
+  }
+
+  oggz_close (writer);
+
+  if (nr_released != NR_PACKETS)
+    FAIL ("Queued buffers not released on close");
+
+  INFO ("+ Checking errors keep the buffer with the caller");
+  writer = oggz_new (OGGZ_WRITE);
+  nr_released = 0;
+
+  buffers[0].data = malloc (packet_len (0));
+  buffers[0].refcount = 1;
+  make_packet (&op, buffers[0].data, 0);
+
+  if (oggz_write_feed_release (writer, &op, -1, 0, my_release,
+                               &buffers[0]) != OGGZ_ERR_BAD_SERIALNO)
+    FAIL ("Feeding with a bad serialno succeeded");
+
+  if (oggz_write_feed_release (writer, &op, SERIALNO, 0, NULL, NULL)
+      != OGGZ_ERR_INVALID)
+    FAIL ("Feeding with a NULL release function succeeded");
+
+  oggz_close (writer);
+
+  if (nr_released != 0 || buffers[0].refcount != 1)
+    FAIL ("Buffer released after error");
+
+  free (buffers[0].data);
+
+  writer = oggz_new (OGGZ_READ);
+  if (oggz_write_feed_release (writer, &op, SERIALNO, 0, my_release, NULL)
+      != OGGZ_ERR_INVALID)
+    FAIL ("Feeding an OGGZ reader succeeded");
+  oggz_close (writer);
+
+  exit (0);
+}
@@ -0,0 +1,396 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+/* Stream A has a packet every 10ms, stream B every 25ms */
+#define SERIALNO_A 1
+#define SERIALNO_B 2
+#define NR_PACKETS_A 600
+#define NR_PACKETS_B 240
+#define LEN_A 300
+#define LEN_B 500
+
+#define DATA_BUF_LEN ((NR_PACKETS_A * LEN_A + NR_PACKETS_B * LEN_B) * 2)
+
+/* How far back in time a page may follow another: a page is written
+ * when its stream next takes a packet, which may be one packet later */
+#define ORDER_TOLERANCE 50
+
+/* The default maximum delay */
+#define MAX_DELAY 1000
+
+#define SORT_TEST_FILE "write-sort-test.ogg"
+
+static unsigned char data_buf[DATA_BUF_LEN];
+static long data_len = 0;
+
+/* The latest page time in data_buf, and the packets of each stream */
+static ogg_int64_t written_unit = 0;
+static int written_packets[2];
+
+typedef struct {
+  int nr_fed[2];
+  int burst;
+} feeder;
+
+typedef struct {
+  int nr_packets[2];
+  ogg_int64_t max_unit;
+  ogg_int64_t max_disorder;
+} reader_state;
+
+static int
+stream_index (long serialno)
+{
+  return (serialno == SERIALNO_A) ? 0 : 1;
+}
+
+static ogg_int64_t
+granule_unit (long serialno, ogg_int64_t granulepos)
+{
+  return granulepos * ((serialno == SERIALNO_A) ? 10 : 25);
+}
+
+static void
+feed (OGGZ * writer, long serialno, int i)
+{
+  static unsigned char buf[LEN_B];
+  ogg_packet op;
+  int nr_packets = (serialno == SERIALNO_A) ? NR_PACKETS_A : NR_PACKETS_B;
+
+  op.bytes = (serialno == SERIALNO_A) ? LEN_A : LEN_B;
+  memset (buf, i & 0xff, op.bytes);
+
+  op.packet = buf;
+  op.b_o_s = (i == 0);
+  op.e_o_s = (i == nr_packets);
+  op.granulepos = i;
+  op.packetno = i;
+
+  if (oggz_write_feed (writer, &op, serialno,
+                       (i == 0) ? OGGZ_FLUSH_AFTER : 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+}
+
+/* Create a writer, writing to filename if it is not NULL */
+static OGGZ *
+new_writer (const char * filename, int flags)
+{
+  OGGZ * writer;
+
+  if (filename != NULL)
+    writer = oggz_open (filename, OGGZ_WRITE | flags);
+  else
+    writer = oggz_new (OGGZ_WRITE | flags);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  /* Both bos packets first, then set the rates of the streams, scaled
+   * to give units of milliseconds */
+  feed (writer, SERIALNO_A, 0);
+  feed (writer, SERIALNO_B, 0);
+  oggz_set_granulerate (writer, SERIALNO_A, 100, 1000);
+  oggz_set_granulerate (writer, SERIALNO_B, 40, 1000);
+
+  return writer;
+}
+
+static void
+drain (OGGZ * writer)
+{
+  long n;
+
+  while ((n = oggz_write_output (writer, data_buf + data_len,
+                                 DATA_BUF_LEN - data_len)) > 0)
+    data_len += n;
+}
+
+/* An OggzIOWritev callback appending to data_buf */
+static long
+io_writev (void * user_handle, const OggzIOVec * iov, int iovcnt)
+{
+  long n = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++) {
+    if (data_len + (long)iov[i].len > DATA_BUF_LEN) break;
+    memcpy (data_buf + data_len, iov[i].base, iov[i].len);
+    data_len += (long)iov[i].len;
+    n += (long)iov[i].len;
+  }
+
+  return n;
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  feeder * f = (feeder *)user_data;
+  int i, s;
+
+  if (f->nr_fed[0] >= NR_PACKETS_A && f->nr_fed[1] >= NR_PACKETS_B)
+    return 1;
+
+  /* Alternate uneven bursts of A and B, each within the default delay */
+  s = f->burst++ % 2;
+  for (i = 0; i < (s ? 20 : 50); i++) {
+    if (f->nr_fed[s] >= (s ? NR_PACKETS_B : NR_PACKETS_A)) break;
+    feed (oggz, s ? SERIALNO_B : SERIALNO_A, ++f->nr_fed[s]);
+  }
+
+  return 0;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  reader_state * rs = (reader_state *)user_data;
+  ogg_int64_t unit, granulepos = ogg_page_granulepos (og);
+
+  if (granulepos <= 0) return OGGZ_CONTINUE;
+
+  unit = granule_unit (serialno, granulepos);
+
+  if (rs->max_unit - unit > rs->max_disorder)
+    rs->max_disorder = rs->max_unit - unit;
+  if (unit > rs->max_unit)
+    rs->max_unit = unit;
+
+#ifdef DEBUG
+  printf ("page %ld @%lld ms\n", serialno, (long long)unit);
+#endif
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  reader_state * rs = (reader_state *)user_data;
+  int * n = &rs->nr_packets[stream_index (serialno)];
+
+  if (zp->op.packet[0] != (*n & 0xff))
+    FAIL ("Packet read out of order within its stream");
+
+  (*n)++;
+
+  return OGGZ_CONTINUE;
+}
+
+/*
+ * Read back data_buf, returning how far back in time any page was
+ * written after a later one.
+ */
+static ogg_int64_t
+check_output (int complete)
+{
+  OGGZ * reader;
+  reader_state rs;
+
+  memset (&rs, 0, sizeof (rs));
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_page (reader, -1, read_page, &rs);
+  oggz_set_read_callback (reader, -1, read_packet, &rs);
+
+  oggz_read_input (reader, data_buf, data_len);
+  oggz_close (reader);
+
+  if (complete && (rs.nr_packets[0] != NR_PACKETS_A + 1 ||
+                   rs.nr_packets[1] != NR_PACKETS_B + 1))
+    FAIL ("Packets missing from output");
+
+#ifdef DEBUG
+  printf ("written to %lld ms, disorder %lld ms\n",
+          (long long)rs.max_unit, (long long)rs.max_disorder);
+#endif
+
+  written_unit = rs.max_unit;
+  written_packets[0] = rs.nr_packets[0];
+  written_packets[1] = rs.nr_packets[1];
+
+  return rs.max_disorder;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  FILE * file;
+  feeder f;
+  ogg_int64_t disorder;
+  int i;
+
+  INFO ("Testing time ordered writing with OGGZ_SORT");
+
+  /* Without OGGZ_SORT, pages follow the order of feeding */
+  writer = new_writer (NULL, 0);
+
+  if (oggz_write_set_max_delay (writer, 100) != OGGZ_ERR_INVALID)
+    FAIL ("Setting a maximum delay without OGGZ_SORT succeeded");
+
+  for (i = 1; i <= NR_PACKETS_A; i++) feed (writer, SERIALNO_A, i);
+  for (i = 1; i <= NR_PACKETS_B; i++) feed (writer, SERIALNO_B, i);
+  drain (writer);
+  oggz_close (writer);
+
+  if (check_output (1) < 1000)
+    FAIL ("Unsorted output is already in time order");
+
+  INFO ("+ Feeding each stream in turn");
+  writer = new_writer (NULL, OGGZ_SORT);
+  data_len = 0;
+
+  if (oggz_write_set_max_delay (writer, -1) != OGGZ_ERR_INVALID)
+    FAIL ("Setting a negative maximum delay succeeded");
+
+  if (oggz_write_set_max_delay (writer, 100000) != 0)
+    FAIL ("Could not set maximum delay");
+
+  for (i = 1; i <= NR_PACKETS_A; i++) feed (writer, SERIALNO_A, i);
+  drain (writer);
+
+  for (i = 1; i <= NR_PACKETS_B; i++) feed (writer, SERIALNO_B, i);
+  drain (writer);
+  oggz_close (writer);
+
+  disorder = check_output (1);
+  if (disorder > ORDER_TOLERANCE)
+    FAIL ("Sorted output is out of time order");
+
+  INFO ("+ Feeding uneven bursts from a hungry callback");
+  writer = new_writer (NULL, OGGZ_SORT);
+  data_len = 0;
+
+  memset (&f, 0, sizeof (f));
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, &f) == -1)
+    FAIL("Could not set hungry callback");
+
+  drain (writer);
+  oggz_close (writer);
+
+  if (check_output (1) > ORDER_TOLERANCE)
+    FAIL ("Sorted output is out of time order");
+
+  INFO ("+ Writing past the maximum delay");
+  writer = new_writer (NULL, OGGZ_SORT);
+  data_len = 0;
+
+  /* Stream B falls silent: A is written up to the delay behind it */
+  for (i = 1; i <= NR_PACKETS_A; i++) feed (writer, SERIALNO_A, i);
+  drain (writer);
+
+  check_output (0);
+  if (written_unit < NR_PACKETS_A * 10 - 2 * MAX_DELAY)
+    FAIL ("Packets not written after the maximum delay");
+
+  if (written_unit > NR_PACKETS_A * 10 - MAX_DELAY)
+    FAIL ("Packets written within the maximum delay");
+
+  INFO ("+ Releasing held packets");
+
+  if (oggz_write_sort_flush (writer) <= 0)
+    FAIL ("No packets were held back");
+  drain (writer);
+
+  check_output (0);
+  if (written_packets[0] != NR_PACKETS_A + 1)
+    FAIL ("Released packets not written");
+
+  if (oggz_close (writer) != 0)
+    FAIL ("Could not close OGGZ writer");
+
+  INFO ("+ Reporting held packets before closing");
+  writer = new_writer (NULL, OGGZ_SORT);
+  data_len = 0;
+
+  for (i = 1; i <= NR_PACKETS_A; i++) feed (writer, SERIALNO_A, i);
+  drain (writer);
+
+  if (oggz_write_sort_flush (writer) <= 0)
+    FAIL ("Held packets were not reported");
+
+  if (oggz_close (writer) != 0)
+    FAIL ("Could not close OGGZ writer");
+
+  INFO ("+ Writing held packets through OggzIOWritev on close");
+  writer = new_writer (NULL, OGGZ_SORT);
+  data_len = 0;
+
+  if (oggz_io_set_writev (writer, io_writev, NULL) != 0)
+    FAIL ("Could not set writev callback");
+
+  for (i = 1; i <= NR_PACKETS_A; i++) feed (writer, SERIALNO_A, i);
+  while (oggz_write (writer, 4096) > 0);
+
+  if (oggz_close (writer) != 0)
+    FAIL ("Could not close OGGZ writer");
+
+  check_output (0);
+  if (written_packets[0] != NR_PACKETS_A + 1)
+    FAIL ("Held packets not written through OggzIOWritev on close");
+
+  INFO ("+ Writing held packets to a file on close");
+  writer = new_writer (SORT_TEST_FILE, OGGZ_SORT);
+
+  for (i = 1; i <= NR_PACKETS_A; i++) feed (writer, SERIALNO_A, i);
+  while (oggz_write (writer, 4096) > 0);
+
+  if (oggz_close (writer) != 0)
+    FAIL ("Could not close OGGZ writer");
+
+  if ((file = fopen (SORT_TEST_FILE, "rb")) == NULL)
+    FAIL ("Could not open test file");
+  data_len = fread (data_buf, 1, DATA_BUF_LEN, file);
+  fclose (file);
+  remove (SORT_TEST_FILE);
+
+  check_output (0);
+  if (written_packets[0] != NR_PACKETS_A + 1)
+    FAIL ("Held packets not written on close");
+
+  exit (0);
+}
@@ -0,0 +1,791 @@
+/*
+   Copyright (C) 2008 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+#include <errno.h>
+
+#include <oggz/oggz.h>
+#include "oggz_tools.h"
+#include "skeleton.h"
+#include "mimetypes.h"
+
+#define READ_BLOCKSIZE 16384
+
+static char * progname;
+
+static void
+usage (const char * progname)
+{
+  printf ("Usage: %s [options] filename ...\n", progname);
+  printf ("Build seek index files for one or more Ogg files. The index for each\n");
+  printf ("file is written alongside it, with the suffix %s appended to its\n",
+          OGGZ_SEEK_INDEX_SUFFIX);
+  printf ("name, and is used automatically by Oggz when seeking in that file.\n");
+  printf ("\nOutput options\n");
+  printf ("  -s, --skeleton         Instead of a seek index file, write a copy of the\n");
+  printf ("                         file with a Skeleton 4.0 keypoint index to the\n");
+  printf ("                         output file\n");
+  printf ("  -o filename, --output filename\n");
+  printf ("                         Specify output filename (only for a single\n");
+  printf ("                         input file)\n");
+  printf ("\nMiscellaneous options\n");
+  printf ("  -h, --help             Display this help and exit\n");
+  printf ("  -v, --version          Output version information and exit\n");
+  printf ("\n");
+  printf ("Please report bugs to <ogg-dev@xiph.org>\n");
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  long * nr_pages = (long *)user_data;
+
+  (*nr_pages)++;
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+build_index (const char * infilename, const char * outfilename)
+{
+  OGGZ * oggz;
+  FILE * outfile;
+  char * tmpfilename;
+  unsigned char * buf;
+  long n, nr_pages = 0;
+  int ret = -1;
+
+  if ((oggz = oggz_open (infilename, OGGZ_READ|OGGZ_AUTO)) == NULL) {
+    fprintf (stderr, "%s: unable to open file %s\n", progname, infilename);
+    return -1;
+  }
+
+  /* The index is recorded as the pages are read, in a single pass */
+  oggz_seek_index_enable (oggz);
+  oggz_set_read_page (oggz, -1, read_page, &nr_pages);
+
+  while ((n = oggz_read (oggz, READ_BLOCKSIZE)) > 0);
+
+  if (n < 0) {
+    fprintf (stderr, "%s: error reading %s\n", progname, infilename);
+    goto out_close;
+  }
+
+  if ((n = oggz_seek_index_export (oggz, NULL, 0)) <= 0) {
+    fprintf (stderr, "%s: unable to index %s\n", progname, infilename);
+    goto out_close;
+  }
+
+  if ((buf = malloc (n)) == NULL) {
+    fprintf (stderr, "%s: out of memory\n", progname);
+    goto out_close;
+  }
+
+  oggz_seek_index_export (oggz, buf, n);
+
+  /* Write to a temporary file and rename it into place, so that readers
+   * never map a partially written index */
+  if ((tmpfilename = malloc (strlen (outfilename) + 5)) == NULL) {
+    fprintf (stderr, "%s: out of memory\n", progname);
+    goto out_free;
+  }
+  sprintf (tmpfilename, "%s.tmp", outfilename);
+
+  if ((outfile = fopen (tmpfilename, "wb")) == NULL) {
+    fprintf (stderr, "%s: unable to open output file %s: %s\n",
+             progname, tmpfilename, strerror (errno));
+    goto out_free_tmp;
+  }
+
+  if (fwrite (buf, 1, n, outfile) != (size_t)n) {
+    fprintf (stderr, "%s: error writing %s\n", progname, tmpfilename);
+    fclose (outfile);
+    remove (tmpfilename);
+    goto out_free_tmp;
+  }
+
+  if (fclose (outfile) != 0 || rename (tmpfilename, outfilename) != 0) {
+    fprintf (stderr, "%s: unable to write %s: %s\n",
+             progname, outfilename, strerror (errno));
+    remove (tmpfilename);
+    goto out_free_tmp;
+  }
+
+  ret = 0;
+
+ out_free_tmp:
+  free (tmpfilename);
+ out_free:
+  free (buf);
+ out_close:
+  oggz_close (oggz);
+
+  return ret;
+}
+
+/*
+ * Writing a copy of a file with a Skeleton 4.0 keypoint index.
+ *
+ * The input is read twice. The first pass collects keypoints, the
+ * fisbones and fishead of any existing Skeleton track, and the offsets of
+ * its pages. The new Skeleton track is then built in memory: its fishead
+ * is written before all other pages, and its fisbones, index packets and
+ * EOS page are written after the last BOS page. The second pass copies
+ * the other pages of the input around it.
+ *
+ * Keypoint offsets refer to the output file, and so depend on the size of
+ * the Skeleton pages, which in turn depend on the encoded size of the
+ * keypoints. The Skeleton pages are rebuilt until their size agrees with
+ * the size assumed for them, padding the last index packet if necessary.
+ */
+
+/* Minimum interval between keypoints of bitstreams without keyframes,
+ * in milliseconds */
+#define KEYPOINT_INTERVAL 500
+
+#define MAX_LAYOUT_PASSES 16
+
+typedef struct {
+  index_packet index;
+  fisbone_packet fisbone;
+  int has_fisbone;
+} OI_Track;
+
+typedef struct {
+  OGGZ * oggz;
+  OggzTable * tracks;
+
+  /* The Skeleton track of the input, if any */
+  long skeleton_serialno;
+  fishead_packet fishead;
+  oggz_off_t * skeleton_pages; /* offset and length of each page */
+  int nr_skeleton_pages;
+
+  oggz_off_t content_offset; /* offset of the first data page */
+  oggz_off_t input_length;
+
+  /* The new Skeleton track */
+  long serialno;
+  unsigned char * head, * tail;
+  long head_len, tail_len;
+
+  FILE * outfile;
+  int wrote_head, wrote_tail, write_error;
+} OI_Skeleton;
+
+static OI_Track *
+oi_track_get (OI_Skeleton * sk, long serialno)
+{
+  OI_Track * track;
+
+  if ((track = oggz_table_lookup (sk->tracks, serialno)) != NULL)
+    return track;
+
+  if ((track = calloc (1, sizeof (OI_Track))) == NULL)
+    return NULL;
+
+  track->index.serial_no = (ogg_uint32_t)serialno;
+  track->index.time_d = 1000;
+
+  if (oggz_table_insert (sk->tracks, serialno, track) == NULL) {
+    free (track);
+    return NULL;
+  }
+
+  return track;
+}
+
+/* Time of a granulepos, in milliseconds */
+static ogg_int64_t
+gp_to_ms (OGGZ * oggz, long serialno, ogg_int64_t granulepos, int * keyframe)
+{
+  int granuleshift;
+  ogg_int64_t iframe, pframe, granule, gr_n, gr_d;
+  OggzStreamContent content;
+
+  if (oggz_get_granulerate (oggz, serialno, &gr_n, &gr_d) != 0 || gr_n <= 0)
+    return -1;
+
+  granuleshift = oggz_get_granuleshift (oggz, serialno);
+  content = oggz_stream_get_content (oggz, serialno);
+
+  iframe = granulepos >> granuleshift;
+  pframe = granulepos - (iframe << granuleshift);
+
+  if (content == OGGZ_CONTENT_VP8) {
+    granule = iframe;
+    *keyframe = ((pframe >> 3) & 0x7ffffff) == 0;
+  } else {
+    granule = iframe + pframe;
+    *keyframe = (pframe == 0);
+
+    if (content == OGGZ_CONTENT_DIRAC)
+      granule >>= 9;
+  }
+
+  return granule * gr_d * 1000 / gr_n;
+}
+
+static int
+skeleton_read_page (OGGZ * oggz, const ogg_page * og, long serialno,
+                    void * user_data)
+{
+  OI_Skeleton * sk = (OI_Skeleton *)user_data;
+  oggz_off_t * pages;
+
+  if (oggz_stream_get_content (oggz, serialno) != OGGZ_CONTENT_SKELETON)
+    return OGGZ_CONTINUE;
+
+  sk->skeleton_serialno = serialno;
+
+  pages = realloc (sk->skeleton_pages,
+                   (sk->nr_skeleton_pages + 1) * 2 * sizeof (oggz_off_t));
+  if (pages == NULL) return OGGZ_STOP_ERR;
+
+  pages[sk->nr_skeleton_pages * 2] = oggz_tell (oggz);
+  pages[sk->nr_skeleton_pages * 2 + 1] = og->header_len + og->body_len;
+  sk->skeleton_pages = pages;
+  sk->nr_skeleton_pages++;
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+skeleton_read_packet (OGGZ * oggz, oggz_packet * zp, long serialno,
+                      void * user_data)
+{
+  OI_Skeleton * sk = (OI_Skeleton *)user_data;
+  ogg_packet * op = &zp->op;
+  OI_Track * track;
+  fisbone_packet fp;
+  index_packet * ip;
+  ogg_int64_t granulepos, time_n;
+  oggz_off_t offset;
+  int keyframe;
+
+  if (serialno == sk->skeleton_serialno) {
+    if (op->bytes >= 8 && !memcmp (op->packet, FISHEAD_IDENTIFIER, 8)) {
+      fishead_from_ogg (op, &sk->fishead);
+    } else if (op->bytes >= FISBONE_SIZE &&
+               !memcmp (op->packet, FISBONE_IDENTIFIER, 8)) {
+      if (fisbone_from_ogg (op, &fp) != 0) return OGGZ_STOP_ERR;
+      if ((track = oi_track_get (sk, (long)(int)fp.serial_no)) == NULL)
+        return OGGZ_STOP_ERR;
+      if (track->has_fisbone) fisbone_clear (&track->fisbone);
+      track->fisbone = fp;
+      track->has_fisbone = 1;
+    }
+    return OGGZ_CONTINUE;
+  }
+
+  if ((track = oi_track_get (sk, serialno)) == NULL)
+    return OGGZ_STOP_ERR;
+
+  if (op->packetno < oggz_stream_get_numheaders (oggz, serialno))
+    return OGGZ_CONTINUE;
+
+  offset = zp->pos.begin_page_offset;
+  if (sk->content_offset == -1 || offset < sk->content_offset)
+    sk->content_offset = offset;
+
+  granulepos = zp->pos.calc_granulepos;
+  if (granulepos == -1) return OGGZ_CONTINUE;
+
+  if ((time_n = gp_to_ms (oggz, serialno, granulepos, &keyframe)) == -1)
+    return OGGZ_CONTINUE;
+
+  ip = &track->index;
+  if (ip->nr_keypoints == 0) ip->first_time_n = time_n;
+  if (time_n > ip->last_time_n) ip->last_time_n = time_n;
+
+  /* Keypoints must increase in offset and time. Bitstreams without
+   * keyframes can start decoding on any page, so space them out. */
+  if (ip->nr_keypoints > 0) {
+    if (offset <= ip->offsets[ip->nr_keypoints-1] ||
+        time_n < ip->times_n[ip->nr_keypoints-1])
+      return OGGZ_CONTINUE;
+
+    if (oggz_get_granuleshift (oggz, serialno) == 0) {
+      if (time_n < ip->times_n[ip->nr_keypoints-1] + KEYPOINT_INTERVAL)
+        return OGGZ_CONTINUE;
+    } else if (!keyframe) {
+      return OGGZ_CONTINUE;
+    }
+  } else if (oggz_get_granuleshift (oggz, serialno) != 0 && !keyframe) {
+    return OGGZ_CONTINUE;
+  }
+
+  if (add_index_keypoint (ip, offset, time_n) != 0)
+    return OGGZ_STOP_ERR;
+
+  return OGGZ_CONTINUE;
+}
+
+/* Offset in the output of a page at offset in the input, excluding the
+ * new Skeleton pages */
+static oggz_off_t
+skeleton_map_offset (OI_Skeleton * sk, oggz_off_t offset)
+{
+  oggz_off_t mapped = offset;
+  int i;
+
+  for (i = 0; i < sk->nr_skeleton_pages; i++) {
+    if (sk->skeleton_pages[i*2] < offset)
+      mapped -= sk->skeleton_pages[i*2 + 1];
+  }
+
+  return mapped;
+}
+
+/* Append the flushed pages of os to *buf */
+static int
+skeleton_flush (ogg_stream_state * os, unsigned char ** buf, long * len)
+{
+  ogg_page og;
+  unsigned char * new_buf;
+
+  while (ogg_stream_flush (os, &og)) {
+    new_buf = realloc (*buf, *len + og.header_len + og.body_len);
+    if (new_buf == NULL) return -1;
+
+    memcpy (new_buf + *len, og.header, og.header_len);
+    memcpy (new_buf + *len + og.header_len, og.body, og.body_len);
+    *buf = new_buf;
+    *len += og.header_len + og.body_len;
+  }
+
+  return 0;
+}
+
+static int
+skeleton_fisbone_init (OI_Skeleton * sk, OI_Track * track, long serialno)
+{
+  OGGZ * oggz = sk->oggz;
+  fisbone_packet * fp = &track->fisbone;
+  OggzStreamContent content;
+  const char * name = NULL;
+
+  memset (fp, 0, sizeof (*fp));
+
+  fp->serial_no = serialno;
+  fp->nr_header_packet = oggz_stream_get_numheaders (oggz, serialno);
+  oggz_get_granulerate (oggz, serialno, &fp->granule_rate_n, &fp->granule_rate_d);
+  fp->granule_shift = (unsigned char) oggz_get_granuleshift (oggz, serialno);
+
+  content = oggz_stream_get_content (oggz, serialno);
+  if (content < OGGZ_CONTENT_UNKNOWN)
+    name = mime_type_names[content];
+  if (name == NULL) name = "application/octet-stream";
+
+  add_message_header_field (fp, "Content-Type", (char *)name);
+  track->has_fisbone = 1;
+
+  return 0;
+}
+
+/* Build the Skeleton pages, with keypoint offsets assuming that they
+ * occupy skeleton_len bytes; returns the number of bytes they occupy */
+static long
+skeleton_build (OI_Skeleton * sk, long skeleton_len, long padding)
+{
+  ogg_stream_state os;
+  fishead_packet fishead;
+  index_packet mapped, * ip;
+  OI_Track * track;
+  ogg_int64_t i, shift;
+  long serialno;
+  int n, j, last_index = -1;
+
+  free (sk->head);
+  free (sk->tail);
+  sk->head = sk->tail = NULL;
+  sk->head_len = sk->tail_len = 0;
+
+  shift = skeleton_len;
+
+  fishead = sk->fishead;
+  fishead.version_major = SKELETON_INDEX_VERSION_MAJOR;
+  fishead.version_minor = SKELETON_INDEX_VERSION_MINOR;
+  if (fishead.ptime_d == 0) fishead.ptime_d = 1000;
+  if (fishead.btime_d == 0) fishead.btime_d = 1000;
+  fishead.segment_length = skeleton_map_offset (sk, sk->input_length) + shift;
+  fishead.content_offset = skeleton_map_offset (sk, sk->content_offset) + shift;
+
+  ogg_stream_init (&os, sk->serialno);
+
+  if (add_fishead_to_stream (&os, &fishead) != 0 ||
+      skeleton_flush (&os, &sk->head, &sk->head_len) != 0)
+    goto err;
+
+  n = oggz_table_size (sk->tracks);
+  for (j = 0; j < n; j++) {
+    track = oggz_table_nth (sk->tracks, j, &serialno);
+    if (add_fisbone_to_stream (&os, &track->fisbone) != 0 ||
+        skeleton_flush (&os, &sk->tail, &sk->tail_len) != 0)
+      goto err;
+    if (track->index.nr_keypoints > 0) last_index = j;
+  }
+
+  for (j = 0; j < n; j++) {
+    track = oggz_table_nth (sk->tracks, j, &serialno);
+    ip = &track->index;
+    if (ip->nr_keypoints == 0) continue;
+
+    mapped = *ip;
+    mapped.offsets = malloc (ip->nr_keypoints * sizeof (ogg_int64_t));
+    if (mapped.offsets == NULL) goto err;
+
+    for (i = 0; i < ip->nr_keypoints; i++)
+      mapped.offsets[i] = skeleton_map_offset (sk, ip->offsets[i]) + shift;
+
+    if (add_index_to_stream (&os, &mapped, j == last_index ? padding : 0) != 0) {
+      free (mapped.offsets);
+      goto err;
+    }
+    free (mapped.offsets);
+
+    if (skeleton_flush (&os, &sk->tail, &sk->tail_len) != 0)
+      goto err;
+  }
+
+  if (add_eos_packet_to_stream (&os) != 0 ||
+      skeleton_flush (&os, &sk->tail, &sk->tail_len) != 0)
+    goto err;
+
+  ogg_stream_clear (&os);
+
+  return sk->head_len + sk->tail_len;
+
+ err:
+  ogg_stream_clear (&os);
+  return -1;
+}
+
+static int
+skeleton_layout (OI_Skeleton * sk)
+{
+  long assumed = 0, actual, padding = 0;
+  int i;
+
+  for (i = 0; i < MAX_LAYOUT_PASSES; i++) {
+    if ((actual = skeleton_build (sk, assumed, padding)) == -1)
+      return -1;
+
+    if (actual == assumed) return 0;
+
+    if (actual < assumed) {
+      /* Pad the index out to the size assumed for it */
+      padding += assumed - actual;
+    } else {
+      assumed = actual;
+      padding = 0;
+    }
+  }
+
+  return -1;
+}
+
+static int
+skeleton_write (OI_Skeleton * sk, const unsigned char * buf, long len)
+{
+  if (fwrite (buf, 1, len, sk->outfile) != (size_t)len) {
+    sk->write_error = 1;
+    return -1;
+  }
+
+  return 0;
+}
+
+static int
+skeleton_copy_page (OGGZ * oggz, const ogg_page * og, long serialno,
+                    void * user_data)
+{
+  OI_Skeleton * sk = (OI_Skeleton *)user_data;
+
+  if (!sk->wrote_head) {
+    if (skeleton_write (sk, sk->head, sk->head_len) != 0) return OGGZ_STOP_ERR;
+    sk->wrote_head = 1;
+  }
+
+  if (!sk->wrote_tail && !ogg_page_bos ((ogg_page *)og)) {
+    if (skeleton_write (sk, sk->tail, sk->tail_len) != 0) return OGGZ_STOP_ERR;
+    sk->wrote_tail = 1;
+  }
+
+  if (serialno == sk->skeleton_serialno)
+    return OGGZ_CONTINUE;
+
+  if (skeleton_write (sk, og->header, og->header_len) != 0 ||
+      skeleton_write (sk, og->body, og->body_len) != 0)
+    return OGGZ_STOP_ERR;
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+build_skeleton (const char * infilename, const char * outfilename)
+{
+  OI_Skeleton sk;
+  OI_Track * track;
+  OGGZ * oggz;
+  long n, serialno;
+  int i, ntracks, ret = -1;
+
+  memset (&sk, 0, sizeof (sk));
+  sk.skeleton_serialno = -1;
+  sk.content_offset = -1;
+
+  if ((oggz = oggz_open (infilename, OGGZ_READ|OGGZ_AUTO)) == NULL) {
+    fprintf (stderr, "%s: unable to open file %s\n", progname, infilename);
+    return -1;
+  }
+
+  sk.oggz = oggz;
+  sk.tracks = oggz_table_new ();
+
+  oggz_set_read_page (oggz, -1, skeleton_read_page, &sk);
+  oggz_set_read_callback (oggz, -1, skeleton_read_packet, &sk);
+
+  while ((n = oggz_read (oggz, READ_BLOCKSIZE)) > 0);
+
+  if (n < 0) {
+    fprintf (stderr, "%s: error reading %s\n", progname, infilename);
+    goto out;
+  }
+
+  sk.input_length = oggz_tell (oggz);
+  sk.serialno = sk.skeleton_serialno != -1 ?
+    sk.skeleton_serialno : oggz_serialno_new (oggz);
+
+  /* Make fisbones for any bitstreams the input Skeleton did not cover */
+  ntracks = oggz_table_size (sk.tracks);
+  for (i = 0; i < ntracks; i++) {
+    track = oggz_table_nth (sk.tracks, i, &serialno);
+    if (!track->has_fisbone)
+      skeleton_fisbone_init (&sk, track, serialno);
+  }
+
+  if (sk.content_offset == -1 || skeleton_layout (&sk) != 0) {
+    fprintf (stderr, "%s: unable to index %s\n", progname, infilename);
+    goto out;
+  }
+
+  oggz_close (oggz);
+
+  if ((sk.outfile = fopen (outfilename, "wb")) == NULL) {
+    fprintf (stderr, "%s: unable to open output file %s: %s\n",
+             progname, outfilename, strerror (errno));
+    oggz = NULL;
+    goto out;
+  }
+
+  if ((oggz = oggz_open (infilename, OGGZ_READ|OGGZ_AUTO)) == NULL) {
+    fprintf (stderr, "%s: unable to open file %s\n", progname, infilename);
+    fclose (sk.outfile);
+    goto out;
+  }
+
+  oggz_set_read_page (oggz, -1, skeleton_copy_page, &sk);
+
+  while ((n = oggz_read (oggz, READ_BLOCKSIZE)) > 0);
+
+  if (fclose (sk.outfile) != 0) sk.write_error = 1;
+
+  if (n < 0 || sk.write_error) {
+    fprintf (stderr, "%s: error writing %s\n", progname, outfilename);
+    remove (outfilename);
+    goto out;
+  }
+
+  ret = 0;
+
+ out:
+  if (oggz != NULL) oggz_close (oggz);
+
+  ntracks = oggz_table_size (sk.tracks);
+  for (i = 0; i < ntracks; i++) {
+    track = oggz_table_nth (sk.tracks, i, NULL);
+    index_clear (&track->index);
+    fisbone_clear (&track->fisbone);
+    free (track);
+  }
+  oggz_table_delete (sk.tracks);
+
+  free (sk.skeleton_pages);
+  free (sk.head);
+  free (sk.tail);
+
+  return ret;
+}
+
+int
+main (int argc, char ** argv)
+{
+  int show_version = 0;
+  int show_help = 0;
+  int skeleton = 0;
+  int i, ret = 0;
+
+  char * infilename, * outfilename = NULL;
+  char * indexfilename;
+
+  char * optstring = "hvso:";
+
+#ifdef HAVE_GETOPT_LONG
+  static struct option long_options[] = {
+    {"help", no_argument, 0, 'h'},
+    {"version", no_argument, 0, 'v'},
+    {"skeleton", no_argument, 0, 's'},
+    {"output", required_argument, 0, 'o'},
+    {NULL,0,0,0}
+  };
+#endif
+
+  progname = argv[0];
+
+  if (argc < 2) {
+    usage (progname);
+    return (1);
+  }
+
+  if (!strncmp (argv[1], "-?", 2)) {
+#ifdef HAVE_GETOPT_LONG
+    ot_print_options (long_options, optstring);
+#else
+    ot_print_short_options (optstring);
+#endif
+    exit (0);
+  }
+
+  while (1) {
+#ifdef HAVE_GETOPT_LONG
+    i = getopt_long (argc, argv, optstring, long_options, NULL);
+#else
+    i = getopt (argc, argv, optstring);
+#endif
+    if (i == -1) break;
+    if (i == ':') {
+      usage (progname);
+      goto exit_err;
+    }
+
+    switch (i) {
+    case 'h': /* help */
+      show_help = 1;
+      break;
+    case 'v': /* version */
+      show_version = 1;
+      break;
+    case 's': /* skeleton */
+      skeleton = 1;
+      break;
+    case 'o': /* output */
+      outfilename = optarg;
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (show_version) {
+    printf ("%s version " VERSION "\n", progname);
+  }
+
+  if (show_help) {
+    usage (progname);
+  }
+
+  if (show_version || show_help) {
+    goto exit_ok;
+  }
+
+  if (optind >= argc) {
+    usage (progname);
+    goto exit_err;
+  }
+
+  if (outfilename != NULL && argc > optind+1) {
+    fprintf (stderr, "%s: --output can only be used with a single input file\n",
+             progname);
+    goto exit_err;
+  }
+
+  if (skeleton) {
+    if (outfilename == NULL) {
+      fprintf (stderr, "%s: --skeleton requires an output filename\n",
+               progname);
+      goto exit_err;
+    }
+
+    if (build_skeleton (argv[optind], outfilename) == -1)
+      goto exit_err;
+
+    goto exit_ok;
+  }
+
+  while (optind < argc) {
+    infilename = argv[optind++];
+
+    if (outfilename != NULL) {
+      if (build_index (infilename, outfilename) == -1)
+        ret = 1;
+      continue;
+    }
+
+    indexfilename = malloc (strlen (infilename) +
+                            strlen (OGGZ_SEEK_INDEX_SUFFIX) + 1);
+    if (indexfilename == NULL) {
+      fprintf (stderr, "%s: out of memory\n", progname);
+      goto exit_err;
+    }
+    sprintf (indexfilename, "%s%s", infilename, OGGZ_SEEK_INDEX_SUFFIX);
+
+    if (build_index (infilename, indexfilename) == -1)
+      ret = 1;
+
+    free (indexfilename);
+  }
+
+  if (ret) goto exit_err;
+
+ exit_ok:
+  exit (0);
+
+ exit_err:
+  exit (1);
+}
@@ -52,6 +52,9 @@
 
 #define READ_BLOCKSIZE 1024000
 
+/* Number of buffers to read ahead on a background thread */
+#define READ_AHEAD_BUFFERS 4
+
 static char * progname;
 
 static void
@@ -464,61 +467,68 @@ read_page_pass2 (OGGZ * oggz, const ogg_page * og, long serialno, void * user_da
 }
 
 static int
-read_packet_pass1 (OGGZ * oggz, oggz_packet * zp, long serialno,
-		   void * user_data)
+read_packets_pass1 (OGGZ * oggz, const ogg_page * og, oggz_packet * packets,
+                    int n, long serialno, void * user_data)
 {
   OI_Info * info = (OI_Info *)user_data;
-  ogg_packet * op = &zp->op;
-  OI_TrackInfo * oit;
+  ogg_packet * op;
+  OI_TrackInfo * oit, * fit;
+  int i;
 
   oit = oggz_table_lookup (info->tracks, serialno);
 
-  /* Increment the packet statistics */
-  oit->packets.count++;
-  oit->packets.length_total += op->bytes;
-  if (op->bytes < oit->packets.length_min)
-    oit->packets.length_min = op->bytes;
-  if (op->bytes > oit->packets.length_max)
-    oit->packets.length_max = op->bytes;
-
-  if (!op->e_o_s && !memcmp(op->packet, FISBONE_IDENTIFIER, 8)) {
-    fisbone_packet fp;
-    int ret = fisbone_from_ogg(op, &fp);
-    if (ret<0) return ret;
-    oit = oggz_table_lookup (info->tracks, fp.serial_no);
-    if (oit) {
-      oit->has_fisbone = 1;
-      oit->fbInfo = fp;
-    }
-    else {
-      fprintf(stderr, "Warning: logical stream %08x referenced by skeleton was not found\n",fp.serial_no);
-      fisbone_clear(&fp);
+  for (i = 0; i < n; i++) {
+    op = &packets[i].op;
+
+    /* Increment the packet statistics */
+    oit->packets.count++;
+    oit->packets.length_total += op->bytes;
+    if (op->bytes < oit->packets.length_min)
+      oit->packets.length_min = op->bytes;
+    if (op->bytes > oit->packets.length_max)
+      oit->packets.length_max = op->bytes;
+
+    if (!op->e_o_s && !memcmp(op->packet, FISBONE_IDENTIFIER, 8)) {
+      fisbone_packet fp;
+      int ret = fisbone_from_ogg(op, &fp);
+      if (ret<0) return ret;
+      fit = oggz_table_lookup (info->tracks, fp.serial_no);
+      if (fit) {
+        fit->has_fisbone = 1;
+        fit->fbInfo = fp;
+      }
+      else {
+        fprintf(stderr, "Warning: logical stream %08x referenced by skeleton was not found\n",fp.serial_no);
+        fisbone_clear(&fp);
+      }
+    } else if (!op->e_o_s && !memcmp(op->packet, FISHEAD_IDENTIFIER, 8)) {
+      fishead_packet fp;
+      int ret = fishead_from_ogg(op, &fp);
+      if (ret<0) return ret;
+      oit->has_fishead = 1;
+      oit->fhInfo = fp;    
     }
-  } else if (!op->e_o_s && !memcmp(op->packet, FISHEAD_IDENTIFIER, 8)) {
-    fishead_packet fp;
-    int ret = fishead_from_ogg(op, &fp);
-    if (ret<0) return ret;
-    oit->has_fishead = 1;
-    oit->fhInfo = fp;    
   }
 
   return 0;
 }
 
 static int
-read_packet_pass2 (OGGZ * oggz, oggz_packet * zp, long serialno,
-		   void * user_data)
+read_packets_pass2 (OGGZ * oggz, const ogg_page * og, oggz_packet * packets,
+                    int n, long serialno, void * user_data)
 {
   OI_Info * info = (OI_Info *)user_data;
-  ogg_packet * op = &zp->op;
   OI_TrackInfo * oit;
   long deviation;
+  int i;
   
   oit = oggz_table_lookup (info->tracks, serialno);
 
   /* Increment the packet length deviation squared total */
-  deviation = op->bytes - oit->packets.length_avg;
-  oit->packets.length_deviation_total += (deviation * deviation);
+  for (i = 0; i < n; i++) {
+    deviation = packets[i].op.bytes - oit->packets.length_avg;
+    oit->packets.length_deviation_total += (deviation * deviation);
+  }
 
   return 0;
 }
@@ -532,7 +542,7 @@ oi_pass1 (OGGZ * oggz, OI_Info * info)
 
   oggz_seek (oggz, 0, SEEK_SET);
   oggz_set_read_page (oggz, -1, read_page_pass1, info);
-  oggz_set_read_callback (oggz, -1, read_packet_pass1, info);
+  oggz_set_read_packets (oggz, -1, read_packets_pass1, info);
 
   while ((n = oggz_read (oggz, READ_BLOCKSIZE)) > 0);
 
@@ -565,7 +575,7 @@ oi_pass2 (OGGZ * oggz, OI_Info * info)
 
   oggz_seek (oggz, 0, SEEK_SET);
   oggz_set_read_page (oggz, -1, read_page_pass2, info);
-  oggz_set_read_callback (oggz, -1, read_packet_pass2, info);
+  oggz_set_read_packets (oggz, -1, read_packets_pass2, info);
 
   while ((n = oggz_read (oggz, READ_BLOCKSIZE)) > 0);
   if (n == OGGZ_ERR_OUT_OF_MEMORY)
@@ -714,6 +724,9 @@ main (int argc, char ** argv)
       return (1);
     }
 
+    /* Overlap reading with gathering statistics, where supported */
+    oggz_set_read_ahead (oggz, READ_AHEAD_BUFFERS);
+
     info.oggz = oggz;
     info.tracks = oggz_table_new ();
     info.length_total = 0;
@@ -52,6 +52,9 @@
 
 #define SUBSECONDS 1000.0
 
+/* Number of buffers to read ahead on a background thread */
+#define READ_AHEAD_BUFFERS 4
+
 /* #define DEBUG */
 
 typedef ogg_int64_t timestamp_t;
@@ -417,7 +420,7 @@ validate (char * filename)
 {
   OGGZ * reader;
   OVData ovdata;
-  unsigned char buf[1024];
+  ogg_page og;
   long n, nout = 0, bytes_written = 0;
   int active = 1;
 
@@ -437,6 +440,9 @@ validate (char * filename)
     return -1;
   }
 
+  /* Overlap reading with validation, where supported */
+  oggz_set_read_ahead (reader, READ_AHEAD_BUFFERS);
+
   ovdata_init (&ovdata);
 
   oggz_set_read_callback (reader, -1, read_packet, &ovdata);
@@ -452,7 +458,7 @@ validate (char * filename)
 	       "oggz-validate --max-errors %d: maximum error count reached, bailing out ...\n",
                max_errors);
       active = 0;
-    } else while ((nout = oggz_write_output (ovdata.writer, buf, n)) > 0) {
+    } else while ((nout = oggz_write_output_page (ovdata.writer, &og)) > 0) {
 #ifdef DEBUG
       fprintf (stderr, "validate: wrote %ld bytes\n", nout);
 #endif
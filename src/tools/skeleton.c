@@ -110,29 +110,45 @@ int add_message_header_field(fisbone_packet *fp,
     return 0;
 }
 
-/* create a ogg_packet from a fishead_packet structure */
+/* create a ogg_packet from a fishead_packet structure. A Skeleton 4.0
+ * fishead is created if fp->version_major is 4, otherwise version 3.0.
+ */
 int ogg_from_fishead(fishead_packet *fp,ogg_packet *op) {
 
+    int index_version, packet_size;
+
     if (!fp || !op) return -1;
 
+    index_version = (fp->version_major >= SKELETON_INDEX_VERSION_MAJOR);
+    packet_size = index_version ? FISHEAD_INDEX_SIZE : FISHEAD_SIZE;
+
     memset(op, 0, sizeof(*op));
-    op->packet = _ogg_calloc(FISHEAD_SIZE, sizeof(unsigned char));
+    op->packet = _ogg_calloc(packet_size, sizeof(unsigned char));
     if (!op->packet) return -1;
 
-    memset(op->packet, 0, FISHEAD_SIZE);
+    memset(op->packet, 0, packet_size);
 
     memcpy (op->packet, FISHEAD_IDENTIFIER, 8); /* identifier */
-    *((ogg_uint16_t*)(op->packet+8)) = _le_16 (SKELETON_VERSION_MAJOR); /* version major */
-    *((ogg_uint16_t*)(op->packet+10)) = _le_16 (SKELETON_VERSION_MINOR); /* version minor */
+    if (index_version) {
+      *((ogg_uint16_t*)(op->packet+8)) = _le_16 (SKELETON_INDEX_VERSION_MAJOR); /* version major */
+      *((ogg_uint16_t*)(op->packet+10)) = _le_16 (SKELETON_INDEX_VERSION_MINOR); /* version minor */
+    } else {
+      *((ogg_uint16_t*)(op->packet+8)) = _le_16 (SKELETON_VERSION_MAJOR); /* version major */
+      *((ogg_uint16_t*)(op->packet+10)) = _le_16 (SKELETON_VERSION_MINOR); /* version minor */
+    }
     *((ogg_int64_t*)(op->packet+12)) = _le_64 (fp->ptime_n); /* presentationtime numerator */
     *((ogg_int64_t*)(op->packet+20)) = _le_64 (fp->ptime_d); /* presentationtime denominator */
     *((ogg_int64_t*)(op->packet+28)) = _le_64 (fp->btime_n); /* basetime numerator */
     *((ogg_int64_t*)(op->packet+36)) = _le_64 (fp->btime_d); /* basetime denominator */
     /* TODO: UTC time, set to zero for now */
+    if (index_version) {
+      *((ogg_int64_t*)(op->packet+64)) = _le_64 (fp->segment_length); /* segment length */
+      *((ogg_int64_t*)(op->packet+72)) = _le_64 (fp->content_offset); /* content byte offset */
+    }
 
     op->b_o_s = 1;   /* its the first packet of the stream */
     op->e_o_s = 0;   /* its not the last packet of the stream */
-    op->bytes = FISHEAD_SIZE;  /* length of the packet in bytes */
+    op->bytes = packet_size;  /* length of the packet in bytes */
 
     return 0;
 }
@@ -189,6 +205,14 @@ static int fishead_from_data (const unsigned char * data, int len, fishead_packe
     fp->btime_d = _le_64 (*((ogg_int64_t*)(data+36))); /* basetime denominator */
     memcpy(fp->UTC, data+44, 20);
 
+    if (fp->version_major >= SKELETON_INDEX_VERSION_MAJOR && len >= FISHEAD_INDEX_SIZE) {
+      fp->segment_length = _le_64 (*((ogg_int64_t*)(data+64))); /* segment length */
+      fp->content_offset = _le_64 (*((ogg_int64_t*)(data+72))); /* content byte offset */
+    } else {
+      fp->segment_length = 0;
+      fp->content_offset = 0;
+    }
+
     return 0;
 }
 
@@ -242,6 +266,97 @@ int fisbone_clear(fisbone_packet *fp)
     return 0;
 }
 
+/* add a keypoint to an index_packet; keypoints must be added in order */
+int add_index_keypoint(index_packet *ip, ogg_int64_t offset, ogg_int64_t time_n) {
+
+    if (!ip) return -1;
+
+    if (ip->nr_keypoints == ip->max_keypoints) {
+        ogg_int64_t new_max = ip->max_keypoints ? ip->max_keypoints * 2 : 64;
+        ogg_int64_t *offsets, *times_n;
+
+        offsets = _ogg_realloc(ip->offsets, new_max * sizeof(ogg_int64_t));
+        if (!offsets) return -1;
+        ip->offsets = offsets;
+
+        times_n = _ogg_realloc(ip->times_n, new_max * sizeof(ogg_int64_t));
+        if (!times_n) return -1;
+        ip->times_n = times_n;
+
+        ip->max_keypoints = new_max;
+    }
+
+    ip->offsets[ip->nr_keypoints] = offset;
+    ip->times_n[ip->nr_keypoints] = time_n;
+    ip->nr_keypoints++;
+
+    return 0;
+}
+
+/* write a Skeleton variable length integer, returning its length */
+static int write_vint(unsigned char *c, ogg_int64_t n) {
+    int len = 0;
+
+    do {
+        c[len] = n & 0x7f;
+        n >>= 7;
+        if (n == 0) c[len] |= 0x80;
+        len++;
+    } while (n != 0);
+
+    return len;
+}
+
+/* create a ogg_packet from an index_packet structure. padding bytes are
+ * appended after the keypoints, for callers which need to fix the size of
+ * the packet.
+ */
+int ogg_from_index(index_packet *ip, long padding, ogg_packet *op) {
+
+    long packet_size;
+    ogg_int64_t i;
+    unsigned char *c;
+
+    if (!ip || !op || padding < 0) return -1;
+
+    /* Each keypoint is two variable length integers of at most 10 bytes */
+    packet_size = INDEX_KEYPOINT_OFFSET + ip->nr_keypoints * 20 + padding;
+
+    memset (op, 0, sizeof (*op));
+    op->packet = _ogg_calloc (packet_size, sizeof(unsigned char));
+    if (!op->packet) return -1;
+
+    memcpy (op->packet, INDEX_IDENTIFIER, 6); /* identifier */
+    *((ogg_uint32_t*)(op->packet+6)) = _le_32 (ip->serial_no); /* serialno of the indexed stream */
+    *((ogg_int64_t*)(op->packet+10)) = _le_64 (ip->nr_keypoints); /* number of keypoints */
+    *((ogg_int64_t*)(op->packet+18)) = _le_64 (ip->time_d); /* timestamp denominator */
+    *((ogg_int64_t*)(op->packet+26)) = _le_64 (ip->first_time_n); /* first sample time numerator */
+    *((ogg_int64_t*)(op->packet+34)) = _le_64 (ip->last_time_n); /* last sample end time numerator */
+
+    c = op->packet + INDEX_KEYPOINT_OFFSET;
+    for (i = 0; i < ip->nr_keypoints; i++) {
+        c += write_vint (c, ip->offsets[i] - (i ? ip->offsets[i-1] : 0));
+        c += write_vint (c, ip->times_n[i] - (i ? ip->times_n[i-1] : 0));
+    }
+
+    op->b_o_s = 0;
+    op->e_o_s = 0;
+    op->bytes = (c - op->packet) + padding; /* size of the packet in bytes */
+
+    return 0;
+}
+
+int index_clear(index_packet *ip)
+{
+    if (!ip) return -1;
+    _ogg_free(ip->offsets);
+    _ogg_free(ip->times_n);
+    ip->offsets = NULL;
+    ip->times_n = NULL;
+    ip->nr_keypoints = ip->max_keypoints = 0;
+    return 0;
+}
+
 int add_fishead_to_stream(ogg_stream_state *os, fishead_packet *fp) {
 
     ogg_packet op;
@@ -268,6 +383,19 @@ int add_fisbone_to_stream(ogg_stream_state *os, fisbone_packet *fp) {
     return 0;
 }
 
+int add_index_to_stream(ogg_stream_state *os, index_packet *ip, long padding) {
+
+    ogg_packet op;
+    int ret;
+
+    ret = ogg_from_index(ip, padding, &op);
+    if (ret<0) return ret;
+    ogg_stream_packetin(os, &op);
+    _ogg_free(op.packet);
+
+    return 0;
+}
+
 int add_eos_packet_to_stream(ogg_stream_state *os) {
 
     ogg_packet op;
@@ -20,6 +20,14 @@ extern "C" {
 #define FISBONE_SIZE 52
 #define FISBONE_MESSAGE_HEADER_OFFSET 44
 
+/* Skeleton 4.0 adds keypoint indexes, and segment information to the
+ * fishead */
+#define SKELETON_INDEX_VERSION_MAJOR 4
+#define SKELETON_INDEX_VERSION_MINOR 0
+#define FISHEAD_INDEX_SIZE 80
+#define INDEX_IDENTIFIER "index\0"
+#define INDEX_KEYPOINT_OFFSET 42
+
 /* fishead_packet holds a fishead header packet. */
 typedef struct {
     ogg_uint16_t version_major;				    /* skeleton version major */
@@ -32,6 +40,9 @@ typedef struct {
     ogg_int64_t btime_d;                                    /* basetime denominator */
     /* will holds the time of origin of the stream, a 20 bit field. */
     unsigned char UTC[20];
+    /* Skeleton 4.0 only */
+    ogg_int64_t segment_length;                             /* length of the segment in bytes */
+    ogg_int64_t content_offset;                             /* offset of the first non-header page */
 } fishead_packet;
 
 /* fisbone_packet holds a fisbone header packet. */
@@ -49,18 +60,34 @@ typedef struct {
     ogg_uint32_t current_header_size;
 } fisbone_packet;
 
+/* index_packet holds a Skeleton 4.0 keypoint index packet. */
+typedef struct {
+    ogg_uint32_t serial_no;                                 /* serial no of the indexed stream */
+    ogg_int64_t time_d;                                     /* timestamp denominator */
+    ogg_int64_t first_time_n;                               /* first sample time numerator */
+    ogg_int64_t last_time_n;                                /* last sample end time numerator */
+    ogg_int64_t nr_keypoints;                               /* number of keypoints */
+    ogg_int64_t max_keypoints;                              /* allocated size of the arrays below */
+    ogg_int64_t *offsets;                                   /* page offset of each keypoint */
+    ogg_int64_t *times_n;                                   /* time numerator of each keypoint */
+} index_packet;
+
 extern int write_ogg_page_to_file(ogg_page *og, FILE *out);
 extern int add_message_header_field(fisbone_packet *fp, char *header_key, char *header_value);
 /* remember to deallocate the returned ogg_packet properly */
 extern int ogg_from_fishead(fishead_packet *fp,ogg_packet *op);
 extern int ogg_from_fisbone(fisbone_packet *fp,ogg_packet *op);
 extern int fisbone_clear(fisbone_packet *fp);
+extern int add_index_keypoint(index_packet *ip, ogg_int64_t offset, ogg_int64_t time_n);
+extern int ogg_from_index(index_packet *ip, long padding, ogg_packet *op);
+extern int index_clear(index_packet *ip);
 extern int fishead_from_ogg(ogg_packet *op,fishead_packet *fp);
 extern int fisbone_from_ogg(ogg_packet *op,fisbone_packet *fp);
 extern int fishead_from_ogg_page(const ogg_page *og,fishead_packet *fp);
 extern int fisbone_from_ogg_page(const ogg_page *og,fisbone_packet *fp);
 extern int add_fishead_to_stream(ogg_stream_state *os, fishead_packet *fp);
 extern int add_fisbone_to_stream(ogg_stream_state *os, fisbone_packet *fp);
+extern int add_index_to_stream(ogg_stream_state *os, index_packet *ip, long padding);
 extern int add_eos_packet_to_stream(ogg_stream_state *os);
 extern int flush_ogg_stream_to_file(ogg_stream_state *os, FILE *out);
 